@@ -0,0 +1,199 @@
+/** @file
+ Implementacja wykonywania wielu skryptów kalkulatora w puli wątków
+
+ Wątki pobierają kolejne skrypty, zwiększając atomowo wspólny indeks. Przy wypisywaniu
+ na standardowe wyjście wyniki każdego skryptu są zbierane w pamięci (open_memstream),
+ a wątek główny wypisuje je w kolejności skryptów, gdy tylko dany skrypt się zakończy.
+ Pamięć podręczna wyników i tablica wyrażeń są osobne dla każdego wątku.
+
+ @author Julia Karmowska
+ @date 2021
+*/
+
+/**
+ * Umożliwia działanie wątków POSIX i open_memstream.
+ */
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "batch.h"
+#include "session.h"
+#include "cache.h"
+#include "memory.h"
+
+/**
+ * Struktura opisująca wykonanie jednego skryptu.
+ */
+typedef struct BatchJob {
+    const char *script;     ///< ścieżka skryptu
+    const char *failed;     ///< ścieżka pliku, którego nie udało się otworzyć, albo NULL
+    char *out;              ///< zebrane wyniki (tylko przy wypisywaniu na standardowe wyjście)
+    size_t out_size;        ///< długość zebranych wyników
+    char *err;              ///< zebrane komunikaty o błędach
+    size_t err_size;        ///< długość zebranych komunikatów
+    bool done;              ///< czy skrypt się zakończył
+} BatchJob;
+
+/**
+ * Struktura opisująca pulę wątków wykonujących skrypty.
+ */
+typedef struct Batch {
+    BatchJob *jobs;         ///< skrypty
+    size_t count;           ///< liczba skryptów
+    atomic_size_t next;     ///< indeks kolejnego skryptu do pobrania
+    bool lazy;              ///< czy sesje działają w trybie leniwym
+    bool split_output;      ///< czy zapisywać wyniki do osobnych plików
+    pthread_mutex_t lock;   ///< chroni pola done skryptów
+    pthread_cond_t done;    ///< sygnalizuje zakończenie skryptu
+} Batch;
+
+/**
+ * Otwiera do zapisu plik o nazwie będącej ścieżką skryptu z dopisanym rozszerzeniem.
+ * @param[in] script : ścieżka skryptu
+ * @param[in] extension : rozszerzenie
+ * @param[out] path : nazwa pliku (do zwolnienia przez wywołującego)
+ * @return otwarty plik albo NULL
+ */
+static FILE *OpenOutput(const char *script, const char *extension, char **path)
+{
+    size_t script_length = strlen(script);
+    size_t extension_length = strlen(extension);
+    *path = malloc(script_length + extension_length + 1);
+    CHECK_PTR(*path);
+    memcpy(*path, script, script_length);
+    memcpy(*path + script_length, extension, extension_length + 1);
+    return fopen(*path, "w");
+}
+
+/**
+ * Wykonuje skrypt w nowej sesji.
+ * @param[in] batch : pula wątków
+ * @param[in] job : skrypt
+ */
+static void RunJob(Batch *batch, BatchJob *job)
+{
+    int fd = open(job->script, O_RDONLY);
+    FILE *out = NULL;
+    FILE *err = NULL;
+    char *out_path = NULL;
+    char *err_path = NULL;
+    if (fd < 0)
+        job->failed = job->script;
+    else if (batch->split_output)
+    {
+        out = OpenOutput(job->script, ".out", &out_path);
+        err = OpenOutput(job->script, ".err", &err_path);
+    } else
+    {
+        out = open_memstream(&job->out, &job->out_size);
+        err = open_memstream(&job->err, &job->err_size);
+        CHECK_PTR(out);
+        CHECK_PTR(err);
+    }
+
+    if (fd >= 0 && (out == NULL || err == NULL))
+        job->failed = job->script;
+    else if (fd >= 0)
+    {
+        Session session;
+        SessionInit(&session, out, err, batch->lazy);
+        InputReader *input;
+        InputOpen(&input, fd);
+        SessionRun(&session, input, false);
+        SessionDestroy(&session);
+        InputClose(&input);
+    }
+
+    if (out != NULL)
+        fclose(out);
+    if (err != NULL)
+        fclose(err);
+    if (fd >= 0)
+        close(fd);
+    free(out_path);
+    free(err_path);
+
+    pthread_mutex_lock(&batch->lock);
+    job->done = true;
+    pthread_cond_broadcast(&batch->done);
+    pthread_mutex_unlock(&batch->lock);
+}
+
+/**
+ * Treść wątku puli: wykonuje kolejne niepobrane skrypty.
+ * @param[in] arg : pula wątków
+ * @return NULL
+ */
+static void *Worker(void *arg)
+{
+    Batch *batch = arg;
+    size_t i;
+    while ((i = atomic_fetch_add(&batch->next, 1)) < batch->count)
+        RunJob(batch, &batch->jobs[i]);
+    CacheClear();
+    return NULL;
+}
+
+bool BatchRun(char *scripts[], size_t count, size_t jobs, bool lazy, bool split_output)
+{
+    Batch batch;
+    batch.jobs = calloc(count, sizeof(BatchJob));
+    CHECK_PTR(batch.jobs);
+    for (size_t i = 0; i < count; i++)
+        batch.jobs[i].script = scripts[i];
+    batch.count = count;
+    atomic_init(&batch.next, 0);
+    batch.lazy = lazy;
+    batch.split_output = split_output;
+    if (pthread_mutex_init(&batch.lock, NULL) != 0 || pthread_cond_init(&batch.done, NULL) != 0)
+        exit(1);
+
+    if (jobs > count)
+        jobs = count;
+    pthread_t *workers = calloc(jobs, sizeof(pthread_t));
+    CHECK_PTR(workers);
+    for (size_t i = 0; i < jobs; i++)
+    {
+        if (pthread_create(&workers[i], NULL, Worker, &batch) != 0)
+            exit(1);
+    }
+
+    bool success = true;
+    for (size_t i = 0; i < count; i++)
+    {
+        BatchJob *job = &batch.jobs[i];
+        pthread_mutex_lock(&batch.lock);
+        while (!job->done)
+            pthread_cond_wait(&batch.done, &batch.lock);
+        pthread_mutex_unlock(&batch.lock);
+
+        if (job->out != NULL)
+            fwrite(job->out, 1, job->out_size, stdout);
+        if (job->err_size > 0)
+        {
+            fflush(stdout);
+            fwrite(job->err, 1, job->err_size, stderr);
+        }
+        if (job->failed != NULL)
+        {
+            fflush(stdout);
+            fprintf(stderr, "Cannot open %s\n", job->failed);
+            success = false;
+        }
+        free(job->out);
+        free(job->err);
+    }
+
+    for (size_t i = 0; i < jobs; i++)
+        pthread_join(workers[i], NULL);
+    free(workers);
+    pthread_mutex_destroy(&batch.lock);
+    pthread_cond_destroy(&batch.done);
+    free(batch.jobs);
+    return success;
+}
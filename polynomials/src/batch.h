@@ -0,0 +1,29 @@
+/** @file
+ Interfejs wykonywania wielu skryptów kalkulatora w puli wątków
+
+ @author Julia Karmowska
+ @date 2021
+*/
+
+#ifndef POLYNOMIALS_BATCH_H
+#define POLYNOMIALS_BATCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Wykonuje skrypty kalkulatora w @p jobs wątkach. Każdy skrypt ma własną sesję (stos i rejestry).
+ * Jeśli @p split_output jest ustawione, wyniki i komunikaty o błędach skryptu @c plik trafiają
+ * do plików @c plik.out i @c plik.err. W przeciwnym razie są wypisywane na standardowe wyjście
+ * i standardowe wyjście diagnostyczne w kolejności skryptów, tak jak przy wykonaniu ich po kolei
+ * (najpierw wszystkie wyniki skryptu, potem jego komunikaty o błędach).
+ * @param[in] scripts : ścieżki skryptów
+ * @param[in] count : liczba skryptów
+ * @param[in] jobs : liczba wątków
+ * @param[in] lazy : czy sesje działają w trybie leniwym
+ * @param[in] split_output : czy zapisywać wyniki do osobnych plików
+ * @return Czy udało się otworzyć wszystkie pliki?
+ */
+extern bool BatchRun(char *scripts[], size_t count, size_t jobs, bool lazy, bool split_output);
+
+#endif //POLYNOMIALS_BATCH_H
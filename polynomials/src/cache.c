@@ -0,0 +1,408 @@
+/** @file
+ Implementacja pamięci podręcznej wyników kosztownych operacji na wielomianach
+
+ Wyniki są przechowywane w tablicy haszującej indeksowanej operacją i skrótami strukturalnymi
+ argumentów oraz na liście uporządkowanej od ostatnio używanego. Zarówno argumenty, jak i wynik
+ są współdzielone (PolyShare), więc trafienie kosztuje jedno porównanie argumentów, które dla
+ współdzielonych wielomianów sprowadza się do porównania wskaźników.
+
+ @author Julia Karmowska
+ @date 2021
+*/
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include "cache.h"
+#include "memory.h"
+
+/**
+ * To jest stała reprezentująca początkowy rozmiar tablicy haszującej wyników
+ */
+#define INITIAL_CACHE_SIZE 64
+
+/**
+ * Typ opisujący zapamiętywaną operację.
+ */
+typedef enum CacheOp {
+    CACHE_MUL,      ///< mnożenie dwóch wielomianów
+    CACHE_COMPOSE   ///< złożenie wielomianu z wielomianami
+} CacheOp;
+
+/**
+ * Struktura opisująca zapamiętany wynik operacji.
+ */
+typedef struct CacheEntry {
+    CacheOp op;                 ///< operacja
+    uint64_t key;               ///< klucz w tablicy haszującej
+    size_t count;               ///< liczba argumentów
+    Poly *args;                 ///< współdzielone argumenty
+    Poly result;                ///< współdzielony wynik
+    size_t bytes;               ///< pamięć zajmowana przez wpis
+    struct CacheEntry *next;    ///< następny wpis w tym samym kubełku
+    struct CacheEntry *newer;   ///< wpis używany później
+    struct CacheEntry *older;   ///< wpis używany wcześniej
+} CacheEntry;
+
+/**
+ * Struktura opisująca pamięć podręczną.
+ */
+struct Cache {
+    CacheEntry **buckets;   ///< kubełki tablicy haszującej
+    size_t size;            ///< liczba kubełków
+    size_t used;            ///< liczba wpisów
+    size_t bytes;           ///< pamięć zajmowana przez wszystkie wpisy
+    CacheEntry *newest;     ///< ostatnio używany wpis
+    CacheEntry *oldest;     ///< najdawniej używany wpis
+    CacheStats stats;       ///< liczniki
+};
+
+/**
+ * Własna pamięć podręczna wyników wątku. Każdy wątek ma własną pamięć podręczną, bo leniwie
+ * wyznaczane metadane wielomianów (skróty strukturalne) nie są synchronizowane między wątkami.
+ * Pamięć podręczna utworzona przez CacheNew może przechodzić między wątkami (CacheBind), bo przed
+ * zapamiętaniem wyniku metadane jego i argumentów są już wyznaczone, więc później są tylko czytane.
+ */
+static _Thread_local Cache own;
+
+/**
+ * Pamięć podręczna przypisana wątkowi przez CacheBind albo NULL.
+ */
+static _Thread_local Cache *bound;
+
+/**
+ * Limit pamięci każdej z pamięci podręcznych.
+ */
+static size_t budget = CACHE_DEFAULT_BUDGET;
+
+/**
+ * Liczniki pamięci podręcznych wyczyszczonych przez CacheClear.
+ */
+static struct {
+    atomic_size_t hits;         ///< liczba trafień
+    atomic_size_t misses;       ///< liczba chybień
+    atomic_size_t evictions;    ///< liczba usuniętych wyników
+} totals;
+
+/**
+ * Daje pamięć podręczną, z której korzysta bieżący wątek.
+ * @return pamięć podręczna
+ */
+static inline Cache *CurrentCache(void)
+{
+    return bound != NULL ? bound : &own;
+}
+
+/**
+ * Wyznacza klucz operacji. Mnożenie jest przemienne, więc skróty jego argumentów są
+ * łączone niezależnie od kolejności.
+ * @param[in] op : operacja
+ * @param[in] count : liczba argumentów
+ * @param[in] args : argumenty
+ * @return klucz
+ */
+static uint64_t CacheKey(CacheOp op, size_t count, const Poly *args[])
+{
+    uint64_t key = PolyHashMix(op ^ ((uint64_t) count << 8));
+    if (op == CACHE_MUL)
+    {
+        uint64_t first = PolyHash(args[0]);
+        uint64_t second = PolyHash(args[1]);
+        if (first > second)
+        {
+            uint64_t temp = first;
+            first = second;
+            second = temp;
+        }
+        return PolyHashMix(PolyHashMix(key ^ first) ^ second);
+    }
+    for (size_t i = 0; i < count; i++)
+        key = PolyHashMix(key ^ PolyHash(args[i]));
+    return key;
+}
+
+/**
+ * Sprawdza, czy wpis dotyczy operacji @p op na argumentach @p args.
+ * @param[in] entry : wpis
+ * @param[in] op : operacja
+ * @param[in] count : liczba argumentów
+ * @param[in] args : argumenty
+ * @return czy wpis pasuje
+ */
+static bool EntryMatches(const CacheEntry *entry, CacheOp op, size_t count, const Poly *args[])
+{
+    if (entry->op != op || entry->count != count)
+        return false;
+    if (op == CACHE_MUL && !PolyIsEq(&entry->args[0], args[0]))
+        return PolyIsEq(&entry->args[0], args[1]) && PolyIsEq(&entry->args[1], args[0]);
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!PolyIsEq(&entry->args[i], args[i]))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Odłącza wpis od listy ostatnio używanych.
+ * @param[in] entry : wpis
+ */
+static void Unlink(CacheEntry *entry)
+{
+    Cache *cache = CurrentCache();
+    if (entry->newer != NULL)
+        entry->newer->older = entry->older;
+    else
+        cache->newest = entry->older;
+    if (entry->older != NULL)
+        entry->older->newer = entry->newer;
+    else
+        cache->oldest = entry->newer;
+}
+
+/**
+ * Wstawia wpis na początek listy ostatnio używanych.
+ * @param[in] entry : wpis
+ */
+static void LinkNewest(CacheEntry *entry)
+{
+    Cache *cache = CurrentCache();
+    entry->newer = NULL;
+    entry->older = cache->newest;
+    if (cache->newest != NULL)
+        cache->newest->newer = entry;
+    else
+        cache->oldest = entry;
+    cache->newest = entry;
+}
+
+/**
+ * Usuwa wpis z pamięci podręcznej i zwalnia go.
+ * @param[in] entry : wpis
+ */
+static void RemoveEntry(CacheEntry *entry)
+{
+    Cache *cache = CurrentCache();
+    CacheEntry **link = &cache->buckets[entry->key % cache->size];
+    while (*link != entry)
+        link = &(*link)->next;
+    *link = entry->next;
+    Unlink(entry);
+    cache->used--;
+    cache->bytes -= entry->bytes;
+
+    for (size_t i = 0; i < entry->count; i++)
+        PolyDestroy(&entry->args[i]);
+    PolyDestroy(&entry->result);
+    free(entry->args);
+    free(entry);
+
+    if (cache->used == 0)
+    {
+        free(cache->buckets);
+        cache->buckets = NULL;
+        cache->size = 0;
+    }
+}
+
+/**
+ * Usuwa najdawniej używane wpisy, dopóki pamięć podręczna przekracza limit.
+ */
+static void EvictOverBudget(void)
+{
+    Cache *cache = CurrentCache();
+    while (cache->oldest != NULL && cache->bytes > budget)
+    {
+        RemoveEntry(cache->oldest);
+        cache->stats.evictions++;
+    }
+}
+
+/**
+ * Szuka zapamiętanego wyniku operacji i przesuwa go na początek listy ostatnio używanych.
+ * @param[in] op : operacja
+ * @param[in] key : klucz operacji
+ * @param[in] count : liczba argumentów
+ * @param[in] args : argumenty
+ * @return wpis albo NULL, jeśli wyniku nie ma w pamięci podręcznej
+ */
+static CacheEntry *Lookup(CacheOp op, uint64_t key, size_t count, const Poly *args[])
+{
+    Cache *cache = CurrentCache();
+    if (cache->size == 0)
+        return NULL;
+    for (CacheEntry *entry = cache->buckets[key % cache->size]; entry != NULL; entry = entry->next)
+    {
+        if (entry->key == key && EntryMatches(entry, op, count, args))
+        {
+            Unlink(entry);
+            LinkNewest(entry);
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Zapamiętuje wynik operacji, jeśli mieści się w limicie pamięci.
+ * @param[in] op : operacja
+ * @param[in] key : klucz operacji
+ * @param[in] count : liczba argumentów
+ * @param[in] args : argumenty
+ * @param[in] result : wynik
+ */
+static void Insert(CacheOp op, uint64_t key, size_t count, const Poly *args[], const Poly *result)
+{
+    Cache *cache = CurrentCache();
+    size_t bytes = sizeof(CacheEntry) + count * sizeof(Poly) + PolyMemory(result);
+    for (size_t i = 0; i < count && bytes <= budget; i++)
+        bytes += PolyMemory(args[i]);
+    if (bytes > budget)
+        return;
+
+    if (cache->used >= cache->size)
+    {
+        size_t new_size = cache->size == 0 ? INITIAL_CACHE_SIZE : 2 * cache->size;
+        CacheEntry **buckets = calloc(new_size, sizeof(CacheEntry *));
+        CHECK_PTR(buckets);
+        for (size_t i = 0; i < cache->size; i++)
+        {
+            while (cache->buckets[i] != NULL)
+            {
+                CacheEntry *moved = cache->buckets[i];
+                cache->buckets[i] = moved->next;
+                moved->next = buckets[moved->key % new_size];
+                buckets[moved->key % new_size] = moved;
+            }
+        }
+        free(cache->buckets);
+        cache->buckets = buckets;
+        cache->size = new_size;
+    }
+
+    CacheEntry *entry = malloc(sizeof(CacheEntry));
+    CHECK_PTR(entry);
+    entry->args = malloc(count * sizeof(Poly));
+    CHECK_PTR(entry->args);
+    entry->op = op;
+    entry->key = key;
+    entry->count = count;
+    for (size_t i = 0; i < count; i++)
+        entry->args[i] = PolyShare(args[i]);
+    entry->result = PolyShare(result);
+    entry->bytes = bytes;
+    entry->next = cache->buckets[key % cache->size];
+    cache->buckets[key % cache->size] = entry;
+    LinkNewest(entry);
+    cache->used++;
+    cache->bytes += bytes;
+    EvictOverBudget();
+}
+
+/**
+ * Sprawdza, czy opłaca się zapamiętywać wynik operacji. Operacje na samych
+ * wielomianach stałych są tańsze niż wyszukiwanie w pamięci podręcznej.
+ * @param[in] count : liczba argumentów
+ * @param[in] args : argumenty
+ * @return czy zapamiętywać wynik
+ */
+static bool Worthwhile(size_t count, const Poly *args[])
+{
+    if (budget == 0)
+        return false;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!PolyIsCoeff(args[i]))
+            return true;
+    }
+    return false;
+}
+
+void CacheSetBudget(size_t bytes)
+{
+    budget = bytes;
+    EvictOverBudget();
+}
+
+Poly CachedMul(const Poly *p, const Poly *q)
+{
+    Cache *cache = CurrentCache();
+    const Poly *args[] = {p, q};
+    if (!Worthwhile(2, args))
+        return PolyMul(p, q);
+
+    uint64_t key = CacheKey(CACHE_MUL, 2, args);
+    CacheEntry *entry = Lookup(CACHE_MUL, key, 2, args);
+    if (entry != NULL)
+    {
+        cache->stats.hits++;
+        return PolyShare(&entry->result);
+    }
+    cache->stats.misses++;
+    Poly result = PolyMul(p, q);
+    Insert(CACHE_MUL, key, 2, args, &result);
+    return result;
+}
+
+Poly CachedCompose(const Poly *p, size_t k, const Poly q[])
+{
+    Cache *cache = CurrentCache();
+    const Poly **args = malloc((k + 1) * sizeof(Poly *));
+    CHECK_PTR(args);
+    args[0] = p;
+    for (size_t i = 0; i < k; i++)
+        args[i + 1] = &q[i];
+
+    Poly result;
+    if (!Worthwhile(k + 1, args))
+        result = PolyCompose(p, k, q);
+    else
+    {
+        uint64_t key = CacheKey(CACHE_COMPOSE, k + 1, args);
+        CacheEntry *entry = Lookup(CACHE_COMPOSE, key, k + 1, args);
+        if (entry != NULL)
+        {
+            cache->stats.hits++;
+            result = PolyShare(&entry->result);
+        } else
+        {
+            cache->stats.misses++;
+            result = PolyCompose(p, k, q);
+            Insert(CACHE_COMPOSE, key, k + 1, args, &result);
+        }
+    }
+    free(args);
+    return result;
+}
+
+CacheStats CacheGetStats(void)
+{
+    Cache *cache = CurrentCache();
+    CacheStats stats = cache->stats;
+    stats.hits += atomic_load(&totals.hits);
+    stats.misses += atomic_load(&totals.misses);
+    stats.evictions += atomic_load(&totals.evictions);
+    return stats;
+}
+
+void CacheClear(void)
+{
+    Cache *cache = CurrentCache();
+    while (cache->oldest != NULL)
+        RemoveEntry(cache->oldest);
+    atomic_fetch_add(&totals.hits, cache->stats.hits);
+    atomic_fetch_add(&totals.misses, cache->stats.misses);
+    atomic_fetch_add(&totals.evictions, cache->stats.evictions);
+    cache->stats = (CacheStats) {0, 0, 0};
+}
+
+Cache *CacheNew(void)
+{
+    Cache *cache = calloc(1, sizeof(Cache));
+    CHECK_PTR(cache);
+    return cache;
+}
+
+void CacheBind(Cache *cache)
+{
+    bound = cache;
+}
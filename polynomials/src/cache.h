@@ -0,0 +1,87 @@
+/** @file
+ Interfejs pamięci podręcznej wyników kosztownych operacji na wielomianach
+
+ @author Julia Karmowska
+ @date 2021
+*/
+
+#ifndef POLYNOMIALS_CACHE_H
+#define POLYNOMIALS_CACHE_H
+
+#include "poly.h"
+
+/**
+ * Domyślny limit pamięci zajmowanej przez zapamiętane wyniki (w bajtach).
+ */
+#define CACHE_DEFAULT_BUDGET ((size_t) 64 << 20)
+
+/**
+ * Struktura przechowująca liczniki pamięci podręcznej.
+ */
+typedef struct CacheStats {
+    size_t hits;        ///< liczba trafień
+    size_t misses;      ///< liczba chybień
+    size_t evictions;   ///< liczba wyników usuniętych z powodu limitu pamięci
+} CacheStats;
+
+/**
+ * Struktura opisująca pamięć podręczną wyników.
+ */
+typedef struct Cache Cache;
+
+/**
+ * Ustawia limit pamięci zajmowanej przez zapamiętane wyniki. Limit 0 wyłącza pamięć podręczną.
+ * Każdy wątek ma własną pamięć podręczną z tym samym limitem, więc limit należy ustawić przed
+ * uruchomieniem wątków. Jeśli zapamiętane wyniki przekraczają nowy limit, usuwa najdawniej używane.
+ * @param[in] bytes : limit w bajtach
+ */
+extern void CacheSetBudget(size_t bytes);
+
+/**
+ * Mnoży dwa wielomiany, korzystając z zapamiętanego wyniku, jeśli jest dostępny.
+ * Wynik jest równy PolyMul(@p p, @p q).
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @return @f$p * q@f$
+ */
+extern Poly CachedMul(const Poly *p, const Poly *q);
+
+/**
+ * Składa wielomiany, korzystając z zapamiętanego wyniku, jeśli jest dostępny.
+ * Wynik jest równy PolyCompose(@p p, @p k, @p q).
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] k : liczba wielomianów w tablicy @p q
+ * @param[in] q : tablica wielomianów
+ * @return @f$p(q_0, q_1, \ldots, q_{k-1})@f$
+ */
+extern Poly CachedCompose(const Poly *p, size_t k, const Poly q[]);
+
+/**
+ * Zwraca liczniki pamięci podręcznej bieżącego wątku powiększone o liczniki
+ * pamięci podręcznych wyczyszczonych już przez CacheClear.
+ * @return liczniki trafień, chybień i usunięć
+ */
+extern CacheStats CacheGetStats(void);
+
+/**
+ * Tworzy pustą pamięć podręczną, którą wątki mogą kolejno przypisywać sobie przez CacheBind,
+ * dzięki czemu zapamiętane wyniki przetrwają zakończenie wątku. Pamięć istnieje do końca programu.
+ * @return pamięć podręczna
+ */
+extern Cache *CacheNew(void);
+
+/**
+ * Przypisuje bieżącemu wątkowi pamięć podręczną utworzoną przez CacheNew; NULL przywraca własną
+ * pamięć podręczną wątku. Z jednej pamięci podręcznej może naraz korzystać tylko jeden wątek,
+ * a przekazanie jej innemu wątkowi musi być zsynchronizowane (np. muteksem).
+ * @param[in] cache : pamięć podręczna albo NULL
+ */
+extern void CacheBind(Cache *cache);
+
+/**
+ * Usuwa wszystkie zapamiętane wyniki i zwalnia pamięć podręczną, z której korzysta bieżący wątek.
+ * Każdy wątek powinien ją wywołać przed zakończeniem.
+ */
+extern void CacheClear(void);
+
+#endif //POLYNOMIALS_CACHE_H
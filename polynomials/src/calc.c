@@ -7,422 +7,162 @@
 
 #include <stdio.h>
 #include <stdlib.h>
-#include "stack.h"
-#include "poly.h"
-#include "parser.h"
-
-
-
-/**
- * Wstawia na wierzchołek stosu wielomian zerowy.
- * @param[in] stack : stos
- */
-void Zero(Stack **stack)
-{
-    Poly poly = PolyZero();
-    StackPush(&poly, stack);
-}
-
-/**
- * Sprawdza, czy na stosie jest co najmniej jeden wielomian - jeśli nie, wypisuje komunikat o niedomiarze wielomianów.
- * @param[in] stack : stos
- * @param[in] line_number : numer wiersza
- * @param[in] how_many_needed : ile wielomianów jest potrzebnych do wykonania polecenia
- * @return Czy na stosie jest jakiś wielomian?
- */
-bool EnoughInStack(Stack *stack, unsigned long line_number, size_t how_many_needed)
-{
-    if (StackCount(stack) < how_many_needed)
-    {
-        fprintf(stderr, "ERROR %lu STACK UNDERFLOW\n", line_number);
-        return false;
-    }
-    return true;
-}
-
-/**
- * Sprawdza, czy wielomian na wierzchołku stosu jest współczynnikiem – wypisuje 0 lub 1
- * @param[in] stack : stos
- * @param[in] line_number : numer wiersza
- */
-void IsCoeff(Stack **stack, unsigned long line_number)
-{
-    if (EnoughInStack(*stack, line_number, 1))
-    {
-        Poly top = StackTop(*stack);
-        if (PolyIsCoeff(&top))
-            printf("1\n");
-        else printf("0\n");
-    }
-}
-
-/**
- * Sprawdza, czy wielomian na wierzchołku stosu jest tożsamościowo równy zeru – wypisuje 0 lub 1.
- * @param[in] stack : stos
- * @param[in] line_number : numer wiersza
- */
-void IsZero(Stack **stack, unsigned long line_number)
-{
-    if (EnoughInStack(*stack, line_number, 1))
-    {
-        Poly top = StackTop(*stack);
-        if (PolyIsZero(&top))
-            printf("1\n");
-        else printf("0\n");
-    }
-}
-
-/**
- * Wstawia na stos kopię wielomianu z wierzchołka.
- * @param[in] stack : stos
- * @param[in] line_number : numer wiersza
- */
-void Clone(Stack **stack, unsigned long line_number)
-{
-    if (EnoughInStack(*stack, line_number, 1))
-    {
-        Poly top = StackTop(*stack);
-        Poly new = PolyClone(&top);
-        StackPush(&new, stack);
-    }
-}
+#include <string.h>
+#include <unistd.h>
+#include "session.h"
+#include "batch.h"
+#include "server.h"
+#include "cache.h"
+#include "deferred.h"
 
 /**
- * Dodaje dwa wielomiany z wierzchu stosu, usuwa je i wstawia na wierzchołek stosu ich iloczyn.
- * @param[in] stack : stos
- * @param[in] line_number : numer wiersza
+ * Prefiks opcji ustawiającej limit pamięci podręcznej wyników.
  */
-void Add(Stack **stack, unsigned long line_number)
-{
-    if (EnoughInStack(*stack, line_number, 2))
-    {
-        Poly top = StackTop(*stack); //trzeba sklonować, bo gdy wykonujemy Pop, to wielomian z wierzchołka jest usuwany
-        Poly first = PolyClone(&top);
-        StackPop(stack);
-
-        top = StackTop(*stack);
-        Poly second = PolyClone(&top);
-        StackPop(stack);
-
-        Poly res = PolyAdd(&first, &second);
-        PolyDestroy(&first);
-        PolyDestroy(&second);
-        StackPush(&res, stack);
-    }
-}
+#define CACHE_SIZE_OPTION "--cache-size="
 
 /**
- * Mnoży dwa wielomiany z wierzchu stosu, usuwa je i wstawia na wierzchołek stosu ich iloczyn.
- * @param[in] stack : stos
- * @param[in] line_number : numer wiersza
+ * Opcja ustawiająca liczbę wątków wykonujących skrypty.
  */
-void Mul(Stack **stack, unsigned long line_number)
-{
-    if (EnoughInStack(*stack, line_number, 2))
-    {
-        Poly top = StackTop(*stack); //trzeba sklonować, bo gdy wykonujemy Pop, to wielomian z wierzchołka jest usuwany
-        Poly first = PolyClone(&top);
-        StackPop(stack);
-
-        top = StackTop(*stack);
-        Poly second = PolyClone(&top);
-        StackPop(stack);
-
-        Poly res = PolyMul(&first, &second);
-        PolyDestroy(&first);
-        PolyDestroy(&second);
-        StackPush(&res, stack);
-    }
-
-}
+#define JOBS_OPTION "--jobs"
 
 /**
- * Neguje wielomian na wierzchołku stosu.
- * @param[in] stack : stos
- * @param[in] line_number : numer wiersza
+ * Opcja uruchamiająca serwer na gnieździe uniksowym o podanej ścieżce.
  */
-void Neg(Stack **stack, unsigned long line_number)
-{
-    if (EnoughInStack(*stack, line_number, 1))
-    {
-        Poly top = StackTop(*stack);
-        Poly neg = PolyNeg(&top);
-        StackPop(stack);
-        StackPush(&neg, stack);
-    }
-}
+#define SERVER_OPTION "--server"
 
 /**
- * Odejmuje od wielomianu z wierzchołka wielomian pod wierzchołkiem, usuwa je i wstawia na wierzchołek stosu różnicę.
- * @param[in] stack : stos
- * @param[in] line_number : numer wiersza
+ * Opcja włączająca zwalnianie dużych wielomianów w osobnym wątku.
  */
-void Sub(Stack **stack, unsigned long line_number)
-{
-    if (EnoughInStack(*stack, line_number, 2))
-    {
-        Poly top = StackTop(*stack); //trzeba sklonować, bo gdy wykonujemy Pop, to wielomian z wierzchołka jest usuwany
-        Poly first = PolyClone(&top);
-        StackPop(stack);
-
-        top = StackTop(*stack);
-        Poly second = PolyClone(&top);
-        StackPop(stack);
-
-        Poly res = PolySub(&first, &second);
-        PolyDestroy(&first);
-        PolyDestroy(&second);
-        StackPush(&res, stack);
-    }
-}
+#define DEFERRED_FREE_OPTION "--deferred-free"
 
 /**
- * Sprawdza, czy dwa wielomiany na wierzchu stosu są równe – wypisuje 0 lub 1.
- * @param[in] stack : stos
- * @param[in] line_number : numer wiersza
+ * Wczytuje liczbę dodatnią zapisaną dziesiętnie.
+ * @param[in] value : napis
+ * @param[out] number : wczytana liczba
+ * @return Czy napis jest poprawną liczbą dodatnią?
  */
-void IsEq(Stack **stack, unsigned long line_number)
+static bool ParseCount(const char *value, size_t *number)
 {
-    if (EnoughInStack(*stack, line_number, 2))
-    {
-        Poly top = StackTop(*stack); //trzeba sklonować, bo gdy wykonujemy Pop, to wielomian z wierzchołka jest usuwany
-        Poly first = PolyClone(&top);
-        StackPop(stack);
-
-        Poly second = StackTop(*stack);
-        if (PolyIsEq(&first, &second))
-            printf("1\n");
-        else printf("0\n");
-
-        StackPush(&first, stack);
-
-    }
-}
-
-/**
- * Wypisuje stopień wielomianu z wierzchołka stosu.
- * @param[in] stack : stos
- * @param[in] line_number : numer wiersza
- */
-void Deg(Stack **stack, unsigned long line_number)
-{
-    if (EnoughInStack(*stack, line_number, 1))
-    {
-        Poly top = StackTop(*stack);
-        printf("%d\n", PolyDeg(&top));
-    }
-}
-
-/**
- * Wypisuje stopień wielomianu z wierzchołka stosu ze względu na zmienną o podanym numerze.
- * @param[in] stack : stos
- * @param[in] deg_by_var : numer zmiennej
- * @param[in] line_number : numer wiersza
- */
-void DegBy(Stack **stack, unsigned long deg_by_var, unsigned long line_number)
-{
-    if (EnoughInStack(*stack, line_number, 1))
-    {
-        Poly top = StackTop(*stack);
-        poly_exp_t deg = PolyDegBy(&top, deg_by_var);
-        printf("%d\n", deg);
-    }
-}
-
-
-/**
- * Wylicza wartość wielomianu w punkcie, usuwa wielomian z wierzchołka i wstawia na stos wynik operacji.
- * @param[in] stack : stos
- * @param[in] at_val : punkt, dla którego wyliczana jest wartość wielomianu
- * @param[in] line_number : numer wiersza
- */
-void At(Stack **stack, long at_val, unsigned long line_number)
-{
-    if (EnoughInStack(*stack, line_number, 1))
-    {
-        Poly top = StackTop(*stack);
-        Poly new = PolyAt(&top, at_val);
-        StackPop(stack);
-        StackPush(&new, stack);
-    }
-}
-
-/**
- * Wypisuje wielomian z wierzchołka stosu.
- * @param[in] stack : stos
- * @param[in] line_number : numer wiersza
- */
-void Print(Stack **stack, unsigned long line_number)
-{
-    if (EnoughInStack(*stack, line_number, 1))
-    {
-        Poly top = StackTop(*stack);
-        PolyPrint(&top);
-        printf("\n");
-    }
-}
-
-/**
- * Zdejmuje wielomian ze stosu.
- * @param[in] stack : stos
- * @param[in] line_number : numer wiersza
- */
-void Pop(Stack **stack, unsigned long line_number)
-{
-    if (EnoughInStack(*stack, line_number, 1))
-        StackPop(stack);
-}
-
-/**
- * Dodaje wielomian na stos.
- * @param[in] stack : stos
- * @param[in] poly : wielomian
- */
-void NewPoly(Stack **stack, Poly *poly)
-{
-    StackPush(poly, stack);
-}
-
-/**
- * Zdejmuje z wierzchołka stosu najpierw wielomian p, a potem kolejno wielomiany
- * q[k - 1], q[k - 2], …, q[0] i umieszcza na stosie wynik operacji złożenia.
- * @param[in] stack : stos
- * @param[in] k : liczba wielomianów do zdjęcia ze stosu, nie wliczając pierwszego
- * @param[in] line_number : numer wiersza
- */
-void Compose(Stack **stack, size_t k, unsigned long line_number)
-{
-    if (StackCount(*stack) == 0 || StackCount(*stack) - 1 < k)//nie używam EnoughInStack, bo k+1 może spowodować overflow
-    {
-        fprintf(stderr, "ERROR %lu STACK UNDERFLOW\n", line_number);
-        return;
-    }
-
-    Poly top = StackTop(*stack);
-    Poly p = PolyClone(&top);
-    StackPop(stack);
-
-    Poly *q = calloc(k, sizeof(Poly));
-    assert(q);
-    for (size_t i = 0; i < k; i++)
-        q[i] = PolyZero();
-
-    for (size_t i = 1; i <= k; i++)
-    {
-        top = StackTop(*stack);
-        q[k - i] = PolyClone(&top);
-        StackPop(stack);
-    }
-    Poly res = PolyCompose(&p, k, q);
-    StackPush(&res, stack);
-    for (size_t i = 0; i < k; i++)
-        PolyDestroy(&(q[i]));
-    PolyDestroy(&p);
-    free(q);
-
+    char *end;
+    unsigned long long parsed = strtoull(value, &end, 10);
+    if (*value < '0' || *value > '9' || *end != '\0' || parsed == 0 || parsed > SIZE_MAX)
+        return false;
+    *number = (size_t) parsed;
+    return true;
 }
 
 /**
- * Wykonuje operację zgodną z typem wiersza. Jeśli wiersz był wielomianem, dodaje wielomian na stos.
- * Jeśli wiersz był poleceniem, wykonuje to polecenie.
- * Jeśli wiersz był błędny, wypisuje odpowiedni komunikat.
- * @param[in] line_number : numer wiersza
- * @param[in] type : typ wiersza
- * @param[in] stack : stos
- * @param[in] instruction_var : parametr polecenia DEG_BY, AT lub COMPOSE lub wielomian
+ * Wypisuje na standardowe wyjście diagnostyczne liczniki pamięci podręcznej wyników.
  */
-void Calculate(unsigned long line_number, LineType type, Stack **stack, InstructionVar instruction_var)
+static void PrintCacheStats(void)
 {
-    switch (type)
-    {
-        case WRONG_POLY:
-            fprintf(stderr, "ERROR %lu WRONG POLY\n", line_number);
-            break;
-        case WRONG_COMMAND:
-            fprintf(stderr, "ERROR %lu WRONG COMMAND\n", line_number);
-            break;
-        case DEG_BY_WRONG_VARIABLE:
-            fprintf(stderr, "ERROR %lu DEG BY WRONG VARIABLE\n", line_number);
-            break;
-        case AT_WRONG_VALUE:
-            fprintf(stderr, "ERROR %lu AT WRONG VALUE\n", line_number);
-            break;
-        case COMPOSE_WRONG_PARAMETER:
-            fprintf(stderr, "ERROR %lu COMPOSE WRONG PARAMETER\n", line_number);
-            break;
-        case ZERO:
-            Zero(stack);
-            break;
-        case IS_COEFF:
-            IsCoeff(stack, line_number);
-            break;
-        case IS_ZERO:
-            IsZero(stack, line_number);
-            break;
-        case CLONE:
-            Clone(stack, line_number);
-            break;
-        case ADD:
-            Add(stack, line_number);
-            break;
-        case MUL:
-            Mul(stack, line_number);
-            break;
-        case NEG:
-            Neg(stack, line_number);
-            break;
-        case SUB:
-            Sub(stack, line_number);
-            break;
-        case IS_EQ:
-            IsEq(stack, line_number);
-            break;
-        case DEG:
-            Deg(stack, line_number);
-            break;
-        case DEG_BY:
-            DegBy(stack, instruction_var.deg_by_var, line_number);
-            break;
-        case AT:
-            At(stack, instruction_var.at_val, line_number);
-            break;
-        case PRINT:
-            Print(stack, line_number);
-            break;
-        case POP:
-            Pop(stack, line_number);
-            break;
-        case POLY:
-            NewPoly(stack, &instruction_var.poly);
-            break;
-        case COMPOSE:
-            Compose(stack, instruction_var.compose_parameter, line_number);
-            break;
-        default:
-            break;
-    }
+    CacheStats stats = CacheGetStats();
+    fprintf(stderr, "cache hits %zu misses %zu evictions %zu\n", stats.hits, stats.misses, stats.evictions);
 }
 
 /**
- * Tworzy stos wielominów.
  * Wczytuje polecenia i wykonuje zgodne z nimi operacje na wielomianach.
- */
-int main()
-{
-    Stack *stack;
-    StackInit(&stack);
-    ParseResult parse_res;
-    parse_res.type = INITIAL_LINE_TYPE;
-    unsigned long line_number = 1;
-    while (parse_res.type != END_OF_FILE)
-    {
-        parse_res.variable.poly = PolyZero();
-        parse_res = ParseLine();
-        if (parse_res.type != IGNORED_LINE && parse_res.type != END_OF_FILE)
-            Calculate(line_number, parse_res.type, &stack, parse_res.variable);
-        line_number++;
-    }
-
-    StackClear(&stack);
-    return 0;
-}
\ No newline at end of file
+ * Bez argumentów niebędących opcjami czyta polecenia ze standardowego wejścia.
+ * W przeciwnym razie każdy argument jest ścieżką skryptu wykonywanego we własnej sesji,
+ * a opcja @c --jobs @c N ustala liczbę wątków wykonujących skrypty. Opcja @c --split-output
+ * zapisuje wyniki skryptów do osobnych plików. Opcja @c --server @c ścieżka uruchamia serwer
+ * obsługujący w @c N wątkach klientów łączących się przez gniazdo uniksowe. Opcja @c --lazy włącza tryb leniwy,
+ * a opcje @c --cache-size i @c --cache-stats sterują pamięcią podręczną wyników. Opcja @c --deferred-free
+ * przenosi zwalnianie dużych wielomianów do wątku w tle.
+ * @param[in] argc : liczba argumentów
+ * @param[in] argv : argumenty
+ * @return kod wyjścia
+ */
+int main(int argc, char *argv[])
+{
+    bool lazy = false;
+    bool cache_stats = false;
+    bool split_output = false;
+    bool deferred_free = false;
+    size_t jobs = 1;
+    const char *server_path = NULL;
+    char **scripts = calloc(argc, sizeof(char *));
+    size_t scripts_count = 0;
+    if (scripts == NULL)
+        return 1;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--lazy") == 0)
+            lazy = true;
+        else if (strcmp(argv[i], "--cache-stats") == 0)
+            cache_stats = true;
+        else if (strcmp(argv[i], "--split-output") == 0)
+            split_output = true;
+        else if (strcmp(argv[i], DEFERRED_FREE_OPTION) == 0)
+            deferred_free = true;
+        else if (strcmp(argv[i], JOBS_OPTION) == 0)
+        {
+            if (i + 1 == argc || !ParseCount(argv[i + 1], &jobs))
+            {
+                fprintf(stderr, "Wrong number of jobs\n");
+                free(scripts);
+                return 1;
+            }
+            i++;
+        } else if (strcmp(argv[i], SERVER_OPTION) == 0)
+        {
+            if (i + 1 == argc)
+            {
+                fprintf(stderr, "Missing server socket path\n");
+                free(scripts);
+                return 1;
+            }
+            server_path = argv[++i];
+        } else if (strncmp(argv[i], CACHE_SIZE_OPTION, strlen(CACHE_SIZE_OPTION)) == 0)
+        {
+            const char *value = argv[i] + strlen(CACHE_SIZE_OPTION);
+            char *end;
+            unsigned long long megabytes = strtoull(value, &end, 10);
+            if (*value < '0' || *value > '9' || *end != '\0' || megabytes > SIZE_MAX >> 20)
+            {
+                fprintf(stderr, "Wrong cache size %s\n", value);
+                free(scripts);
+                return 1;
+            }
+            CacheSetBudget((size_t) megabytes << 20);
+        } else if (strncmp(argv[i], "--", 2) == 0)
+        {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            free(scripts);
+            return 1;
+        } else
+            scripts[scripts_count++] = argv[i];
+    }
+
+    if (deferred_free)
+        DeferredStart();
+    bool success = true;
+    if (server_path != NULL && scripts_count > 0)
+    {
+        fprintf(stderr, "Scripts cannot be used with %s\n", SERVER_OPTION);
+        success = false;
+    } else if (server_path != NULL)
+    {
+        success = ServerRun(server_path, jobs, lazy);
+        if (!success)
+            fprintf(stderr, "Cannot listen on %s\n", server_path);
+    } else if (scripts_count > 0)
+        success = BatchRun(scripts, scripts_count, jobs, lazy, split_output);
+    else
+    {
+        Session session;
+        SessionInit(&session, stdout, stderr, lazy);
+        InputReader *input;
+        InputOpen(&input, STDIN_FILENO);
+        SessionRun(&session, input, true);
+        SessionDestroy(&session);
+        InputClose(&input);
+    }
+    free(scripts);
+    DeferredStop();
+
+    if (cache_stats)
+        PrintCacheStats();
+    CacheClear();
+    return success ? 0 : 1;
+}
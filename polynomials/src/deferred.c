@@ -0,0 +1,116 @@
+/** @file
+ Implementacja odkładania zwalniania dużych wielomianów do wątku w tle
+
+ Zwolnienie wielomianu zajmującego gigabajty to miliony wywołań free, które w zwykłym trybie
+ wykonuje polecenie zdejmujące wielomian ze stosu. Wątek wywołujący DeferredDestroy oddaje tylko
+ referencję korzenia (PolyReleaseLarge), a drzewo, które nie ma już właścicieli, wstawia do
+ kolejki wątku zwalniającego. Współdzielone poddrzewa tego drzewa mogą być nadal używane
+ przez sesje, dlatego liczniki referencji węzłów są atomowe.
+
+ @author Julia Karmowska
+ @date 2021
+*/
+
+/**
+ * Umożliwia działanie wątków POSIX.
+ */
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdlib.h>
+#include "deferred.h"
+
+/**
+ * To jest stała reprezentująca najmniejszy rozmiar drzewa (w bajtach), którego zwolnienie
+ * jest odkładane
+ */
+#define DEFERRED_MIN_BYTES (64 << 10)
+
+/**
+ * To jest stała reprezentująca liczbę miejsc w kolejce drzew czekających na zwolnienie
+ */
+#define DEFERRED_QUEUE_CAPACITY 1024
+
+/**
+ * Struktura opisująca wątek zwalniający i jego kolejkę.
+ */
+typedef struct Reclaimer {
+    Poly pending[DEFERRED_QUEUE_CAPACITY];  ///< drzewa czekające na zwolnienie
+    size_t used;                            ///< liczba drzew w kolejce
+    bool running;                           ///< czy wątek działa
+    bool stopping;                          ///< czy wątek ma się zakończyć po opróżnieniu kolejki
+    pthread_mutex_t lock;                   ///< chroni kolejkę i pole stopping
+    pthread_cond_t waiting;                 ///< sygnalizuje wstawienie drzewa albo zatrzymanie
+    pthread_t thread;                       ///< wątek zwalniający
+} Reclaimer;
+
+/**
+ * Wątek zwalniający.
+ */
+static Reclaimer reclaimer = {.lock = PTHREAD_MUTEX_INITIALIZER, .waiting = PTHREAD_COND_INITIALIZER};
+
+/**
+ * Treść wątku zwalniającego: zwalnia kolejne drzewa z kolejki, aż zostanie zatrzymany,
+ * a kolejka będzie pusta.
+ * @param[in] arg : nieużywany
+ * @return NULL
+ */
+static void *ReclaimerThread(void *arg)
+{
+    (void) arg;
+    pthread_mutex_lock(&reclaimer.lock);
+    while (true)
+    {
+        while (reclaimer.used == 0 && !reclaimer.stopping)
+            pthread_cond_wait(&reclaimer.waiting, &reclaimer.lock);
+        if (reclaimer.used == 0)
+            break;
+        Poly tree = reclaimer.pending[--reclaimer.used];
+        pthread_mutex_unlock(&reclaimer.lock);
+        PolyDestroyReleased(&tree);
+        pthread_mutex_lock(&reclaimer.lock);
+    }
+    pthread_mutex_unlock(&reclaimer.lock);
+    return NULL;
+}
+
+void DeferredStart(void)
+{
+    if (pthread_create(&reclaimer.thread, NULL, ReclaimerThread, NULL) != 0)
+        exit(1);
+    reclaimer.running = true;
+}
+
+void DeferredStop(void)
+{
+    if (!reclaimer.running)
+        return;
+    pthread_mutex_lock(&reclaimer.lock);
+    reclaimer.stopping = true;
+    pthread_cond_signal(&reclaimer.waiting);
+    pthread_mutex_unlock(&reclaimer.lock);
+    pthread_join(reclaimer.thread, NULL);
+    reclaimer.running = false;
+    reclaimer.stopping = false;
+}
+
+void DeferredDestroy(Poly *p)
+{
+    if (!reclaimer.running)
+    {
+        PolyDestroy(p);
+        return;
+    }
+    if (!PolyReleaseLarge(p, DEFERRED_MIN_BYTES))
+        return;
+    pthread_mutex_lock(&reclaimer.lock);
+    bool queued = reclaimer.used < DEFERRED_QUEUE_CAPACITY;
+    if (queued)
+    {
+        reclaimer.pending[reclaimer.used++] = *p;
+        pthread_cond_signal(&reclaimer.waiting);
+    }
+    pthread_mutex_unlock(&reclaimer.lock);
+    if (!queued) //wątek nie nadąża, więc wywołujący zwalnia drzewo sam
+        PolyDestroyReleased(p);
+}
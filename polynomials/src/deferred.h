@@ -0,0 +1,33 @@
+/** @file
+ Interfejs odkładania zwalniania dużych wielomianów do wątku w tle
+
+ @author Julia Karmowska
+ @date 2021
+*/
+
+#ifndef POLYNOMIALS_DEFERRED_H
+#define POLYNOMIALS_DEFERRED_H
+
+#include "poly.h"
+
+/**
+ * Uruchamia wątek, który w tle zwalnia duże wielomiany przekazane przez DeferredDestroy.
+ * Trzeba ją wywołać przed uruchomieniem sesji.
+ */
+extern void DeferredStart(void);
+
+/**
+ * Czeka, aż wątek zwolni wszystkie przekazane mu wielomiany, i go zatrzymuje.
+ * Można ją wywołać dopiero po zakończeniu wszystkich sesji.
+ */
+extern void DeferredStop(void);
+
+/**
+ * Usuwa wielomian z pamięci. Jeśli wątek zwalniający działa, a wielomian był ostatnim
+ * właścicielem dużego drzewa, drzewo jest zwalniane w tle, a funkcja wraca od razu.
+ * Gdy w kolejce wątku czeka już zbyt wiele drzew, drzewo jest zwalniane od razu.
+ * @param[in] p : wielomian
+ */
+extern void DeferredDestroy(Poly *p);
+
+#endif //POLYNOMIALS_DEFERRED_H
@@ -0,0 +1,601 @@
+/** @file
+ Implementacja leniwych wyrażeń na wielomianach (acyklicznego grafu wyrażeń)
+
+ @author Julia Karmowska
+ @date 2021
+*/
+
+#include <limits.h>
+#include <stdlib.h>
+#include "expr.h"
+#include "cache.h"
+#include "deferred.h"
+#include "memory.h"
+
+/**
+ * To jest stała reprezentująca początkowy rozmiar tablicy haszującej wyrażeń
+ */
+#define INITIAL_TABLE_SIZE 64
+
+/**
+ * To jest stała reprezentująca liczbę punktów, w których znane są wartości wyrażeń
+ */
+#define EXPR_SAMPLES 2
+
+/**
+ * To jest stała reprezentująca nieznane ograniczenie stopnia wyrażenia
+ */
+#define DEG_BOUND_UNKNOWN LONG_MAX
+
+/**
+ * Struktura opisująca węzeł wyrażenia.
+ */
+struct Expr {
+    ExprOp op;          ///< operacja
+    size_t refs;        ///< liczba referencji
+    size_t count;       ///< liczba argumentów (0 po wyliczeniu wartości)
+    Expr **args;        ///< argumenty operacji (NULL po wyliczeniu wartości)
+    uint64_t key;       ///< klucz w tablicy haszującej
+    bool evaluated;     ///< czy wartość jest znana
+    Poly value;         ///< wartość wyrażenia, jeśli jest znana
+    long deg_bound;     ///< ograniczenie górne stopnia wartości (-1 tylko dla zera) albo DEG_BOUND_UNKNOWN
+    bool sampled;       ///< czy znane są wartości wyrażenia w punktach
+    uint64_t samples[EXPR_SAMPLES]; ///< wartości wyrażenia modulo 2^64 w stałych punktach pseudolosowych
+    Expr *next;         ///< następny węzeł w tym samym kubełku tablicy haszującej
+};
+
+/**
+ * Struktura opisująca tablicę haszującą wszystkich istniejących wyrażeń.
+ * Służy do eliminacji wspólnych podwyrażeń.
+ */
+typedef struct ExprTable {
+    Expr **buckets;     ///< kubełki
+    size_t size;        ///< liczba kubełków
+    size_t used;        ///< liczba wyrażeń w tablicy
+} ExprTable;
+
+/**
+ * Struktura opisująca rosnącą tablicę wskaźników na wyrażenia.
+ */
+typedef struct ExprList {
+    Expr **items;       ///< wskaźniki na wyrażenia
+    size_t size;        ///< rozmiar tablicy
+    size_t used;        ///< liczba wyrażeń w tablicy
+} ExprList;
+
+/**
+ * Tablica haszująca wszystkich istniejących wyrażeń. Każdy wątek ma własną tablicę,
+ * więc wyrażenia nie mogą być przekazywane między wątkami.
+ */
+static _Thread_local ExprTable table;
+
+/**
+ * Dodaje wyrażenie na koniec listy.
+ * @param[in] list : lista
+ * @param[in] expr : wyrażenie
+ */
+static void ListPush(ExprList *list, Expr *expr)
+{
+    if (list->used >= list->size)
+    {
+        list->size = list->size == 0 ? INITIAL_ARRAY_SIZE : 2 * list->size;
+        list->items = realloc(list->items, list->size * sizeof(Expr *));
+        CHECK_PTR(list->items);
+    }
+    list->items[list->used++] = expr;
+}
+
+/**
+ * Wyznacza klucz wyrażenia o znanej wartości.
+ * @param[in] poly : wartość
+ * @return klucz
+ */
+static uint64_t ValueKey(const Poly *poly)
+{
+    return PolyHashMix(PolyHash(poly) ^ EXPR_VALUE);
+}
+
+/**
+ * Wyznacza klucz niewyliczonego wyrażenia.
+ * @param[in] op : operacja
+ * @param[in] count : liczba argumentów
+ * @param[in] args : argumenty
+ * @return klucz
+ */
+static uint64_t NodeKey(ExprOp op, size_t count, Expr *args[])
+{
+    uint64_t key = PolyHashMix(op);
+    for (size_t i = 0; i < count; i++)
+        key = PolyHashMix(key ^ (uintptr_t) args[i]);
+    return key;
+}
+
+/**
+ * Wstawia wyrażenie do tablicy haszującej, powiększając ją, jeśli to konieczne.
+ * @param[in] expr : wyrażenie
+ */
+static void TableInsert(Expr *expr)
+{
+    if (table.used >= table.size)
+    {
+        size_t new_size = table.size == 0 ? INITIAL_TABLE_SIZE : 2 * table.size;
+        Expr **buckets = calloc(new_size, sizeof(Expr *));
+        CHECK_PTR(buckets);
+        for (size_t i = 0; i < table.size; i++)
+        {
+            while (table.buckets[i] != NULL)
+            {
+                Expr *moved = table.buckets[i];
+                table.buckets[i] = moved->next;
+                moved->next = buckets[moved->key % new_size];
+                buckets[moved->key % new_size] = moved;
+            }
+        }
+        free(table.buckets);
+        table.buckets = buckets;
+        table.size = new_size;
+    }
+    expr->next = table.buckets[expr->key % table.size];
+    table.buckets[expr->key % table.size] = expr;
+    table.used++;
+}
+
+/**
+ * Usuwa wyrażenie z tablicy haszującej.
+ * @param[in] expr : wyrażenie
+ */
+static void TableRemove(Expr *expr)
+{
+    Expr **link = &table.buckets[expr->key % table.size];
+    while (*link != expr)
+        link = &(*link)->next;
+    *link = expr->next;
+    table.used--;
+    if (table.used == 0)
+    {
+        free(table.buckets);
+        table.buckets = NULL;
+        table.size = 0;
+    }
+}
+
+void ExprFreeze(Expr *expr)
+{
+    Poly frozen = PolyFreeze(ExprValue(expr));
+    PolyDestroy(&expr->value);
+    expr->value = frozen;
+}
+
+Expr *ExprRetain(Expr *expr)
+{
+    expr->refs++;
+    return expr;
+}
+
+void ExprRelease(Expr *expr)
+{
+    ExprList pending = {NULL, 0, 0};
+    ListPush(&pending, expr);
+    while (pending.used > 0)
+    {
+        Expr *current = pending.items[--pending.used];
+        if (--current->refs > 0)
+            continue;
+        TableRemove(current);
+        if (current->evaluated)
+            DeferredDestroy(&current->value);
+        for (size_t i = 0; i < current->count; i++)
+            ListPush(&pending, current->args[i]);
+        free(current->args);
+        free(current);
+    }
+    free(pending.items);
+}
+
+/**
+ * Wyznacza wartości wielomianu w punktach, w których znane są wartości wyrażeń.
+ * Zmienna @f$x_i@f$ ma w punkcie @f$j@f$ wartość PolyHashMix(EXPR_SAMPLES * i + j).
+ * @param[in] poly : wielomian
+ * @param[out] samples : wartości
+ */
+static void SamplePoly(const Poly *poly, uint64_t samples[])
+{
+    size_t k = PolyVarCount(poly);
+    poly_coeff_t *xs = calloc(k > 0 ? 2 * k : 1, sizeof(poly_coeff_t));
+    CHECK_PTR(xs);
+    poly_coeff_t *grad = xs + k;
+    for (size_t j = 0; j < EXPR_SAMPLES; j++)
+    {
+        for (size_t i = 0; i < k; i++)
+            xs[i] = (poly_coeff_t) PolyHashMix(EXPR_SAMPLES * i + j);
+        poly_coeff_t value;
+        PolyEvalGrad(poly, k, xs, &value, grad);
+        samples[j] = (uint64_t) value;
+    }
+    free(xs);
+}
+
+/**
+ * Wyznacza ograniczenie stopnia i wartości w punktach niewyliczonego wyrażenia na podstawie
+ * jego argumentów. Wartościowanie modulo @f$2^{64}@f$ jest homomorfizmem, więc wartości
+ * argumentów łączą się tymi samymi działaniami co wielomiany.
+ * @param[in] expr : wyrażenie
+ */
+static void Summarize(Expr *expr)
+{
+    Expr **args = expr->args;
+    expr->sampled = true;
+    for (size_t i = 0; i < expr->count; i++)
+        expr->sampled &= args[i]->sampled;
+    long first = args[0]->deg_bound;
+    long second = expr->count > 1 ? args[1]->deg_bound : -1;
+    switch (expr->op)
+    {
+        case EXPR_ADD:
+        case EXPR_SUB:
+            expr->deg_bound = first > second ? first : second;
+            break;
+        case EXPR_NEG:
+            expr->deg_bound = first;
+            break;
+        case EXPR_MUL:
+            if (first == -1 || second == -1)
+                expr->deg_bound = -1;
+            else if (first == DEG_BOUND_UNKNOWN || second == DEG_BOUND_UNKNOWN || first + second > INT_MAX)
+                expr->deg_bound = DEG_BOUND_UNKNOWN;
+            else
+                expr->deg_bound = first + second;
+            break;
+        default: //złożenie
+        {
+            long max = 0;
+            for (size_t i = 1; i < expr->count; i++)
+            {
+                if (args[i]->deg_bound > max)
+                    max = args[i]->deg_bound;
+            }
+            if (first == -1 || max == 0) //złożenie z samymi stałymi jest stałą
+                expr->deg_bound = first == -1 ? -1 : 0;
+            else if (first == DEG_BOUND_UNKNOWN || max == DEG_BOUND_UNKNOWN || first > INT_MAX / max)
+                expr->deg_bound = DEG_BOUND_UNKNOWN;
+            else
+                expr->deg_bound = first * max;
+            //wartość złożenia w punkcie to wartość wielomianu w punkcie złożonym z wartości argumentów
+            expr->sampled &= args[0]->evaluated;
+            break;
+        }
+    }
+    if (!expr->sampled)
+        return;
+    for (size_t j = 0; j < EXPR_SAMPLES; j++)
+    {
+        uint64_t a = args[0]->samples[j];
+        uint64_t b = expr->count > 1 ? args[1]->samples[j] : 0;
+        switch (expr->op)
+        {
+            case EXPR_ADD:
+                expr->samples[j] = a + b;
+                break;
+            case EXPR_SUB:
+                expr->samples[j] = a - b;
+                break;
+            case EXPR_NEG:
+                expr->samples[j] = 0 - a;
+                break;
+            case EXPR_MUL:
+                expr->samples[j] = a * b;
+                break;
+            default:
+            {
+                size_t k = expr->count - 1;
+                poly_coeff_t *xs = calloc(2 * k + 1, sizeof(poly_coeff_t));
+                CHECK_PTR(xs);
+                for (size_t i = 0; i < k; i++)
+                    xs[i] = (poly_coeff_t) args[i + 1]->samples[j];
+                poly_coeff_t value;
+                PolyEvalGrad(&args[0]->value, k, xs, &value, xs + k);
+                expr->samples[j] = (uint64_t) value;
+                free(xs);
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * Tworzy nowy węzeł wyrażenia.
+ * @return węzeł z jedną referencją
+ */
+static Expr *NewNode(void)
+{
+    Expr *expr = calloc(1, sizeof(Expr));
+    CHECK_PTR(expr);
+    expr->refs = 1;
+    return expr;
+}
+
+Expr *ExprFromPoly(Poly *poly)
+{
+    uint64_t key = ValueKey(poly);
+    if (table.size > 0)
+    {
+        for (Expr *found = table.buckets[key % table.size]; found != NULL; found = found->next)
+        {
+            if (found->key == key && found->evaluated && PolyIsEq(&found->value, poly))
+            {
+                PolyDestroy(poly);
+                return ExprRetain(found);
+            }
+        }
+    }
+    Expr *expr = NewNode();
+    expr->op = EXPR_VALUE;
+    expr->evaluated = true;
+    expr->value = *poly;
+    expr->key = key;
+    expr->deg_bound = PolyDeg(poly);
+    expr->sampled = true;
+    SamplePoly(poly, expr->samples);
+    TableInsert(expr);
+    return expr;
+}
+
+Expr *ExprNew(ExprOp op, size_t count, Expr *args[])
+{
+    assert(op != EXPR_VALUE && count > 0);
+    //dodawanie i mnożenie są przemienne, więc porządkujemy argumenty
+    if ((op == EXPR_ADD || op == EXPR_MUL) && count == 2 && args[0] > args[1])
+    {
+        Expr *temp = args[0];
+        args[0] = args[1];
+        args[1] = temp;
+    }
+    uint64_t key = NodeKey(op, count, args);
+    if (table.size > 0)
+    {
+        for (Expr *found = table.buckets[key % table.size]; found != NULL; found = found->next)
+        {
+            if (found->key != key || found->evaluated || found->op != op || found->count != count)
+                continue;
+            size_t same = 0;
+            while (same < count && found->args[same] == args[same])
+                same++;
+            if (same == count)
+            {
+                for (size_t i = 0; i < count; i++)
+                    ExprRelease(args[i]);
+                return ExprRetain(found);
+            }
+        }
+    }
+    Expr *expr = NewNode();
+    expr->op = op;
+    expr->count = count;
+    expr->args = calloc(count, sizeof(Expr *));
+    CHECK_PTR(expr->args);
+    for (size_t i = 0; i < count; i++)
+        expr->args[i] = args[i];
+    expr->key = key;
+    Summarize(expr);
+    TableInsert(expr);
+    return expr;
+}
+
+/**
+ * Wyznacza argumenty, od których bezpośrednio zależy wyliczenie wyrażenia.
+ * Niewyliczone sumy (iloczyny) wewnątrz sumy (iloczynu), do których nie ma innych referencji,
+ * są spłaszczane, dzięki czemu kolejność działań może zostać wybrana przy wyliczaniu.
+ * @param[in] expr : wyrażenie
+ * @param[in] operands : lista, do której dopisywane są argumenty
+ */
+static void CollectOperands(Expr *expr, ExprList *operands)
+{
+    bool flatten = expr->op == EXPR_ADD || expr->op == EXPR_MUL;
+    ExprList pending = {NULL, 0, 0};
+    ListPush(&pending, expr);
+    while (pending.used > 0)
+    {
+        Expr *current = pending.items[--pending.used];
+        for (size_t i = current->count; i-- > 0;)
+        {
+            Expr *arg = current->args[i];
+            if (flatten && arg->op == expr->op && !arg->evaluated && arg->refs == 1)
+                ListPush(&pending, arg);
+            else
+                ListPush(operands, arg);
+        }
+    }
+    free(pending.items);
+}
+
+/**
+ * Wylicza sumę lub iloczyn wielu wielomianów, łącząc zawsze dwa najmniejsze,
+ * aby zminimalizować rozmiar wyników pośrednich.
+ * @param[in] op : EXPR_ADD lub EXPR_MUL
+ * @param[in] operands : wyliczone argumenty
+ * @return wynik operacji
+ */
+static Poly CombineSmallestFirst(ExprOp op, ExprList *operands)
+{
+    size_t count = operands->used;
+    Poly *polys = calloc(count, sizeof(Poly));
+    bool *owned = calloc(count, sizeof(bool));
+    CHECK_PTR(polys);
+    CHECK_PTR(owned);
+    for (size_t i = 0; i < count; i++)
+        polys[i] = operands->items[i]->value;
+
+    while (count > 1)
+    {
+        size_t first = 0;
+        size_t second = 1;
+        if (PolyTerms(&polys[second]) < PolyTerms(&polys[first]))
+        {
+            first = 1;
+            second = 0;
+        }
+        for (size_t i = 2; i < count; i++)
+        {
+            if (PolyTerms(&polys[i]) < PolyTerms(&polys[first]))
+            {
+                second = first;
+                first = i;
+            } else if (PolyTerms(&polys[i]) < PolyTerms(&polys[second]))
+                second = i;
+        }
+        Poly res = op == EXPR_ADD ? PolyAdd(&polys[first], &polys[second])
+                                  : CachedMul(&polys[first], &polys[second]);
+        if (owned[first])
+            PolyDestroy(&polys[first]);
+        if (owned[second])
+            PolyDestroy(&polys[second]);
+        polys[first] = res;
+        owned[first] = true;
+        count--;
+        polys[second] = polys[count];
+        owned[second] = owned[count];
+    }
+    Poly res = owned[0] ? polys[0] : PolyShare(&polys[0]);
+    free(polys);
+    free(owned);
+    return res;
+}
+
+/**
+ * Wylicza wartość wyrażenia, którego wszystkie argumenty są już wyliczone.
+ * Zwalnia referencje do argumentów i przenosi wyrażenie w tablicy haszującej pod klucz wartości.
+ * @param[in] expr : wyrażenie
+ * @param[in] operands : argumenty wyznaczone przez CollectOperands
+ */
+static void Evaluate(Expr *expr, ExprList *operands)
+{
+    Poly value;
+    switch (expr->op)
+    {
+        case EXPR_ADD:
+        case EXPR_MUL:
+            value = CombineSmallestFirst(expr->op, operands);
+            break;
+        case EXPR_SUB:
+            value = PolySub(&expr->args[0]->value, &expr->args[1]->value);
+            break;
+        case EXPR_NEG:
+            value = PolyNeg(&expr->args[0]->value);
+            break;
+        case EXPR_COMPOSE:
+        {
+            size_t k = expr->count - 1;
+            Poly *q = calloc(k, sizeof(Poly));
+            CHECK_PTR(q);
+            for (size_t i = 0; i < k; i++)
+                q[i] = expr->args[i + 1]->value;
+            value = CachedCompose(&expr->args[0]->value, k, q);
+            free(q);
+            break;
+        }
+        default:
+            assert(false);
+            value = PolyZero();
+            break;
+    }
+
+    TableRemove(expr);
+    for (size_t i = 0; i < expr->count; i++)
+        ExprRelease(expr->args[i]);
+    free(expr->args);
+    expr->args = NULL;
+    expr->count = 0;
+    expr->evaluated = true;
+    expr->value = value;
+    expr->deg_bound = PolyDeg(&value);
+    expr->key = ValueKey(&value);
+    TableInsert(expr);
+}
+
+const Poly *ExprValue(Expr *expr)
+{
+    ExprList work = {NULL, 0, 0};
+    ExprList operands = {NULL, 0, 0};
+    ListPush(&work, expr);
+    while (work.used > 0)
+    {
+        Expr *current = work.items[work.used - 1];
+        if (current->evaluated)
+        {
+            work.used--;
+            continue;
+        }
+        operands.used = 0;
+        CollectOperands(current, &operands);
+        bool ready = true;
+        for (size_t i = 0; i < operands.used; i++)
+        {
+            if (!operands.items[i]->evaluated)
+            {
+                ListPush(&work, operands.items[i]);
+                ready = false;
+            }
+        }
+        if (ready)
+        {
+            Evaluate(current, &operands);
+            work.used--;
+        }
+    }
+    free(work.items);
+    free(operands.items);
+    return &expr->value;
+}
+
+/**
+ * Daje wartość wyrażenia, o którym wiadomo, że jest stałe, bez wyliczania go, jeśli to możliwe.
+ * @param[in] expr : wyrażenie o ograniczeniu stopnia co najwyżej 0
+ * @return stała będąca wartością wyrażenia
+ */
+static poly_coeff_t ConstValue(Expr *expr)
+{
+    if (expr->sampled) //wartość wielomianu stałego w dowolnym punkcie to on sam
+        return (poly_coeff_t) expr->samples[0];
+    return ExprValue(expr)->coeff;
+}
+
+bool ExprIsZero(Expr *expr)
+{
+    if (expr->deg_bound == -1)
+        return true;
+    if (expr->sampled)
+    {
+        for (size_t j = 0; j < EXPR_SAMPLES; j++)
+        {
+            if (expr->samples[j] != 0)
+                return false;
+        }
+    }
+    if (expr->deg_bound == 0)
+        return ConstValue(expr) == 0;
+    return PolyIsZero(ExprValue(expr));
+}
+
+bool ExprIsCoeff(Expr *expr)
+{
+    if (expr->deg_bound <= 0)
+        return true;
+    if (expr->sampled)
+    {
+        for (size_t j = 1; j < EXPR_SAMPLES; j++)
+        {
+            if (expr->samples[j] != expr->samples[0]) //wielomian stały ma wszędzie tę samą wartość
+                return false;
+        }
+    }
+    return PolyIsCoeff(ExprValue(expr));
+}
+
+poly_exp_t ExprDeg(Expr *expr)
+{
+    if (expr->deg_bound == -1)
+        return -1;
+    if (expr->deg_bound == 0)
+        return ConstValue(expr) == 0 ? -1 : 0;
+    return PolyDeg(ExprValue(expr));
+}
@@ -0,0 +1,106 @@
+/** @file
+ Interfejs leniwych wyrażeń na wielomianach (acyklicznego grafu wyrażeń)
+
+ @author Julia Karmowska
+ @date 2021
+*/
+
+#ifndef POLYNOMIALS_EXPR_H
+#define POLYNOMIALS_EXPR_H
+
+#include "poly.h"
+
+/**
+ * Typ opisujący rodzaj węzła wyrażenia.
+ */
+typedef enum ExprOp {
+    EXPR_VALUE,     ///< wielomian o znanej wartości
+    EXPR_ADD,       ///< suma dwóch wyrażeń
+    EXPR_MUL,       ///< iloczyn dwóch wyrażeń
+    EXPR_SUB,       ///< różnica dwóch wyrażeń
+    EXPR_NEG,       ///< wyrażenie przeciwne
+    EXPR_COMPOSE    ///< złożenie pierwszego wyrażenia z pozostałymi
+} ExprOp;
+
+/**
+ * Struktura opisująca węzeł wyrażenia. Węzły są współdzielone i zliczają referencje.
+ */
+typedef struct Expr Expr;
+
+/**
+ * Tworzy wyrażenie o znanej wartości. Przejmuje na własność wielomian @p poly.
+ * Jeśli istnieje już wyrażenie o równej wartości, zwraca je, a @p poly niszczy.
+ * @param[in] poly : wielomian
+ * @return wyrażenie (nowa referencja)
+ */
+extern Expr *ExprFromPoly(Poly *poly);
+
+/**
+ * Tworzy wyrażenie będące wynikiem operacji @p op na argumentach @p args, nie wyliczając go.
+ * Przejmuje na własność referencje do argumentów. Jeśli istnieje już takie samo
+ * niewyliczone wyrażenie, zwraca je zamiast tworzyć nowe.
+ * Dla EXPR_SUB wynikiem jest @f$args[0] - args[1]@f$, a dla EXPR_COMPOSE
+ * złożenie @f$args[0]@f$ z wielomianami @f$args[1], \ldots, args[count - 1]@f$.
+ * @param[in] op : operacja
+ * @param[in] count : liczba argumentów
+ * @param[in] args : tablica argumentów
+ * @return wyrażenie (nowa referencja)
+ */
+extern Expr *ExprNew(ExprOp op, size_t count, Expr *args[]);
+
+/**
+ * Wylicza wartość wyrażenia, jeśli nie była jeszcze znana, i zwraca ją.
+ * Wielomian należy do wyrażenia.
+ * @param[in] expr : wyrażenie
+ * @return wartość wyrażenia
+ */
+extern const Poly *ExprValue(Expr *expr);
+
+/**
+ * Sprawdza, czy wartość wyrażenia jest tożsamościowo równa zeru. Wyrażenie jest wyliczane
+ * tylko wtedy, gdy nie rozstrzygają tego ograniczenie stopnia i wartości wyrażenia w stałych
+ * punktach, wyznaczane przy tworzeniu węzła bez rozwijania wielomianów.
+ * @param[in] expr : wyrażenie
+ * @return Czy wartość wyrażenia jest równa zeru?
+ */
+extern bool ExprIsZero(Expr *expr);
+
+/**
+ * Sprawdza, czy wartość wyrażenia jest wielomianem stałym. Wyrażenie jest wyliczane tylko wtedy,
+ * gdy nie rozstrzygają tego ograniczenie stopnia i wartości wyrażenia w stałych punktach.
+ * @param[in] expr : wyrażenie
+ * @return Czy wartość wyrażenia jest współczynnikiem?
+ */
+extern bool ExprIsCoeff(Expr *expr);
+
+/**
+ * Daje stopień wartości wyrażenia. Bez wyliczania wyrażenia rozstrzyga tylko wyrażenia stałe
+ * (o ograniczeniu stopnia co najwyżej 0); ograniczenie nie wystarcza w ogólności, bo współczynniki
+ * najwyższego stopnia mogą się skrócić.
+ * @param[in] expr : wyrażenie
+ * @return stopień wartości wyrażenia
+ */
+extern poly_exp_t ExprDeg(Expr *expr);
+
+/**
+ * Wylicza wartość wyrażenia i zastępuje ją równym jej wielomianem zamrożonym (PolyFreeze),
+ * więc zamrożoną wartość widzą wszyscy właściciele wyrażenia.
+ * @param[in] expr : wyrażenie
+ */
+extern void ExprFreeze(Expr *expr);
+
+/**
+ * Zwiększa licznik referencji wyrażenia.
+ * @param[in] expr : wyrażenie
+ * @return @p expr
+ */
+extern Expr *ExprRetain(Expr *expr);
+
+/**
+ * Zmniejsza licznik referencji wyrażenia i usuwa je z pamięci, jeśli był to ostatni właściciel.
+ * Wartości usuwanych wyrażeń nie są wyliczane.
+ * @param[in] expr : wyrażenie
+ */
+extern void ExprRelease(Expr *expr);
+
+#endif //POLYNOMIALS_EXPR_H
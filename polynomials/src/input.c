@@ -0,0 +1,165 @@
+/** @file
+ Implementacja czytnika wierszy danych wejściowych
+
+ @author Julia Karmowska
+ @date 2021
+*/
+
+/**
+ * Umożliwia działanie funkcji mmap, madvise i read.
+ */
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "input.h"
+#include "memory.h"
+
+/**
+ * To jest stała reprezentująca rozmiar bloku czytanego jednym wywołaniem read
+ */
+#define INPUT_CHUNK_SIZE (1 << 20)
+
+/**
+ * Struktura opisująca czytnik wierszy.
+ */
+struct InputReader {
+    int fd;             ///< deskryptor pliku
+    const char *map;    ///< odwzorowany plik albo NULL
+    size_t map_size;    ///< rozmiar odwzorowania
+    char *buf;          ///< bufor danych (blok czytanego źródła lub kopia ostatniego wiersza pliku)
+    size_t size;        ///< rozmiar bufora
+    size_t begin;       ///< początek nieprzekazanych danych
+    size_t end;         ///< koniec danych
+    bool eof;           ///< czy osiągnięto koniec źródła
+};
+
+/**
+ * Próbuje odwzorować w pamięci resztę zwykłego pliku, zaczynając od bieżącej pozycji.
+ * @param[in] reader : czytnik
+ * @return Czy plik został odwzorowany?
+ */
+static bool TryMap(InputReader *reader)
+{
+    struct stat st;
+    if (fstat(reader->fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0)
+        return false;
+    off_t offset = lseek(reader->fd, 0, SEEK_CUR);
+    if (offset < 0 || offset >= st.st_size)
+        return false;
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, reader->fd, 0);
+    if (map == MAP_FAILED)
+        return false;
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+    reader->map = map;
+    reader->map_size = st.st_size;
+    reader->begin = offset;
+    reader->end = st.st_size;
+    reader->eof = true;
+    return true;
+}
+
+void InputOpen(InputReader **reader, int fd)
+{
+    *reader = calloc(1, sizeof(InputReader));
+    CHECK_PTR(*reader);
+    (*reader)->fd = fd;
+    if (TryMap(*reader))
+        return;
+    (*reader)->size = INPUT_CHUNK_SIZE;
+    (*reader)->buf = malloc((*reader)->size + 1); //miejsce na '\0' za ostatnim wierszem
+    CHECK_PTR((*reader)->buf);
+}
+
+/**
+ * Dopełnia bufor danymi ze źródła. Nieprzekazane dane przesuwa na początek bufora,
+ * a jeśli wypełniają cały bufor, powiększa go.
+ * @param[in] reader : czytnik
+ */
+static void Refill(InputReader *reader)
+{
+    size_t left = reader->end - reader->begin;
+    if (reader->begin > 0)
+    {
+        memmove(reader->buf, reader->buf + reader->begin, left);
+        reader->begin = 0;
+        reader->end = left;
+    }
+    if (reader->end == reader->size)
+    {
+        if (reader->size > SIZE_MAX / 2)
+            exit(1);
+        reader->size *= 2;
+        reader->buf = realloc(reader->buf, reader->size + 1);
+        CHECK_PTR(reader->buf);
+    }
+    ssize_t count;
+    do
+        count = read(reader->fd, reader->buf + reader->end, reader->size - reader->end);
+    while (count < 0 && errno == EINTR);
+    if (count <= 0) //koniec danych lub błąd odczytu, tak jak w getline
+        reader->eof = true;
+    else
+        reader->end += count;
+}
+
+bool InputNextLine(InputReader *reader, const char **line, size_t *length)
+{
+    const char *data = reader->map != NULL ? reader->map : reader->buf;
+    size_t scanned = reader->begin;
+    while (true)
+    {
+        const char *newline = memchr(data + scanned, '\n', reader->end - scanned);
+        if (newline != NULL)
+        {
+            *line = data + reader->begin;
+            *length = newline + 1 - *line;
+            reader->begin += *length;
+            return true;
+        }
+        if (reader->eof)
+            break;
+        scanned = reader->end - reader->begin;
+        Refill(reader);
+        data = reader->buf;
+    }
+
+    if (reader->begin == reader->end)
+        return false;
+    *length = reader->end - reader->begin;
+    if (reader->map != NULL) //ostatni wiersz pliku kopiujemy, aby zakończyć go znakiem '\0'
+    {
+        free(reader->buf);
+        reader->buf = malloc(*length + 1);
+        CHECK_PTR(reader->buf);
+        memcpy(reader->buf, reader->map + reader->begin, *length);
+    } else if (reader->begin > 0)
+        memmove(reader->buf, reader->buf + reader->begin, *length);
+    reader->buf[*length] = '\0';
+    *line = reader->buf;
+    reader->begin = reader->end;
+    return true;
+}
+
+bool InputReady(const InputReader *reader)
+{
+    const char *data = reader->map != NULL ? reader->map : reader->buf;
+    return reader->eof || memchr(data + reader->begin, '\n', reader->end - reader->begin) != NULL;
+}
+
+void InputWait(InputReader *reader)
+{
+    while (!InputReady(reader))
+        Refill(reader);
+}
+
+void InputClose(InputReader **reader)
+{
+    if ((*reader)->map != NULL)
+        munmap((void *) (*reader)->map, (*reader)->map_size);
+    free((*reader)->buf);
+    free(*reader);
+}
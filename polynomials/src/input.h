@@ -0,0 +1,57 @@
+/** @file
+ Interfejs czytnika wierszy danych wejściowych
+
+ @author Julia Karmowska
+ @date 2021
+*/
+
+#ifndef POLYNOMIALS_INPUT_H
+#define POLYNOMIALS_INPUT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Struktura opisująca czytnik wierszy. Zwykły plik jest odwzorowywany w pamięci,
+ * a pozostałe źródła (potoki, terminale, gniazda) są czytane dużymi blokami.
+ */
+typedef struct InputReader InputReader;
+
+/**
+ * Tworzy czytnik wierszy z deskryptora pliku @p fd. Czytnik nie zamyka deskryptora.
+ * @param[in] reader : czytnik
+ * @param[in] fd : deskryptor pliku
+ */
+extern void InputOpen(InputReader **reader, int fd);
+
+/**
+ * Przekazuje kolejny wiersz bez kopiowania go. Wiersz zawiera końcowy znak '\n', o ile
+ * występuje on w danych. Ostatni wiersz bez znaku '\n' jest zakończony znakiem '\0'.
+ * Wiersz jest ważny do następnego wywołania funkcji.
+ * @param[in] reader : czytnik
+ * @param[out] line : początek wiersza
+ * @param[out] length : długość wiersza
+ * @return Czy wczytano wiersz (fałsz oznacza koniec danych)?
+ */
+extern bool InputNextLine(InputReader *reader, const char **line, size_t *length);
+
+/**
+ * Sprawdza, czy kolejny wiersz można przekazać bez czekania na dane ze źródła.
+ * @param[in] reader : czytnik
+ * @return Czy kolejny wiersz jest już w buforze albo osiągnięto koniec danych?
+ */
+extern bool InputReady(const InputReader *reader);
+
+/**
+ * Czeka na dane ze źródła, aż kolejny wiersz będzie można przekazać bez czekania (InputReady).
+ * @param[in] reader : czytnik
+ */
+extern void InputWait(InputReader *reader);
+
+/**
+ * Usuwa czytnik z pamięci.
+ * @param[in] reader : czytnik
+ */
+extern void InputClose(InputReader **reader);
+
+#endif //POLYNOMIALS_INPUT_H
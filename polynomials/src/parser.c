@@ -5,11 +5,6 @@
  @date 2021
 */
 
-/**
- * Umożliwia działanie funkcji getline.
- */
-#define _GNU_SOURCE
-
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -20,16 +15,6 @@
 #include "poly_parser.h"
 
 
-/**
- * To jest stała reprezentująca brak wczytanego wiersza
- */
-#define NO_INPUT -1
-
-/**
- * To jest stała reprezentująca błąd funkcji getline
- */
-#define GETLINE_ERROR -1
-
 /**
  * To jest stała reprezentująca znak spacji
  */
@@ -50,6 +35,56 @@
 */
 #define COMPOSE_LENGTH 7
 
+/**
+ * To jest stała reprezentująca długość wyrażenia 'STORE'
+*/
+#define STORE_LENGTH 5
+
+/**
+ * To jest stała reprezentująca długość wyrażenia 'LOAD'
+*/
+#define LOAD_LENGTH 4
+
+/**
+ * To jest stała reprezentująca długość wyrażenia 'SAVE'
+*/
+#define SAVE_LENGTH 4
+
+/**
+ * To jest stała reprezentująca długość wyrażenia 'SAVE_STACK'
+*/
+#define SAVE_STACK_LENGTH 10
+
+/**
+ * To jest stała reprezentująca długość wyrażenia 'RESTORE'
+*/
+#define RESTORE_LENGTH 7
+
+/**
+ * To jest stała reprezentująca długość wyrażenia 'SAVE_IMAGE'
+*/
+#define SAVE_IMAGE_LENGTH 10
+
+/**
+ * To jest stała reprezentująca długość wyrażenia 'MAP'
+*/
+#define MAP_LENGTH 3
+
+/**
+ * To jest stała reprezentująca długość wyrażenia 'REORDER'
+*/
+#define REORDER_LENGTH 7
+
+/**
+ * To jest stała reprezentująca długość wyrażenia 'SUBST'
+*/
+#define SUBST_LENGTH 5
+
+/**
+ * To jest stała reprezentująca długość wyrażenia 'LOAD_TERMS'
+*/
+#define LOAD_TERMS_LENGTH 10
+
 /**
  * To jest stała reprezentująca długość wyrażenia ' '
 */
@@ -63,25 +98,19 @@
 
 
 /**
- * Wczytuje wiersz wejścia.
- * @param[in] line wczytany wiersz
- * @return długość wiersza (lub NO_INPUT, jeśli nie ma wiersza do wczytania)
+ * Sprawdza, czy wiersz składa się dokładnie z polecenia @p command (ewentualnie zakończonego znakiem '\n').
+ * Wiersz nie musi być zakończony znakiem '\0'.
+ * @param[in] line : wiersz
+ * @param[in] length : długość wiersza
+ * @param[in] command : polecenie
+ * @return Czy wiersz jest poleceniem @p command?
  */
-static long read_line_into_string(char **line)
+static bool IsCommand(const char *line, long length, const char *command)
 {
-    size_t size = 0;
-    errno = 0;
-    long result;
-
-    result = getline(line, &size, stdin); //getline zwraca długość linii lub GETLINE_ERRROR
-
-    if (result == GETLINE_ERROR && errno == ENOMEM) //problem z pamięcią
-        exit(1);
-
-    else if (result == GETLINE_ERROR) //nie wczytano wiersza - koniec wejścia
-        return NO_INPUT;
-
-    return result;
+    long command_length = (long) strlen(command);
+    if (length != command_length && (length != command_length + 1 || line[command_length] != '\n'))
+        return false;
+    return memcmp(line, command, command_length) == 0;
 }
 
 /**
@@ -193,7 +222,7 @@ static bool AllNumbers(const char *line, long length)
  */
 static LineType CheckAt(char *line, long length, long *value)
 {
-    if ((strcmp(line, "AT") == 0 || strcmp(line, "AT\n") == 0))//length of 'DEG_BY x'
+    if (IsCommand(line, length, "AT"))//length of 'DEG_BY x'
         return AT_WRONG_VALUE;
     if (line[AT_LENGTH] != SPACE)
         return WRONG_COMMAND;
@@ -220,7 +249,7 @@ static LineType CheckAt(char *line, long length, long *value)
  */
 static LineType CheckDegBy(char *line, long length, unsigned long *value)
 {
-    if ((strcmp(line, "DEG_BY") == 0 || strcmp(line, "DEG_BY\n") == 0))
+    if (IsCommand(line, length, "DEG_BY"))
         return DEG_BY_WRONG_VARIABLE;
     if (line[DEG_BY_LENGTH] != SPACE)
         return WRONG_COMMAND;
@@ -248,7 +277,7 @@ static LineType CheckDegBy(char *line, long length, unsigned long *value)
  */
 static LineType CheckCompose(char *line, long length, unsigned long *value)
 {
-    if ((strcmp(line, "COMOPSE") == 0 || strcmp(line, "COMPOSE\n") == 0))
+    if (IsCommand(line, length, "COMPOSE"))
         return COMPOSE_WRONG_PARAMETER;
     if (line[COMPOSE_LENGTH] != SPACE)
         return WRONG_COMMAND;
@@ -266,6 +295,135 @@ static LineType CheckCompose(char *line, long length, unsigned long *value)
     return COMPOSE_WRONG_PARAMETER;
 }
 
+/**
+ * Sprawdza, czy wiersz jest poprawnym poleceniem REORDER, jeśli tak, to wczytuje liczbę zmiennych do @p value.
+ * @param[in] line : wiersz
+ * @param[in] length : długość wiersza
+ * @param[in] value : wczytana liczba zmiennych
+ * @return typ wiersza
+ */
+static LineType CheckReorder(char *line, long length, unsigned long *value)
+{
+    if (IsCommand(line, length, "REORDER"))
+        return REORDER_WRONG_PARAMETER;
+    if (line[REORDER_LENGTH] != SPACE)
+        return WRONG_COMMAND;
+    if (length < REORDER_LENGTH + SPACE_LENGTH + 1)//length of 'REORDER x'
+        return REORDER_WRONG_PARAMETER;
+    if (!AllNumbers(line + REORDER_LENGTH + SPACE_LENGTH, length - (REORDER_LENGTH + SPACE_LENGTH)))
+        return REORDER_WRONG_PARAMETER;
+    char *end;
+    if (isUnsignedLong(line + REORDER_LENGTH + SPACE_LENGTH, &end, value))
+    {
+        if (*end != '\0' && *end != '\n') //wystąpił błędny znak
+            return REORDER_WRONG_PARAMETER;
+        return REORDER;
+    }
+    return REORDER_WRONG_PARAMETER;
+}
+
+/**
+ * Sprawdza, czy wiersz jest poprawnym poleceniem SUBST, czyli czy po nazwie polecenia występują
+ * oddzielone spacjami pary @f$i=v@f$, gdzie @f$i@f$ jest numerem zmiennej, a @f$v@f$ jej wartością.
+ * Jeśli tak, to wczytuje pary do @p subst.
+ * @param[in] line : wiersz
+ * @param[in] length : długość wiersza
+ * @param[in] subst : wczytane podstawienia
+ * @return typ wiersza
+ */
+static LineType CheckSubst(char *line, long length, SubstParameter *subst)
+{
+    if (IsCommand(line, length, "SUBST"))
+        return SUBST_WRONG_PARAMETER;
+    if (line[SUBST_LENGTH] != SPACE)
+        return WRONG_COMMAND;
+    long end_of_line = line[length - 1] == '\n' ? length - 1 : length;
+    size_t count = 0;
+    for (long i = SUBST_LENGTH; i < end_of_line; i++)
+    {
+        //każda para zaczyna się za spacją i ma jeden znak '='
+        if (line[i] == SPACE)
+            count++;
+        else if (!isdigit(line[i]) && line[i] != '=' && line[i] != '-')
+            return SUBST_WRONG_PARAMETER;
+    }
+    subst->vars = malloc(count * sizeof(unsigned long));
+    subst->values = malloc(count * sizeof(poly_coeff_t));
+    if (subst->vars == NULL || subst->values == NULL)
+        exit(1);
+    subst->count = count;
+    char *pos = line + SUBST_LENGTH;
+    for (size_t i = 0; i < count; i++)
+    {
+        char *end;
+        pos++; //spacja
+        if (!isdigit(pos[0]) || !isUnsignedLong(pos, &end, &subst->vars[i]) || *end != '=')
+            break;
+        pos = end + 1;
+        if (!isdigit(pos[0]) && (pos[0] != '-' || !isdigit(pos[1])))
+            break;
+        if (!isLong(pos, &end, &subst->values[i]) || (i + 1 < count ? *end != SPACE : end != line + end_of_line))
+            break;
+        pos = end;
+        if (i + 1 == count)
+            return SUBST;
+    }
+    free(subst->vars);
+    free(subst->values);
+    return SUBST_WRONG_PARAMETER;
+}
+
+/**
+ * Sprawdza, czy wiersz jest poprawnym poleceniem z nazwą rejestru (STORE lub LOAD) albo ścieżką
+ * pliku (SAVE, SAVE_STACK, RESTORE, SAVE_IMAGE, MAP lub LOAD_TERMS), jeśli tak, to kopiuje argument do @p name.
+ * Nazwa rejestru składa się z liter, cyfr i znaków @f$_@f$, a ścieżka pliku z dowolnych znaków
+ * poza '\0'.
+ * @param[in] line : wiersz
+ * @param[in] length : długość wiersza
+ * @param[in] command_length : długość nazwy polecenia
+ * @param[in] type : typ poprawnego polecenia
+ * @param[in] wrong_type : typ błędu argumentu
+ * @param[in] is_path : czy argument jest ścieżką pliku
+ * @param[in] name : wczytany argument
+ * @return typ wiersza
+ */
+static LineType CheckArgument(const char *line, long length, long command_length, LineType type,
+                              LineType wrong_type, bool is_path, char **name)
+{
+    if (length == command_length || (length == command_length + 1 && line[command_length] == '\n'))
+        return wrong_type;
+    if (line[command_length] != SPACE)
+        return WRONG_COMMAND;
+    long begin = command_length + SPACE_LENGTH;
+    long end = line[length - 1] == '\n' ? length - 1 : length;
+    if (end == begin)
+        return wrong_type;
+    for (long i = begin; i < end; i++)
+    {
+        if (is_path ? line[i] == '\0' : !isalnum(line[i]) && line[i] != '_')
+            return wrong_type;
+    }
+    *name = malloc(end - begin + 1);
+    if (*name == NULL)
+        exit(1);
+    memcpy(*name, line + begin, end - begin);
+    (*name)[end - begin] = '\0';
+    return type;
+}
+
+/**
+ * Sprawdza, czy wiersz zaczyna się nazwą polecenia.
+ * @param[in] line : wiersz
+ * @param[in] length : długość wiersza
+ * @param[in] command : nazwa polecenia
+ * @param[in] command_length : długość nazwy polecenia
+ * @return Czy wiersz zaczyna się nazwą polecenia @p command?
+ */
+static bool BeginsWith(const char *line, long length, const char *command, long command_length)
+{
+    return length >= command_length && memcmp(line, command, command_length) == 0;
+}
+
 /**
  * Sprawdza czy każdy znak wiersza jest cyfrą, literą, lub jednym ze znaków: @f$-@f$, @f$+@f$,
  * @f$(@f$, @f$)@f$, @f$_@f$, spacją lub znakiem końca linii.
@@ -326,7 +484,7 @@ static bool BeginsWithCompose(const char *line, long length)
  * wczytaną wartość zmiennej.
  * @param[in] line : wiersz
  * @param[in] length : długość wiersza
- * @param[in] variable : parametr polecenia DEG_BY, AT lub COMPOSE lub wielomian
+ * @param[in] variable : parametr polecenia DEG_BY, AT, COMPOSE, REORDER lub SUBST lub wielomian
  * @return typ wiersza
  */
 static LineType
@@ -341,50 +499,76 @@ TypeOfInstruction(char *line, long length, InstructionVar *variable)
         return CheckDegBy(line, length, &variable->deg_by_var);
     if (BeginsWithCompose(line, length))
         return CheckCompose(line, length, &variable->compose_parameter);
+    if (BeginsWith(line, length, "STORE", STORE_LENGTH))
+        return CheckArgument(line, length, STORE_LENGTH, STORE, STORE_WRONG_NAME, false, &variable->name);
+    if (BeginsWith(line, length, "LOAD_TERMS", LOAD_TERMS_LENGTH))
+        return CheckArgument(line, length, LOAD_TERMS_LENGTH, LOAD_TERMS, LOAD_TERMS_WRONG_FILE, true,
+                             &variable->name);
+    if (BeginsWith(line, length, "LOAD", LOAD_LENGTH))
+        return CheckArgument(line, length, LOAD_LENGTH, LOAD, LOAD_WRONG_NAME, false, &variable->name);
+    if (BeginsWith(line, length, "SAVE_IMAGE", SAVE_IMAGE_LENGTH))
+        return CheckArgument(line, length, SAVE_IMAGE_LENGTH, SAVE_IMAGE, SAVE_IMAGE_WRONG_FILE, true,
+                             &variable->name);
+    if (BeginsWith(line, length, "SAVE_STACK", SAVE_STACK_LENGTH))
+        return CheckArgument(line, length, SAVE_STACK_LENGTH, SAVE_STACK, SAVE_STACK_WRONG_FILE, true,
+                             &variable->name);
+    if (BeginsWith(line, length, "SAVE", SAVE_LENGTH))
+        return CheckArgument(line, length, SAVE_LENGTH, SAVE, SAVE_WRONG_FILE, true, &variable->name);
+    if (BeginsWith(line, length, "RESTORE", RESTORE_LENGTH))
+        return CheckArgument(line, length, RESTORE_LENGTH, RESTORE, RESTORE_WRONG_FILE, true, &variable->name);
+    if (BeginsWith(line, length, "MAP", MAP_LENGTH))
+        return CheckArgument(line, length, MAP_LENGTH, MAP, MAP_WRONG_FILE, true, &variable->name);
+    if (BeginsWith(line, length, "REORDER", REORDER_LENGTH))
+        return CheckReorder(line, length, &variable->reorder_parameter);
+    if (BeginsWith(line, length, "SUBST", SUBST_LENGTH))
+        return CheckSubst(line, length, &variable->subst);
     if (!CheckCharacters(line, length)) //sprawdzanie, czy są tylko dozwolone znaki (nie ma np. '\0')
         return WRONG_COMMAND;
-    if (strcmp(line, "ADD") == 0 || strcmp(line, "ADD\n") == 0)
+    if (IsCommand(line, length, "ADD"))
         return ADD;
-    if (strcmp(line, "IS_ZERO") == 0 || strcmp(line, "IS_ZERO\n") == 0)
+    if (IsCommand(line, length, "IS_ZERO"))
         return IS_ZERO;
-    if (strcmp(line, "IS_COEFF") == 0 || strcmp(line, "IS_COEFF\n") == 0)
+    if (IsCommand(line, length, "IS_COEFF"))
         return IS_COEFF;
-    if (strcmp(line, "CLONE") == 0 || strcmp(line, "CLONE\n") == 0)
+    if (IsCommand(line, length, "CLONE"))
         return CLONE;
-    if (strcmp(line, "MUL") == 0 || strcmp(line, "MUL\n") == 0)
+    if (IsCommand(line, length, "MUL"))
         return MUL;
-    if (strcmp(line, "NEG") == 0 || strcmp(line, "NEG\n") == 0)
+    if (IsCommand(line, length, "NEG"))
         return NEG;
-    if (strcmp(line, "SUB") == 0 || strcmp(line, "SUB\n") == 0)
+    if (IsCommand(line, length, "SUB"))
         return SUB;
-    if (strcmp(line, "DEG") == 0 || strcmp(line, "DEG\n") == 0)
+    if (IsCommand(line, length, "DEG"))
         return DEG;
-    if (strcmp(line, "PRINT") == 0 || strcmp(line, "PRINT\n") == 0)
+    if (IsCommand(line, length, "PRINT"))
         return PRINT;
-    if (strcmp(line, "POP") == 0 || strcmp(line, "POP\n") == 0)
+    if (IsCommand(line, length, "POP"))
         return POP;
-    if (strcmp(line, "ZERO") == 0 || strcmp(line, "ZERO\n") == 0)
+    if (IsCommand(line, length, "ZERO"))
         return ZERO;
-    if (strcmp(line, "IS_EQ") == 0 || strcmp(line, "IS_EQ\n") == 0)
+    if (IsCommand(line, length, "IS_EQ"))
         return IS_EQ;
+    if (IsCommand(line, length, "IS_EQ_MUL"))
+        return IS_EQ_MUL;
+    if (IsCommand(line, length, "FREEZE"))
+        return FREEZE;
 
     return WRONG_COMMAND;
 }
 
 
-ParseResult ParseLine()
+ParseResult ParseLine(InputReader *input)
 {
     ParseResult result;
-    char *string = NULL;
-    ssize_t length = read_line_into_string(&string);
-    if (length == NO_INPUT)
+    const char *line;
+    size_t length;
+    if (!InputNextLine(input, &line, &length))
         result.type = END_OF_FILE;
-    else if (ignoredLine(string, length))
+    else if (ignoredLine(line, length))
         result.type = IGNORED_LINE;
-    else if (firstLetter(string))
-        result.type = TypeOfInstruction(string, length, &result.variable);
+    else if (firstLetter(line))
+        result.type = TypeOfInstruction((char *) line, length, &result.variable);
     else
-        result.type = GetPoly(string, length, &result.variable.poly);
-    free(string);
+        result.type = GetPoly(line, length, &result.variable.poly);
     return result;
 }
@@ -10,6 +10,7 @@
 
 #include "poly.h"
 #include "parser_structs.h"
+#include "input.h"
 
 
 
@@ -17,8 +18,9 @@
  * Wczytuje wiersz i wyznacza jego typ. Jeśli wiersz jest typu POLY, to przypisuje wczytany
  * wielomian zmiennej @f$poly@f$. Jeśli wiersz jest typu AT lub DEG_BY, przypisuje odpowiednio
  * zmiennym @f$at_val@f$ lub @f$deg_by_var@f$ wczytaną wartość argumentu.
+ * @param[in] input : czytnik wierszy
  * @result struktura zawierająca typ wiersza i parametr
  */
-extern ParseResult ParseLine();
+extern ParseResult ParseLine(InputReader *input);
 
 #endif //POLYNOMIALS_PARSER_H
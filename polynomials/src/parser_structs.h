@@ -28,22 +28,56 @@ typedef enum LineType {
     PRINT,
     POP,
     COMPOSE,
+    IS_EQ_MUL,
+    FREEZE,
+    STORE,
+    LOAD,
+    SAVE,
+    SAVE_STACK,
+    RESTORE,
+    SAVE_IMAGE,
+    MAP,
+    REORDER,
+    SUBST,
+    LOAD_TERMS,
     WRONG_COMMAND,
     DEG_BY_WRONG_VARIABLE,
     AT_WRONG_VALUE,
     COMPOSE_WRONG_PARAMETER,
+    STORE_WRONG_NAME,
+    LOAD_WRONG_NAME,
+    SAVE_WRONG_FILE,
+    SAVE_STACK_WRONG_FILE,
+    RESTORE_WRONG_FILE,
+    SAVE_IMAGE_WRONG_FILE,
+    MAP_WRONG_FILE,
+    REORDER_WRONG_PARAMETER,
+    SUBST_WRONG_PARAMETER,
+    LOAD_TERMS_WRONG_FILE,
     WRONG_POLY,
     POLY,
     END_OF_FILE
 } LineType;
 
+/**
+ * Struktura reprezentująca parametr polecenia SUBST.
+ */
+typedef struct SubstParameter{
+    size_t count; ///<liczba podstawień
+    unsigned long *vars; ///<numery zmiennych
+    poly_coeff_t *values; ///<wartości zmiennych
+}SubstParameter;
+
 /**
  * Unia reprezentująca parametr wczytanej instrukcji lub wczytany wielomian.
  */
 typedef union InstructionVar{
     unsigned long deg_by_var; ///< parametr polecenia DEG_BY
     unsigned long compose_parameter; ///<parametr polecenia COMPOSE
+    unsigned long reorder_parameter; ///<parametr polecenia REORDER
+    SubstParameter subst; ///<parametr polecenia SUBST (tablice należy zwolnić)
     long at_val; ///<parametr polecenia AT
+    char *name; ///<nazwa rejestru w poleceniu STORE lub LOAD albo ścieżka pliku w poleceniu SAVE, SAVE_STACK, RESTORE, SAVE_IMAGE, MAP lub LOAD_TERMS (należy zwolnić)
     Poly poly; ///<wczytany wielomian
 }InstructionVar;
 
@@ -0,0 +1,114 @@
+/** @file
+ Implementacja potoku wczytującego wiersze w osobnym wątku
+
+ Bufor cykliczny ma jednego producenta (wątek parsera) i jednego konsumenta (kalkulator).
+ Każdy z nich zmienia tylko własny indeks, a liczby zajętych i wolnych miejsc są zliczane
+ semaforami, więc bufor nie wymaga muteksu. Semafory zapewniają też, że konsument widzi
+ wielomian zapisany przez producenta.
+
+ @author Julia Karmowska
+ @date 2021
+*/
+
+/**
+ * Umożliwia działanie wątków i semaforów POSIX.
+ */
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <semaphore.h>
+#include "pipeline.h"
+#include "memory.h"
+
+/**
+ * To jest stała reprezentująca liczbę miejsc w buforze cyklicznym
+ */
+#define PIPELINE_CAPACITY 1024
+
+/**
+ * Struktura opisująca wynik parsowania wiersza razem z numerem wiersza.
+ */
+typedef struct ParsedLine {
+    ParseResult result;         ///< wynik parsowania
+    unsigned long line_number;  ///< numer wiersza
+} ParsedLine;
+
+/**
+ * Struktura opisująca potok.
+ */
+struct Pipeline {
+    ParsedLine slots[PIPELINE_CAPACITY];    ///< bufor cykliczny
+    size_t head;                            ///< indeks następnego odbieranego wiersza (konsument)
+    size_t tail;                            ///< indeks następnego wstawianego wiersza (producent)
+    sem_t filled;                           ///< liczba zajętych miejsc
+    sem_t empty;                            ///< liczba wolnych miejsc
+    InputReader *input;                     ///< czytnik wierszy
+    pthread_t parser;                       ///< wątek parsera
+};
+
+/**
+ * Czeka na semafor, ponawiając oczekiwanie przerwane sygnałem.
+ * @param[in] sem : semafor
+ */
+static void Wait(sem_t *sem)
+{
+    while (sem_wait(sem) != 0)
+        continue;
+}
+
+/**
+ * Treść wątku parsera: wczytuje wiersze aż do końca danych i wstawia je do bufora.
+ * @param[in] arg : potok
+ * @return NULL
+ */
+static void *ParserThread(void *arg)
+{
+    Pipeline *pipeline = arg;
+    unsigned long line_number = 1;
+    ParseResult result;
+    do
+    {
+        result = ParseLine(pipeline->input);
+        if (result.type != IGNORED_LINE)
+        {
+            Wait(&pipeline->empty);
+            ParsedLine *slot = &pipeline->slots[pipeline->tail];
+            slot->result = result;
+            slot->line_number = line_number;
+            pipeline->tail = (pipeline->tail + 1) % PIPELINE_CAPACITY;
+            sem_post(&pipeline->filled);
+        }
+        line_number++;
+    } while (result.type != END_OF_FILE);
+    return NULL;
+}
+
+void PipelineStart(Pipeline **pipeline, InputReader *input)
+{
+    *pipeline = calloc(1, sizeof(Pipeline));
+    CHECK_PTR(*pipeline);
+    (*pipeline)->input = input;
+    if (sem_init(&(*pipeline)->filled, 0, 0) != 0 ||
+        sem_init(&(*pipeline)->empty, 0, PIPELINE_CAPACITY) != 0 ||
+        pthread_create(&(*pipeline)->parser, NULL, ParserThread, *pipeline) != 0)
+        exit(1);
+}
+
+ParseResult PipelineNext(Pipeline *pipeline, unsigned long *line_number)
+{
+    Wait(&pipeline->filled);
+    ParsedLine *slot = &pipeline->slots[pipeline->head];
+    ParseResult result = slot->result;
+    *line_number = slot->line_number;
+    pipeline->head = (pipeline->head + 1) % PIPELINE_CAPACITY;
+    sem_post(&pipeline->empty);
+    return result;
+}
+
+void PipelineStop(Pipeline **pipeline)
+{
+    pthread_join((*pipeline)->parser, NULL);
+    sem_destroy(&(*pipeline)->filled);
+    sem_destroy(&(*pipeline)->empty);
+    free(*pipeline);
+}
@@ -0,0 +1,43 @@
+/** @file
+ Interfejs potoku wczytującego wiersze w osobnym wątku
+
+ @author Julia Karmowska
+ @date 2021
+*/
+
+#ifndef POLYNOMIALS_PIPELINE_H
+#define POLYNOMIALS_PIPELINE_H
+
+#include "parser.h"
+
+/**
+ * Struktura opisująca potok: wątek parsera wczytuje kolejne wiersze i umieszcza wyniki
+ * w ograniczonym buforze cyklicznym, z którego w tej samej kolejności odbiera je kalkulator.
+ */
+typedef struct Pipeline Pipeline;
+
+/**
+ * Uruchamia wątek parsera czytający wiersze z czytnika @p input.
+ * Do czasu zatrzymania potoku czytnika może używać tylko wątek parsera.
+ * @param[in] pipeline : potok
+ * @param[in] input : czytnik wierszy
+ */
+extern void PipelineStart(Pipeline **pipeline, InputReader *input);
+
+/**
+ * Odbiera wynik parsowania kolejnego niepominiętego wiersza, czekając na niego, jeśli to konieczne.
+ * Wiersze typu IGNORED_LINE są pomijane. Po końcu danych zwraca wynik typu END_OF_FILE.
+ * @param[in] pipeline : potok
+ * @param[out] line_number : numer wiersza
+ * @return wynik parsowania wiersza
+ */
+extern ParseResult PipelineNext(Pipeline *pipeline, unsigned long *line_number);
+
+/**
+ * Czeka na zakończenie wątku parsera i usuwa potok z pamięci.
+ * Można ją wywołać dopiero po odebraniu wyniku typu END_OF_FILE.
+ * @param[in] pipeline : potok
+ */
+extern void PipelineStop(Pipeline **pipeline);
+
+#endif //POLYNOMIALS_PIPELINE_H
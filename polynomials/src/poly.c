@@ -5,8 +5,12 @@
  @date 2021
 */
 
+#include <limits.h>
+#include <stdatomic.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include "poly.h"
 
 /**
@@ -30,774 +34,3304 @@
  */
 #define ONE_ARR_CELL_FOR_COEFF 1
 
+/**
+ * To jest stała, od której zaczyna się liczenie skrótu wielomianu niestałego
+ */
+#define POLY_HASH_SEED 0x9e3779b97f4a7c15ULL
 
-void PolyDestroy(Poly *p)
+/**
+ * Metadane wielomianu niestałego. Nagłówek leży w pamięci bezpośrednio przed węzłem
+ * wielomianu i jest alokowany razem z nim. Metadane są wyznaczane leniwie, przy pierwszym
+ * zapytaniu, i zapamiętywane do zniszczenia wielomianu. Węzeł jest wypełniany tylko
+ * w trakcie tworzenia wielomianu, a każdy nowy węzeł ma metadane oznaczone jako nieaktualne.
+ * Ponieważ węzeł nie zmienia się po utworzeniu wielomianu, może być współdzielony
+ * przez wiele wielomianów – nagłówek zlicza wtedy referencje. Licznik jest atomowy, dzięki
+ * czemu drzewo oddane przez PolyReleaseLarge może być zwalniane w innym wątku niż ten,
+ * który nadal używa jego współdzielonych poddrzew.
+ */
+typedef struct PolyMeta {
+    uint64_t hash;      ///< skrót strukturalny wielomianu
+    size_t terms;       ///< liczba jednomianów wielomianu po rozwinięciu (nasycana na SIZE_MAX)
+    size_t bytes;       ///< liczba bajtów zajmowanych przez wielomian (nasycana na SIZE_MAX)
+    atomic_size_t refs; ///< liczba wielomianów współdzielących węzeł
+    poly_exp_t deg;     ///< stopień wielomianu
+    bool valid;         ///< czy metadane zostały już wyznaczone
+    bool frozen;        ///< czy węzeł zaczyna zamrożony blok (PolyFreeze)
+    bool leaf;          ///< czy wszystkie współczynniki węzła są stałe (ustalane przy tworzeniu węzła)
+    bool dense;         ///< czy węzeł jest gęsty: jego wykładniki to kolejno 0, 1, …, size - 1
+} PolyMeta;
+
+/**
+ * To jest stała reprezentująca wyrównanie, do którego jest dopełniana tablica wykładników węzła,
+ * tak aby kolejny nagłówek w bloku (PolyFreeze, PolyWriteImage) był wyrównany
+ */
+#define NODE_ALIGNMENT sizeof(uint64_t)
+
+/**
+ * To jest stała reprezentująca największą liczbę jednomianów węzła gęstego
+ */
+#define DENSE_MAX_SIZE 1024
+
+/**
+ * Dają kolejne wykładniki od @p n (pomocnicze do wypełnienia tablicy DENSE_EXPS).
+ */
+#define DENSE_EXPS_4(n) (n), (n) + 1, (n) + 2, (n) + 3
+/** @copydoc DENSE_EXPS_4 */
+#define DENSE_EXPS_16(n) DENSE_EXPS_4(n), DENSE_EXPS_4((n) + 4), DENSE_EXPS_4((n) + 8), DENSE_EXPS_4((n) + 12)
+/** @copydoc DENSE_EXPS_4 */
+#define DENSE_EXPS_64(n) DENSE_EXPS_16(n), DENSE_EXPS_16((n) + 16), DENSE_EXPS_16((n) + 32), DENSE_EXPS_16((n) + 48)
+/** @copydoc DENSE_EXPS_4 */
+#define DENSE_EXPS_256(n) DENSE_EXPS_64(n), DENSE_EXPS_64((n) + 64), DENSE_EXPS_64((n) + 128), DENSE_EXPS_64((n) + 192)
+
+/**
+ * Tablica wykładników wspólna dla wszystkich węzłów gęstych. Węzeł gęsty nie przechowuje
+ * własnej tablicy wykładników, bo @f$i@f$-ty jednomian ma zawsze wykładnik @f$i@f$.
+ */
+static const poly_exp_t DENSE_EXPS[DENSE_MAX_SIZE] = {
+    DENSE_EXPS_256(0), DENSE_EXPS_256(256), DENSE_EXPS_256(512), DENSE_EXPS_256(768)
+};
+
+/**
+ * Daje liczbę bajtów węzła o danej liczbie jednomianów. Węzeł jest strukturą tablic: za nagłówkiem
+ * metadanych leży tablica współczynników, a za nią tablica wykładników, dzięki czemu przeglądanie
+ * wykładników nie wczytuje współczynników, a jednomian zajmuje mniej miejsca niż struktura Mono
+ * z dopełnieniem. Węzeł gęsty nie ma tablicy wykładników.
+ * @param[in] size : liczba jednomianów
+ * @param[in] dense : czy węzeł jest gęsty
+ * @return rozmiar węzła w bajtach
+ */
+static inline size_t NodeBytes(size_t size, bool dense)
 {
-    if (p == NULL)
-        return;
-    if (p->arr != NULL)
-    {
-        for (size_t i = 0; i < p->size; i++)
-        {
-            MonoDestroy(&p->arr[i]);
-        }
-        free(p->arr);
-    }
+    size_t exps = dense ? 0 : (size * sizeof(poly_exp_t) + NODE_ALIGNMENT - 1) / NODE_ALIGNMENT * NODE_ALIGNMENT;
+    return sizeof(PolyMeta) + size * sizeof(Poly) + exps;
 }
 
-Poly PolyClone(const Poly *p)
+/**
+ * Alokuje węzeł z miejscem na @p capacity jednomianów razem z nagłówkiem metadanych.
+ * @param[in] capacity : liczba jednomianów
+ * @param[in] dense : czy węzeł jest gęsty (bez miejsca na wykładniki)
+ * @return tablica współczynników węzła
+ */
+static Poly *NodeAlloc(size_t capacity, bool dense)
 {
-    if (p->arr == NULL)
-        return PolyFromCoeff(p->coeff);
+    if (capacity > (SIZE_MAX - sizeof(PolyMeta) - NODE_ALIGNMENT) / (sizeof(Poly) + sizeof(poly_exp_t)))
+        exit(1);
+    PolyMeta *meta = malloc(NodeBytes(capacity, dense));
+    CHECK_PTR(meta);
+    *meta = (PolyMeta) {.refs = 1, .valid = false, .frozen = false, .leaf = false, .dense = dense};
+    return (Poly *) (meta + 1);
+}
 
-    Poly result;
-    result.size = p->size;
-    result.arr = calloc(result.size, sizeof(Mono));
-    CHECK_PTR(result.arr);
-    for (size_t i = 0; i < result.size; i++)
-    {
-        result.arr[i] = MonoClone(&p->arr[i]);
-    }
-    return result;
+/**
+ * Zwalnia węzeł zaalokowany przez NodeAlloc (bez niszczenia współczynników).
+ * @param[in] coeffs : tablica współczynników węzła
+ */
+static void NodeFree(Poly *coeffs)
+{
+    if (coeffs != NULL)
+        free((PolyMeta *) coeffs - 1);
 }
 
 /**
- * Tworzy nowy wielomian z tablicą jednomianów o danym rozmiarze.
- * @param[in] size : rozmiar tablicy jednomianów
- * @return wielomian
+ * To jest stała oznaczająca w polu arr wielomianu leżącego w obrazie (PolyWriteImage),
+ * że pole przechowuje przesunięcie węzła względem adresu samego pola, a nie wskaźnik.
+ * Wskaźniki węzłów są wyrównane, więc najmłodszy bit wskaźnika jest zawsze zerem.
+ */
+#define IMAGE_OFFSET_TAG ((uintptr_t) 1)
+
+/**
+ * To jest stała reprezentująca licznik referencji węzła, który nie jest nigdy zwalniany
+ * (węzła leżącego w obrazie odwzorowanym tylko do odczytu)
+ */
+#define IMMORTAL_REFS SIZE_MAX
+
+/**
+ * To jest stała oznaczająca w liczniku referencji węzła leżącego wewnątrz zamrożonego bloku
+ * (PolyFreeze), że pozostałe bity licznika są odległością w bajtach do nagłówka początku bloku,
+ * który zlicza referencje całego bloku
+ */
+#define FROZEN_REFS_TAG ((SIZE_MAX >> 1) + 1)
+
+/**
+ * Daje nagłówek, który zlicza referencje węzła: jego własny albo nagłówek początku
+ * zamrożonego bloku, w którym węzeł leży.
+ * @param[in] coeffs : tablica współczynników węzła
+ * @return nagłówek metadanych
  */
-static Poly PolyNewFromSize(size_t size)
+static inline PolyMeta *RefsOwner(Poly *coeffs)
 {
-    Poly result;
-    result.size = 0;
-    result.arr = calloc(size, sizeof(Mono));
-    CHECK_PTR(result.arr);
-    return result;
+    PolyMeta *meta = (PolyMeta *) coeffs - 1;
+    if (meta->refs != IMMORTAL_REFS && (meta->refs & FROZEN_REFS_TAG))
+        return (PolyMeta *) ((char *) meta - (meta->refs & ~FROZEN_REFS_TAG));
+    return meta;
+}
+
+/**
+ * Daje tablicę współczynników węzła wielomianu niestałego. Wielomian leżący w obrazie zamiast
+ * wskaźnika przechowuje przesunięcie względem adresu pola arr, dlatego @p p musi wskazywać
+ * na wielomian w jego pierwotnym miejscu, a nie na jego kopię.
+ * @param[in] p : wielomian niestały
+ * @return tablica współczynników
+ */
+static inline Poly *Coeffs(const Poly *p)
+{
+    uintptr_t arr = (uintptr_t) p->arr;
+    if (arr & IMAGE_OFFSET_TAG)
+        return (Poly *) ((char *) &p->arr + (arr >> 1));
+    return (Poly *) p->arr;
+}
+
+/**
+ * Daje tablicę wykładników węzła wielomianu niestałego (leży bezpośrednio za tablicą
+ * współczynników, a dla węzła gęstego jest wspólną tablicą DENSE_EXPS). Warunki jak w Coeffs.
+ * @param[in] p : wielomian niestały
+ * @return tablica wykładników
+ */
+static inline const poly_exp_t *Exps(const Poly *p)
+{
+    Poly *coeffs = Coeffs(p);
+    if (((PolyMeta *) coeffs - 1)->dense)
+        return DENSE_EXPS;
+    return (const poly_exp_t *) (coeffs + p->size);
+}
+
+/**
+ * Sprawdza, czy węzeł wielomianu niestałego jest gęsty. Warunki jak w Coeffs.
+ * @param[in] p : wielomian niestały z węzłem
+ * @return Czy wykładniki węzła to kolejno 0, 1, …, size - 1?
+ */
+static inline bool IsDense(const Poly *p)
+{
+    return ((PolyMeta *) Coeffs(p) - 1)->dense;
 }
 
 /**
- * Wyznacza rozmiar tablicy jednomianów wielomianu będącego sumą dwóch wielomianów.
+ * To jest stała oznaczająca w polu arr wielomianu, że wielomian jest jednomianem
+ * @f$cx^e@f$ ze stałym, niezerowym współczynnikiem @f$c@f$ i wykładnikiem @f$e > 0@f$,
+ * przechowywanym w miejscu bez węzła: pole coeff zawiera @f$c@f$, a starsze bity pola arr
+ * – @f$e@f$. Dwa najmłodsze bity odróżniają go od wskaźnika (00) i przesunięcia w obrazie (x1).
+ */
+#define INLINE_MONO_TAG ((uintptr_t) 2)
+
+/**
+ * To jest stała reprezentująca maskę bitów znacznika w polu arr wielomianu
+ */
+#define ARR_TAG_MASK ((uintptr_t) 3)
+
+/**
+ * To jest stała reprezentująca przesunięcie wykładnika jednomianu przechowywanego w miejscu
+ */
+#define INLINE_EXP_SHIFT 2
+
+/**
+ * Sprawdza, czy wielomian jest jednomianem przechowywanym w miejscu.
  * @param[in] p : wielomian
- * @param[in] q : wielomian
- * @return rozmiar tablicy jednomianów
+ * @return Czy wielomian nie ma węzła, choć nie jest stały?
  */
-static size_t SizeOfAddArray(const Poly *p, const Poly *q)
+static inline bool IsInlineMono(const Poly *p)
 {
-    if (p->arr == NULL && q->arr == NULL)
-        return 0;
-    else if (p->arr != NULL && q->arr != NULL)
-        return p->size + q->size;
-    else if (p->arr != NULL)
-        return p->size + ONE_ARR_CELL_FOR_COEFF;
-    else
-        return q->size + ONE_ARR_CELL_FOR_COEFF;
+    return ((uintptr_t) p->arr & ARR_TAG_MASK) == INLINE_MONO_TAG;
 }
 
 /**
- * Kopiuje jednomian z tablicy arr wielomianu p do tablicy arr wielomianu result
- * pod danymi indeksami oraz zwiększa indeksy.
+ * Sprawdza, czy wielomian ma węzeł.
  * @param[in] p : wielomian
- * @param[in] result : wielomian
- * @param[in] p_index : indeks w tablicy jednomianów wielomianu @p p
- * @param[in] res_index : indeks w tablicy jednomianów wielomianu @p result
+ * @return Czy wielomian nie jest ani stały, ani jednomianem przechowywanym w miejscu?
  */
-static void MonoCloneAndChangeIndex(const Poly *p, Poly *result, size_t *p_index, size_t *res_index)
+static inline bool HasNode(const Poly *p)
 {
-    result->arr[*res_index] = MonoClone(&p->arr[*p_index]);
-    (*p_index)++;
-    (*res_index)++;
+    return p->arr != NULL && !IsInlineMono(p);
 }
 
 /**
- * Dodaje dwa wielomiany, dopóki nie dotrze do końca tablicy jednomianów jednego z nich.
- * Do wynikowego wielomianu wpisuje jednomiany w kolejności rosnącej według wykładników.
- * Jeśli wykładniki w obu wielomianach są równe, to jako współczynnik przy tym wykładniku w wielomianie @f$result@f$
- * wpisuje sumę współczynników z wielomianów @f$p@f$ i @f$q@f$.
- * @param[in] p : wielomian @f$p@f$
- * @param[in] q : wielomian @f$q@f$
- * @param[in] result : wielomian wynikowy @f$result@f$
- * @param[in] p_index : indeks w tablicy wielomianu @f$p@f$
- * @param[in] q_index : indeks w tablicy wielomianu @f$q@f$
- * @param[in] res_index : indeks w tablicy wielomianu @f$q@f$
- * */
-static void
-AddTwoPolyTillOneEnds(const Poly *p, const Poly *q, Poly *result, size_t *p_index, size_t *q_index, size_t *res_index)
-{
-    assert(p->arr != NULL && q->arr != NULL);
-    if (p->arr[*p_index].exp == q->arr[*q_index].exp)
-    {
-        result->arr[*res_index].exp = p->arr[*p_index].exp;
-        result->arr[*res_index].p = PolyAdd(&p->arr[*p_index].p, &q->arr[*q_index].p);
-
-        //jeśli w wyniku dodawania otrzymaliśmy wielomian zerowy, to pomijamy go
-        if (!PolyIsZero(&result->arr[*res_index].p))
-            (*res_index)++;
-        (*p_index)++;
-        (*q_index)++;
-    } else if (p->arr[*p_index].exp < q->arr[*q_index].exp)
-        MonoCloneAndChangeIndex(p, result, p_index, res_index);
-    else
-        MonoCloneAndChangeIndex(q, result, q_index, res_index);
+ * Tworzy jednomian przechowywany w miejscu.
+ * @param[in] coeff : niezerowy współczynnik
+ * @param[in] exp : dodatni wykładnik
+ * @return jednomian @f$coeff \cdot x^{exp}@f$
+ */
+static inline Poly InlineMono(poly_coeff_t coeff, poly_exp_t exp)
+{
+    assert(coeff != 0 && exp > 0);
+    return (Poly) {.coeff = coeff, .arr = (Mono *) (((uintptr_t) exp << INLINE_EXP_SHIFT) | INLINE_MONO_TAG)};
 }
 
 /**
- * Dodaje dwa niestałe wielomiany, wielomian @f$p@f$ ma większy ostatni wykładnik w tablicy jednomianów.
- * @param[in] p : wielomian @f$p@f$
- * @param[in] q : wielomian @f$q@f$
- * @param[in] result : wielomian wynikowy @f$result@f$
+ * Daje wykładnik jednomianu przechowywanego w miejscu.
+ * @param[in] p : jednomian przechowywany w miejscu
+ * @return wykładnik
  */
-static void PolyAddTwoNonConstFirstLarger(const Poly *p, const Poly *q, Poly *result)
+static inline poly_exp_t InlineExp(const Poly *p)
 {
-    size_t p_index = 0;
-    size_t q_index = 0;
-    size_t res_index = 0;
-    while (p_index < p->size && q_index < q->size)
+    return (poly_exp_t) ((uintptr_t) p->arr >> INLINE_EXP_SHIFT);
+}
+
+/**
+ * Struktura opisująca jednomiany wielomianu niestałego niezależnie od tego, czy wielomian
+ * ma węzeł. Dla jednomianu przechowywanego w miejscu tablice wskazują pola samej struktury,
+ * więc struktury nie wolno kopiować.
+ */
+typedef struct NodeView {
+    const Poly *coeffs;     ///< tablica współczynników
+    const poly_exp_t *exps; ///< tablica wykładników
+    size_t size;            ///< liczba jednomianów
+    Poly coeff;             ///< współczynnik jednomianu przechowywanego w miejscu
+    poly_exp_t exp;         ///< wykładnik jednomianu przechowywanego w miejscu
+} NodeView;
+
+/**
+ * Wypełnia opis jednomianów wielomianu niestałego. Warunki jak w Coeffs.
+ * @param[out] view : opis jednomianów
+ * @param[in] p : wielomian niestały
+ */
+static inline void ViewInit(NodeView *view, const Poly *p)
+{
+    if (IsInlineMono(p))
     {
-        AddTwoPolyTillOneEnds(p, q, result, &p_index, &q_index, &res_index);
-    }
-    while (p_index < p->size)
+        view->coeff = PolyFromCoeff(p->coeff);
+        view->exp = InlineExp(p);
+        view->coeffs = &view->coeff;
+        view->exps = &view->exp;
+        view->size = 1;
+    } else
     {
-        result->arr[res_index] = MonoClone(&p->arr[p_index]);
-        p_index++;
-        res_index++;
+        view->coeffs = Coeffs(p);
+        view->exps = Exps(p);
+        view->size = p->size;
     }
-    if (res_index == 0) //musimy zwolnić tablicę jednomianów i stworzyć wielomian zerowy
-    {
-        PolyDestroy(result);
-        *result = PolyZero();
-    } else
-        result->size = res_index;
 }
 
 /**
- * Dodaje dwa niestałe wielomiany.
- * @param[in] p : wielomian @f$p@f$
- * @param[in] q : wielomian @f$q@f$
- * @param[in] result : wielomian wynikowy @f$result@f$
+ * Sprawdza, czy wielomian niestały jest liściem, czyli czy wszystkie jego współczynniki są stałe.
+ * Węzły, których nie oznaczono przy tworzeniu, są traktowane jak wewnętrzne. Operacje na liściach
+ * (LeafAdd, PolyMulByCoeff, LeafAt) to zwykłe pętle skalarne bez wywołań rekurencyjnych i bez
+ * kopiowania współczynników przez PolyClone. Współczynniki liścia leżą w 16-bajtowych komórkach
+ * Poly obok pól arr, a nie w ciągłej tablicy liczb, więc kompilator nie wektoryzuje tych pętli.
+ * @param[in] p : wielomian
+ * @return Czy wielomian jest liściem?
  */
-static void PolyAddTwoNonConst(const Poly *p, const Poly *q, Poly *result)
+static inline bool IsLeaf(const Poly *p)
 {
-    //sprawdzamy który wielomian ma większy ostatni wykładnik
-    if (p->arr[p->size - 1].exp >= q->arr[q->size - 1].exp)
-        PolyAddTwoNonConstFirstLarger(p, q, result);
-    else
-        PolyAddTwoNonConstFirstLarger(q, p, result);
+    return IsInlineMono(p) || (HasNode(p) && ((PolyMeta *) Coeffs(p) - 1)->leaf);
 }
 
 /**
- * Kopiuje tablicę jednomianów z jednego wielomianu do drugiego, od podanego indeksu do końca.
- * @param[in] p : wielomian @f$p@f$
- * @param[in] result : wielomian wynikowy @f$result@f$
- * @param[in] p_index : indeks w tablicy wielomianu @f$p@f$
- * @param[in] res_index : indeks w tablicy wielomianu @f$result@f$
+ * Struktura opisująca węzeł w trakcie wypełniania. Końcowa liczba jednomianów nie jest jeszcze
+ * znana, więc wykładniki są zapisywane za miejscem na wszystkie współczynniki i przesuwane
+ * na właściwe miejsce dopiero w BuilderFinish. Węzeł jest alokowany dopiero przy drugim
+ * jednomianie, bo wielomian z jednym jednomianem często nie potrzebuje węzła.
+ */
+typedef struct NodeBuilder {
+    Poly *coeffs;           ///< tablica współczynników węzła albo NULL, jeśli nie jest jeszcze zaalokowana
+    poly_exp_t *exps;       ///< tymczasowe położenie tablicy wykładników
+    size_t size;            ///< liczba wpisanych jednomianów
+    size_t capacity;        ///< największa liczba jednomianów
+    bool leaf;              ///< czy wszystkie wpisane współczynniki są stałe
+    Poly first_coeff;       ///< współczynnik pierwszego jednomianu przed alokacją węzła
+    poly_exp_t first_exp;   ///< wykładnik pierwszego jednomianu przed alokacją węzła
+} NodeBuilder;
+
+/**
+ * Rozpoczyna wypełnianie węzła z miejscem na @p capacity jednomianów.
+ * @param[in] builder : węzeł w trakcie wypełniania
+ * @param[in] capacity : największa liczba jednomianów
  */
-static void ClonePartOfMonos(const Poly *p, Poly *result, size_t *res_index, size_t p_index)
+static void BuilderInit(NodeBuilder *builder, size_t capacity)
 {
-    while (p_index < p->size)
-    {
-        result->arr[*res_index] = MonoClone(&p->arr[p_index]);
-        p_index++;
-        (*res_index)++;
-    }
+    builder->coeffs = NULL;
+    builder->exps = NULL;
+    builder->size = 0;
+    builder->capacity = capacity;
+    builder->leaf = true;
 }
 
 /**
- * Zmienia wielomian w inny wielomian.
- * Niszczy dotychczasowy wielomian i klonuje do niego nowy.
- * @param[in] p : wielomian do skolonowania@f$p@f$
- * @param[in] result : wielomian wynikowy @f$result@f$
+ * Alokuje węzeł wypełniany przez @p builder i przepisuje do niego pierwszy jednomian.
+ * @param[in] builder : węzeł w trakcie wypełniania z jednym jednomianem
+ * @param[in] capacity : największa liczba jednomianów
  */
-static void PolyChangeInto(Poly *result, const Poly *p)
+static void BuilderAlloc(NodeBuilder *builder, size_t capacity)
 {
-    PolyDestroy(result);
-    *result = PolyClone(p);
+    builder->coeffs = NodeAlloc(capacity, false);
+    builder->exps = (poly_exp_t *) (builder->coeffs + capacity);
+    builder->coeffs[0] = builder->first_coeff;
+    builder->exps[0] = builder->first_exp;
 }
 
 /**
- * Dodaje wielomian stały i niestały.
- * @param[in] p : wielomian stały @f$p@f$
- * @param[in] q : wielomian niestały @f$q@f$
- * @param[in] result : wielomian wynikowy @f$result@f$
+ * Dopisuje jednomian na koniec węzła. Przejmuje na własność współczynnik.
+ * @param[in] builder : węzeł w trakcie wypełniania
+ * @param[in] coeff : współczynnik
+ * @param[in] exp : wykładnik
  */
-static void PolyAddConstAndNonConst(const Poly *p, const Poly *q, Poly *result)
+static inline void BuilderPush(NodeBuilder *builder, Poly coeff, poly_exp_t exp)
 {
-    if (PolyIsZero(p))
+    builder->leaf = builder->leaf && coeff.arr == NULL;
+    if (builder->size == 0)
     {
-        PolyChangeInto(result, q);
+        builder->first_coeff = coeff;
+        builder->first_exp = exp;
+        builder->size++;
         return;
     }
-    size_t res_index = 0;
-    result->arr[0].exp = 0; //pierwszy wykładnik jest zawsze równy 0, bo dodajemy wielomian stały (może zostać potem pominięty)
-    if (q->arr[0].exp != 0) //kopiujemy wielomian p z wykładnikiem 0 i potem kopiujemy całą tablicę q.arr
-    {
-        result->arr[0].p = PolyClone(p);
-        res_index++;
-        ClonePartOfMonos(q, result, &res_index, 0);
-    } else
-    {   //q->arr[0].exp = 0, więc pod zerowym indeksem dodajemy p +q.arr[0].p
-        result->arr[0].p = PolyAdd(p, &q->arr[0].p); //pod indeksem zerowym stoi suma p+q.arr[0]
-        if (!PolyIsZero(&result->arr[0].p)) //jeśli wynikiem był zerowy wielomian, to pomijamy go
-            res_index++;
-        ClonePartOfMonos(q, result, &res_index, 1);
-    }
-    result->size = res_index;
+    if (builder->coeffs == NULL)
+        BuilderAlloc(builder, builder->capacity);
+    builder->coeffs[builder->size] = coeff;
+    builder->exps[builder->size] = exp;
+    builder->size++;
 }
 
 /**
- * Redukuje wielomian do postaci wielomianu stałego, jeśli to możliwe
- * @param[in] p : wielomian @f$p@f$
+ * Kończy wypełnianie węzła i tworzy z niego wielomian. Pusty węzeł daje wielomian zerowy,
+ * węzeł z jednym stałym współczynnikiem przy wykładniku 0 – wielomian stały, a węzeł z jednym
+ * stałym, niezerowym współczynnikiem przy dodatnim wykładniku – jednomian przechowywany w miejscu.
+ * @param[in] builder : węzeł w trakcie wypełniania
+ * @return wielomian
  */
-static void MaybeReduceToCoeff(Poly *p)
+static Poly BuilderFinish(NodeBuilder *builder)
 {
-    if (p->arr != NULL && p->size == 1 && p->arr[0].exp == 0 && PolyIsCoeff(&p->arr[0].p))
+    size_t size = builder->size;
+    if (size == 0)
+        return PolyZero();
+    if (size == 1)
     {
-        poly_coeff_t coeff = p->arr[0].p.coeff;
-        PolyDestroy(p);
-        *p = PolyFromCoeff(coeff);
+        Poly coeff = builder->first_coeff;
+        poly_exp_t exp = builder->first_exp;
+        if (PolyIsCoeff(&coeff) && exp == 0)
+            return coeff;
+        if (PolyIsCoeff(&coeff) && coeff.coeff != 0)
+            return InlineMono(coeff.coeff, exp);
+        BuilderAlloc(builder, 1);
     }
+    PolyMeta *meta = (PolyMeta *) builder->coeffs - 1;
+    meta->leaf = builder->leaf;
+    //wykładniki rosną, więc pierwszy równy 0 i ostatni równy size - 1 wyznaczają węzeł gęsty
+    meta->dense = size <= DENSE_MAX_SIZE && builder->exps[0] == 0 && builder->exps[size - 1] == (poly_exp_t) size - 1;
+    if (!meta->dense)
+        memmove(builder->coeffs + size, builder->exps, size * sizeof(poly_exp_t));
+    return (Poly) {.size = size, .arr = (Mono *) builder->coeffs};
 }
 
-Poly PolyAdd(const Poly *p, const Poly *q)
-{
-    size_t size_of_new_poly;
-    size_of_new_poly = SizeOfAddArray(p, q);
-    if (size_of_new_poly == 0) //p i q są wielomianami stałymi
-        return PolyFromCoeff(p->coeff + q->coeff);
-
-    Poly result = PolyNewFromSize(size_of_new_poly);
-    if (p->arr != NULL && q->arr != NULL) //oba nie są stałe
-        PolyAddTwoNonConst(p, q, &result);
-    else if (p->arr != NULL) //tylko q jest stały
-        PolyAddConstAndNonConst(q, p, &result);
-    else //tylko p jest stały
-        PolyAddConstAndNonConst(p, q, &result);
-
-    MaybeReduceToCoeff(&result);
-
-    return result;
-}
+/**
+ * Sygnalizuje procesorowi, że wskazana pamięć wkrótce będzie czytana.
+ * @param[in] addr : adres
+ */
+#if defined(__GNUC__)
+#define PREFETCH(addr) __builtin_prefetch(addr)
+#else
+#define PREFETCH(addr) ((void) (addr))
+#endif
 
 /**
- * Porównuje jednomiany według wykładników.
+ * Zaczyna wczytywać do pamięci podręcznej nagłówek i początek węzła wielomianu,
+ * który zostanie odwiedzony jako następny.
+ * @param[in] p : wielomian
  */
-static int CmpMonos(const void *a, const void *b)
+static inline void PrefetchNode(const Poly *p)
 {
-    const Mono *p1 = (Mono *) a;
-    const Mono *p2 = (Mono *) b;
-    if (p1->exp < p2->exp)
-        return -1;
-    else if (p1->exp > p2->exp)
-        return 1;
-    else return 0;
+    if (HasNode(p))
+        PREFETCH((PolyMeta *) Coeffs(p) - 1);
 }
 
 /**
- * Sortuje tablicę jednomianów rosnąco według wykładników.
- * @param[in] monos : tablica jednomianów
- * @param[in] size : rozmiar tablicy @f$monos@f$
+ * To jest stała reprezentująca liczbę poziomów stosu przejścia po drzewie, które leżą
+ * w samej strukturze WalkStack
  */
-static void SortMonosArr(Mono *monos, size_t size)
-{
-    qsort(monos, size, sizeof(Mono), CmpMonos);
-}
+#define WALK_INLINE_DEPTH 32
 
+/**
+ * Struktura opisująca poziom przejścia po drzewie wielomianu.
+ */
+typedef struct WalkFrame {
+    const Poly *p;  ///< przeglądany wielomian
+    const Poly *q;  ///< drugi przeglądany wielomian (porównywanie) albo NULL
+    Poly *out;      ///< tablica współczynników tworzonej kopii węzła (kopiowanie) albo NULL
+    size_t i;       ///< indeks następnego jednomianu
+} WalkFrame;
 
 /**
- * Przepisuje jednomian do innego indeksu w tablicy, a pod stary indeks wstawia wielomiaan zerowy.
- * @param[in] monos : tablica jednomianów
- * @param[in] current_index :  indeks, z którego kopiujemy i który wypełniamy zerem
- * @param[in] last_used_index : indeks, do którego kopiujemy wielomian
+ * Struktura opisująca jawny stos przejścia po drzewie wielomianu, który zastępuje rekurencję,
+ * więc głębokość wielomianu nie jest ograniczona rozmiarem stosu wywołań. Płytkie drzewa
+ * mieszczą się w tablicy wewnątrz struktury, a głębsze przenoszą stos na stertę.
+ * Struktury nie wolno kopiować.
  */
-static void PushMonoToEmpty(Mono *monos, size_t current_index, size_t last_used_index)
+typedef struct WalkStack {
+    WalkFrame *frames;                          ///< stos poziomów
+    size_t size;                                ///< liczba poziomów na stosie
+    size_t capacity;                            ///< rozmiar stosu
+    WalkFrame inline_frames[WALK_INLINE_DEPTH]; ///< stos poziomów bez alokacji
+} WalkStack;
+
+/**
+ * Tworzy pusty stos przejścia.
+ * @param[out] stack : stos
+ */
+static inline void WalkInit(WalkStack *stack)
 {
-    assert(PolyIsZero(&monos[last_used_index].p));
-    monos[last_used_index].p = monos[current_index].p;
-    monos[last_used_index].exp = monos[current_index].exp;
-    monos[current_index].p = PolyZero();
+    stack->frames = stack->inline_frames;
+    stack->size = 0;
+    stack->capacity = WALK_INLINE_DEPTH;
 }
 
 /**
- * Dodaje jednomian do innego jednomianu w tablicy jednomianów.
- * Pod indeks, z którego zabiera jednoman, wpisuje jako współczynnik wielomian zerowy.
- * @param[in] monos : tablica jednomianów
- * @param[in] current_index :  indeks, z którego uzyskujemy jednomian do sumy i który wypełniamy zerem
- * @param[in] last_used_index : indeks, do którego dodajemy jednomian
+ * Wkłada poziom na stos przejścia, w razie potrzeby przenosząc stos na stertę.
+ * @param[in,out] stack : stos
+ * @param[in] frame : poziom
  */
-static void AddMonoToMono(Mono *monos, size_t current_index, size_t *last_used_index)
+static inline void WalkPush(WalkStack *stack, WalkFrame frame)
 {
-    Poly temp = PolyClone(&monos[*last_used_index].p); //musimy skopiować, żeby potem móc zwolnić pamięć
-    PolyDestroy(&monos[*last_used_index].p);
-    monos[*last_used_index].p = PolyAdd(&temp, &monos[current_index].p);
-
-    PolyDestroy(&monos[current_index].p);
-    monos[current_index].p = PolyZero();
-    PolyDestroy(&temp);
-
-    if (PolyIsZero(&monos[*last_used_index].p))
+    if (stack->size == stack->capacity)
     {
-        if (*last_used_index > 0)
-            (*last_used_index)--;
+        stack->capacity *= 2;
+        if (stack->frames == stack->inline_frames)
+        {
+            stack->frames = malloc(stack->capacity * sizeof(WalkFrame));
+            CHECK_PTR(stack->frames);
+            memcpy(stack->frames, stack->inline_frames, sizeof(stack->inline_frames));
+        } else
+        {
+            stack->frames = realloc(stack->frames, stack->capacity * sizeof(WalkFrame));
+            CHECK_PTR(stack->frames);
+        }
     }
+    stack->frames[stack->size++] = frame;
 }
 
 /**
- * Kopiuje tablicę jednomianów (płytka kopia).
- * @param[in] monos : tablica jednomianów
- * @param[in] size : rozmiar tablicy @f$monos@f$
- * @return tablica z kopią jednomianów
+ * Zwalnia pamięć stosu przejścia.
+ * @param[in] stack : stos
  */
-static Mono *CopyMonosArr(const Mono monos[], size_t size)
+static inline void WalkDestroy(WalkStack *stack)
 {
-    Mono *res = calloc(size, sizeof(Mono));
-    CHECK_PTR(res);
-    for (size_t i = 0; i < size; i++)
-        res[i] = monos[i];
+    if (stack->frames != stack->inline_frames)
+        free(stack->frames);
+}
 
-    return res;
+/**
+ * Dodaje dwie liczby jednomianów, nie przekraczając SIZE_MAX.
+ * @param[in] a : liczba jednomianów
+ * @param[in] b : liczba jednomianów
+ * @return @f$min(a + b, SIZE\_MAX)@f$
+ */
+static size_t TermsAdd(size_t a, size_t b)
+{
+    return a > SIZE_MAX - b ? SIZE_MAX : a + b;
 }
 
 /**
- * Klonuje tablicę jednomianów (głęboka kopia).
- * @param[in] monos : tablica jednomianów
- * @param[in] size : rozmiar tablicy @f$monos@f$
- * @return tablica z kopią jednomianów
+ * Wyznacza metadane węzła, którego współczynniki mają już znane metadane
+ * (bez pól opisujących sam węzeł, takich jak licznik referencji czy valid).
+ * @param[in] p : wielomian niestały z węzłem
+ * @param[out] meta : wyznaczone metadane
  */
-static Mono *CloneMonosArr(const Mono *monos, size_t size)
+static void ComputeMeta(const Poly *p, PolyMeta *meta)
 {
-    Mono *res = calloc(size, sizeof(Mono));
-    CHECK_PTR(res);
-    for (size_t i = 0; i < size; i++)
+    const Poly *coeffs = Coeffs(p);
+    const poly_exp_t *exps = Exps(p);
+    poly_exp_t deg = 0;
+    size_t terms = 0;
+    size_t bytes = NodeBytes(p->size, IsDense(p));
+    uint64_t hash = POLY_HASH_SEED;
+    for (size_t i = 0; i < p->size; i++)
     {
-        res[i].p = PolyClone(&(monos[i].p));
-        res[i].exp = monos[i].exp;
+        const Poly *coeff = &coeffs[i];
+        poly_exp_t coeff_deg = PolyDeg(coeff);
+        if (exps[i] + coeff_deg > deg)
+            deg = exps[i] + coeff_deg;
+        terms = TermsAdd(terms, PolyTerms(coeff));
+        bytes = TermsAdd(bytes, PolyMemory(coeff));
+        hash = PolyHashMix(hash ^ (uint64_t) exps[i]) + PolyHash(coeff);
     }
-    return res;
+    meta->deg = deg;
+    meta->terms = terms;
+    meta->bytes = bytes;
+    meta->hash = PolyHashMix(hash);
 }
 
 /**
- * Redukuje tablicę jednomianów, tak, aby w pierszej części tablicy długości @f$used@f$
- * każdy wykładnik występował maksymalnie raz.
- * @param[in] monos : tablica jednomianów
- * @param[in] size :  rozmiar tablicy @f$monos@f$
- * @param[in] used : użyte miejsce w tablicy
+ * Daje metadane wielomianu niestałego, wyznaczając je, jeśli nie były jeszcze znane.
+ * Metadane są pamięcią podręczną, dlatego mogą być uzupełniane także dla stałego wskaźnika.
+ * Węzły są odwiedzane w kolejności postorder z jawnym stosem, więc każdy węzeł jest
+ * opisywany dopiero wtedy, gdy jego współczynniki mają już metadane.
+ * @param[in] p : wielomian niestały
+ * @return metadane wielomianu
  */
-static void ReduceMonosArr(Mono *monos, size_t size, size_t *used)
+static const PolyMeta *PolyGetMeta(const Poly *p)
 {
-    size_t i = 1; //indeks, który aktualnie analizujemy
-    size_t last = 0; //ostatni modyfikowany indeks
-    while (i < size)
+    assert(HasNode(p));
+    PolyMeta *meta = (PolyMeta *) Coeffs(p) - 1;
+    if (meta->valid)
+        return meta;
+
+    WalkStack stack;
+    WalkInit(&stack);
+    WalkPush(&stack, (WalkFrame) {.p = p});
+    while (stack.size > 0)
     {
-        if (!PolyIsZero(&monos[i].p)) //jeśli jest zerowy, to go pomijamy
+        WalkFrame *top = &stack.frames[stack.size - 1];
+        const Poly *coeffs = Coeffs(top->p);
+        while (top->i < top->p->size &&
+               (!HasNode(&coeffs[top->i]) || ((PolyMeta *) Coeffs(&coeffs[top->i]) - 1)->valid))
+            top->i++;
+        if (top->i == top->p->size)
         {
-            //dodajemy jednomian z indeksu i do jednomianu o tym samym wykładniku pod indeksem last
-            if (monos[i].exp == monos[last].exp)
-            {
-                //last może się zmniejszyć, gdy powstanie wielomian zerowy, pod indeksem i wstawiamy wielomian zerowy
-                AddMonoToMono(monos, i, &last);
-            } else
-            {
-                last++;
-                if (last != i) //przepisujemy jednomian z indeksu i do indeksu last, w miejsce i wstawiamy zerowy
-                    PushMonoToEmpty(monos, i, last);
-            }
+            PolyMeta *node = (PolyMeta *) Coeffs(top->p) - 1;
+            ComputeMeta(top->p, node);
+            node->valid = true;
+            stack.size--;
+            continue;
         }
-        i++;
+        if (top->i + 1 < top->p->size)
+            PrefetchNode(&coeffs[top->i + 1]);
+        WalkPush(&stack, (WalkFrame) {.p = &coeffs[top->i]}); //po powrocie węzeł ma już metadane
     }
-    *used = last + 1;
+    WalkDestroy(&stack);
+    return meta;
 }
 
 /**
- * Tworzy wielomian z posortowanej tablicy jednomianów lub jeśli
- * w tablicy pozostał tylko jeden jednomian, z wykładnikiem 0 i stałym współczynnikiem,
- * tworzy wielomian stały i zwalnia pamięć tablicy.
- * @param[in] monos : tablica jednomianów
- * @param[in] count : liczba jednomianów
- * @return wielomian wynikowy
+ * Zmniejsza licznik referencji węzła wielomianu.
+ * Zamrożony blok, który nie ma już referencji, zwalnia od razu w całości.
+ * @param[in] p : wielomian niestały z węzłem
+ * @return Czy węzeł nie ma już referencji i trzeba go zwolnić razem ze współczynnikami?
  */
-static Poly CreatePolyFromArr(Mono monos[], size_t count)
+static inline bool NodeRelease(const Poly *p)
 {
-    size_t used = count;
-    if (count > 1)
-        ReduceMonosArr(monos, count, &used); //redukowanie tablicy
-    Poly result;
-    if (used == 1 && (PolyIsZero(&monos[0].p) || (monos[0].exp == 0 && PolyIsCoeff(&monos[0].p))))
-        //wynik będzie wielomianem stałym
-    {
-        result = monos[0].p;
-        free(monos);
-    } else //wielomian nie jest stały - kopiujemy zredukowaną tablicę
+    PolyMeta *meta = RefsOwner(Coeffs(p));
+    if (meta->refs == IMMORTAL_REFS) //węzeł leży w obrazie
+        return false;
+    if (--meta->refs > 0) //węzeł jest jeszcze współdzielony przez inny wielomian
+        return false;
+    if (meta->frozen) //zamrożony blok nie wskazuje węzłów spoza siebie
     {
-        result.size = used;
-        result.arr = monos;
+        free(meta);
+        return false;
     }
-    return result;
+    return true;
 }
 
-Poly PolyAddMonos(size_t count, const Mono monos[])
+/**
+ * Zwalnia węzeł wielomianu, który nie ma już referencji, razem ze współczynnikami.
+ * @param[in] p : wielomian niestały z węzłem, którego licznik referencji spadł do zera
+ */
+static void NodeDestroy(const Poly *p)
 {
-    if (count == 0) //pusta tablica - wielomian zerowy
-        return PolyZero();
-    Mono *monos_cp = CopyMonosArr(monos, count);
+    WalkStack stack;
+    WalkInit(&stack);
+    WalkPush(&stack, (WalkFrame) {.p = p});
+    while (stack.size > 0)
+    {
+        WalkFrame *top = &stack.frames[stack.size - 1];
+        Poly *coeffs = Coeffs(top->p);
+        if (top->i == top->p->size)
+        {
+            //współczynniki są już zwolnione, a rodzic nie czyta już tego jednomianu
+            NodeFree(coeffs);
+            stack.size--;
+            continue;
+        }
+        const Poly *coeff = &coeffs[top->i++];
+        if (top->i < top->p->size)
+            PrefetchNode(&coeffs[top->i]);
+        if (HasNode(coeff) && NodeRelease(coeff))
+            WalkPush(&stack, (WalkFrame) {.p = coeff});
+    }
+    WalkDestroy(&stack);
+}
+
+void PolyDestroy(Poly *p)
+{
+    if (p != NULL && HasNode(p) && NodeRelease(p))
+        NodeDestroy(p);
+}
+
+/**
+ * Sprawdza, czy zwolnienie drzewa węzła, który stracił ostatnią referencję, odda co najmniej
+ * @p min_bytes bajtów. Liczone są tylko węzły, które NodeDestroy rzeczywiście zwolni, czyli
+ * niewspółdzielone. Węzeł ze znanymi metadanymi wnosi cały swój rozmiar, a pozostałe są
+ * przeglądane jawnym stosem tylko do osiągnięcia progu, więc dla małego drzewa sprawdzenie
+ * kosztuje tyle co jego zwolnienie, a dla dużego – tyle co przejrzenie @p min_bytes bajtów.
+ * @param[in] p : wielomian niestały z węzłem, którego licznik referencji spadł do zera
+ * @param[in] min_bytes : próg w bajtach
+ * @return Czy drzewo zajmuje co najmniej @p min_bytes bajtów?
+ */
+static bool ReleasedBytesReach(const Poly *p, size_t min_bytes)
+{
+    const PolyMeta *meta = (PolyMeta *) Coeffs(p) - 1;
+    if (meta->valid)
+        return meta->bytes >= min_bytes;
+    size_t bytes = NodeBytes(p->size, meta->dense);
+    WalkStack stack;
+    WalkInit(&stack);
+    WalkPush(&stack, (WalkFrame) {.p = p});
+    while (bytes < min_bytes && stack.size > 0)
+    {
+        WalkFrame *top = &stack.frames[stack.size - 1];
+        if (top->i == top->p->size)
+        {
+            stack.size--;
+            continue;
+        }
+        const Poly *coeff = &Coeffs(top->p)[top->i++];
+        if (!HasNode(coeff))
+            continue;
+        const PolyMeta *owner = RefsOwner(Coeffs(coeff));
+        if (owner->refs != 1) //węzeł zostanie tylko odłączony albo leży w obrazie
+            continue;
+        const PolyMeta *coeff_meta = (PolyMeta *) Coeffs(coeff) - 1;
+        if (owner->frozen || coeff_meta->valid) //zamrożony blok zawsze ma znane metadane
+        {
+            bytes = TermsAdd(bytes, owner->frozen ? owner->bytes : coeff_meta->bytes);
+            continue;
+        }
+        bytes = TermsAdd(bytes, NodeBytes(coeff->size, coeff_meta->dense));
+        WalkPush(&stack, (WalkFrame) {.p = coeff});
+    }
+    WalkDestroy(&stack);
+    return bytes >= min_bytes;
+}
+
+bool PolyReleaseLarge(Poly *p, size_t min_bytes)
+{
+    if (p == NULL || !HasNode(p) || !NodeRelease(p))
+        return false;
+    if (ReleasedBytesReach(p, min_bytes))
+        return true;
+    NodeDestroy(p);
+    return false;
+}
+
+void PolyDestroyReleased(Poly *p)
+{
+    NodeDestroy(p);
+}
+
+uint64_t PolyHash(const Poly *p)
+{
+    if (p->arr == NULL)
+        return PolyHashMix((uint64_t) p->coeff);
+    if (IsInlineMono(p)) //skrót taki sam jak dla węzła z jednym jednomianem
+        return PolyHashMix(PolyHashMix(POLY_HASH_SEED ^ (uint64_t) InlineExp(p)) + PolyHashMix((uint64_t) p->coeff));
+    return PolyGetMeta(p)->hash;
+}
+
+size_t PolyTerms(const Poly *p)
+{
+    if (p->arr == NULL)
+        return PolyIsZero(p) ? 0 : 1;
+    if (IsInlineMono(p))
+        return 1;
+    return PolyGetMeta(p)->terms;
+}
+
+size_t PolyMemory(const Poly *p)
+{
+    if (!HasNode(p))
+        return 0;
+    return PolyGetMeta(p)->bytes;
+}
+
+Poly PolyShare(const Poly *p)
+{
+    if (!HasNode(p))
+        return *p;
+    PolyMeta *meta = RefsOwner(Coeffs(p));
+    if (meta->refs != IMMORTAL_REFS)
+        meta->refs++;
+    return (Poly) {.size = p->size, .arr = (Mono *) Coeffs(p)}; //kopia wielomianu z obrazu wskazuje węzeł wprost
+}
+
+/**
+ * Alokuje kopię węzła wielomianu z przepisanymi wykładnikami, ale bez współczynników.
+ * @param[in] p : wielomian niestały z węzłem
+ * @return kopia wielomianu z niewypełnioną tablicą współczynników
+ */
+static Poly NodeCopyShallow(const Poly *p)
+{
+    bool dense = IsDense(p);
+    Poly *coeffs = NodeAlloc(p->size, dense);
+    ((PolyMeta *) coeffs - 1)->leaf = IsLeaf(p);
+    if (!dense)
+        memcpy(coeffs + p->size, Exps(p), p->size * sizeof(poly_exp_t));
+    return (Poly) {.size = p->size, .arr = (Mono *) coeffs};
+}
+
+Poly PolyClone(const Poly *p)
+{
+    if (!HasNode(p))
+        return *p;
+
+    Poly result = NodeCopyShallow(p);
+    WalkStack stack;
+    WalkInit(&stack);
+    WalkPush(&stack, (WalkFrame) {.p = p, .out = (Poly *) result.arr});
+    while (stack.size > 0)
+    {
+        WalkFrame *top = &stack.frames[stack.size - 1];
+        if (top->i == top->p->size)
+        {
+            stack.size--;
+            continue;
+        }
+        const Poly *coeffs = Coeffs(top->p);
+        size_t i = top->i++;
+        if (top->i < top->p->size)
+            PrefetchNode(&coeffs[top->i]);
+        if (!HasNode(&coeffs[i]))
+        {
+            top->out[i] = coeffs[i];
+            continue;
+        }
+        top->out[i] = NodeCopyShallow(&coeffs[i]);
+        WalkPush(&stack, (WalkFrame) {.p = &coeffs[i], .out = (Poly *) top->out[i].arr});
+    }
+    WalkDestroy(&stack);
+    return result;
+}
+
+/**
+ * Wyznacza rozmiar węzła wielomianu będącego sumą dwóch wielomianów.
+ * @param[in] p : jednomiany wielomianu albo NULL dla wielomianu stałego
+ * @param[in] q : jednomiany wielomianu albo NULL dla wielomianu stałego
+ * @return liczba jednomianów węzła
+ */
+static size_t SizeOfAddArray(const NodeView *p, const NodeView *q)
+{
+    if (p == NULL && q == NULL)
+        return 0;
+    else if (p != NULL && q != NULL)
+        return p->size + q->size;
+    else if (p != NULL)
+        return p->size + ONE_ARR_CELL_FOR_COEFF;
+    else
+        return q->size + ONE_ARR_CELL_FOR_COEFF;
+}
+
+/**
+ * Dopisuje do wypełnianego węzła kopie jednomianów wielomianu @p p od podanego indeksu do końca.
+ * @param[in] p : jednomiany wielomianu niestałego @f$p@f$
+ * @param[in] result : węzeł wynikowy
+ * @param[in] p_index : indeks pierwszego kopiowanego jednomianu
+ */
+static void ClonePartOfMonos(const NodeView *p, NodeBuilder *result, size_t p_index)
+{
+    for (; p_index < p->size; p_index++)
+        BuilderPush(result, PolyClone(&p->coeffs[p_index]), p->exps[p_index]);
+}
+
+/**
+ * Dodaje dwa niestałe wielomiany, wpisując do węzła wynikowego jednomiany w kolejności
+ * rosnącej według wykładników. Jeśli wykładniki w obu wielomianach są równe, to jako
+ * współczynnik przy tym wykładniku wpisuje sumę współczynników z wielomianów @f$p@f$ i @f$q@f$
+ * (pomijając ją, jeśli jest zerowa). Przegląda tylko tablice wykładników, dopóki nie trafi
+ * na równe wykładniki.
+ * @param[in] p : jednomiany wielomianu @f$p@f$
+ * @param[in] q : jednomiany wielomianu @f$q@f$
+ * @param[in] result : węzeł wynikowy
+ */
+static void PolyAddTwoNonConst(const NodeView *p, const NodeView *q, NodeBuilder *result)
+{
+    const Poly *p_coeffs = p->coeffs;
+    const Poly *q_coeffs = q->coeffs;
+    const poly_exp_t *p_exps = p->exps;
+    const poly_exp_t *q_exps = q->exps;
+    size_t p_index = 0;
+    size_t q_index = 0;
+    while (p_index < p->size && q_index < q->size)
+    {
+        if (p_exps[p_index] == q_exps[q_index])
+        {
+            Poly sum = PolyAdd(&p_coeffs[p_index], &q_coeffs[q_index]);
+            //jeśli w wyniku dodawania otrzymaliśmy wielomian zerowy, to pomijamy go
+            if (!PolyIsZero(&sum))
+                BuilderPush(result, sum, p_exps[p_index]);
+            p_index++;
+            q_index++;
+        } else if (p_exps[p_index] < q_exps[q_index])
+        {
+            BuilderPush(result, PolyClone(&p_coeffs[p_index]), p_exps[p_index]);
+            p_index++;
+        } else
+        {
+            BuilderPush(result, PolyClone(&q_coeffs[q_index]), q_exps[q_index]);
+            q_index++;
+        }
+    }
+    ClonePartOfMonos(p, result, p_index);
+    ClonePartOfMonos(q, result, q_index);
+}
+
+/**
+ * Dodaje dwa liście, scalając tablice wykładników i dodając stałe współczynniki
+ * bez wywołań rekurencyjnych. Współczynniki, które sumują się do zera, są pomijane,
+ * tak jak w PolyAddTwoNonConst.
+ * @param[in] p : jednomiany liścia @f$p@f$
+ * @param[in] q : jednomiany liścia @f$q@f$
+ * @param[in] result : węzeł wynikowy
+ */
+static void LeafAdd(const NodeView *p, const NodeView *q, NodeBuilder *result)
+{
+    size_t p_index = 0;
+    size_t q_index = 0;
+    while (p_index < p->size && q_index < q->size)
+    {
+        poly_exp_t p_exp = p->exps[p_index];
+        poly_exp_t q_exp = q->exps[q_index];
+        if (p_exp == q_exp)
+        {
+            poly_coeff_t sum = (poly_coeff_t) ((uint64_t) p->coeffs[p_index++].coeff + (uint64_t) q->coeffs[q_index++].coeff);
+            if (sum != 0)
+                BuilderPush(result, PolyFromCoeff(sum), p_exp);
+        } else if (p_exp < q_exp)
+            BuilderPush(result, p->coeffs[p_index++], p_exp);
+        else
+            BuilderPush(result, q->coeffs[q_index++], q_exp);
+    }
+    for (; p_index < p->size; p_index++)
+        BuilderPush(result, p->coeffs[p_index], p->exps[p_index]);
+    for (; q_index < q->size; q_index++)
+        BuilderPush(result, q->coeffs[q_index], q->exps[q_index]);
+}
+
+/**
+ * Dodaje dwa wielomiany o węzłach gęstych. Jednomiany o tym samym wykładniku leżą pod tym samym
+ * indeksem, więc zamiast scalania tablic wykładników wystarczy przejść ich wspólną część.
+ * @param[in] p : jednomiany wielomianu @f$p@f$
+ * @param[in] q : jednomiany wielomianu @f$q@f$
+ * @param[in] result : węzeł wynikowy
+ */
+static void DenseAdd(const NodeView *p, const NodeView *q, NodeBuilder *result)
+{
+    size_t common = p->size < q->size ? p->size : q->size;
+    for (size_t i = 0; i < common; i++)
+    {
+        Poly sum = PolyAdd(&p->coeffs[i], &q->coeffs[i]);
+        if (!PolyIsZero(&sum)) //jeśli w wyniku dodawania otrzymaliśmy wielomian zerowy, to pomijamy go
+            BuilderPush(result, sum, (poly_exp_t) i);
+    }
+    ClonePartOfMonos(p, result, common);
+    ClonePartOfMonos(q, result, common);
+}
+
+/**
+ * Dodaje wielomian stały i niestały.
+ * @param[in] p : wielomian stały, niezerowy @f$p@f$
+ * @param[in] q : jednomiany wielomianu niestałego @f$q@f$
+ * @param[in] result : węzeł wynikowy
+ */
+static void PolyAddConstAndNonConst(const Poly *p, const NodeView *q, NodeBuilder *result)
+{
+    if (q->exps[0] != 0) //wstawiamy wielomian p z wykładnikiem 0 i potem kopiujemy cały wielomian q
+    {
+        BuilderPush(result, PolyClone(p), 0);
+        ClonePartOfMonos(q, result, 0);
+    } else
+    {   //pierwszy wykładnik q jest równy 0, więc pod zerowym indeksem dodajemy p i pierwszy współczynnik q
+        Poly sum = PolyAdd(p, &q->coeffs[0]);
+        if (!PolyIsZero(&sum)) //jeśli wynikiem był zerowy wielomian, to pomijamy go
+            BuilderPush(result, sum, 0);
+        ClonePartOfMonos(q, result, 1);
+    }
+}
+
+Poly PolyAdd(const Poly *p, const Poly *q)
+{
+    if (p->arr == NULL && q->arr == NULL) //p i q są wielomianami stałymi
+        return PolyFromCoeff(p->coeff + q->coeff);
+    if (PolyIsZero(p))
+        return PolyClone(q);
+    if (PolyIsZero(q))
+        return PolyClone(p);
+    if (IsInlineMono(p) && IsInlineMono(q) && InlineExp(p) == InlineExp(q)) //suma też nie potrzebuje węzła
+    {
+        poly_coeff_t sum = p->coeff + q->coeff;
+        return sum == 0 ? PolyZero() : InlineMono(sum, InlineExp(p));
+    }
+
+    NodeView p_view, q_view;
+    if (p->arr != NULL)
+        ViewInit(&p_view, p);
+    if (q->arr != NULL)
+        ViewInit(&q_view, q);
+    NodeBuilder result;
+    BuilderInit(&result, SizeOfAddArray(p->arr != NULL ? &p_view : NULL, q->arr != NULL ? &q_view : NULL));
+    if (HasNode(p) && HasNode(q) && IsDense(p) && IsDense(q))
+        DenseAdd(&p_view, &q_view, &result);
+    else if (IsLeaf(p) && IsLeaf(q))
+        LeafAdd(&p_view, &q_view, &result);
+    else if (p->arr != NULL && q->arr != NULL) //oba nie są stałe
+        PolyAddTwoNonConst(&p_view, &q_view, &result);
+    else if (p->arr != NULL) //tylko q jest stały
+        PolyAddConstAndNonConst(q, &p_view, &result);
+    else //tylko p jest stały
+        PolyAddConstAndNonConst(p, &q_view, &result);
+
+    return BuilderFinish(&result);
+}
+
+/**
+ * Porównuje jednomiany według wykładników.
+ */
+static int CmpMonos(const void *a, const void *b)
+{
+    const Mono *p1 = (Mono *) a;
+    const Mono *p2 = (Mono *) b;
+    if (p1->exp < p2->exp)
+        return -1;
+    else if (p1->exp > p2->exp)
+        return 1;
+    else return 0;
+}
+
+/**
+ * Sortuje tablicę jednomianów rosnąco według wykładników. Posortowanej tablicy nie przestawia.
+ * @param[in] monos : tablica jednomianów
+ * @param[in] size : rozmiar tablicy @f$monos@f$
+ */
+static void SortMonosArr(Mono *monos, size_t size)
+{
+    for (size_t i = 1; i < size; i++)
+    {
+        if (monos[i - 1].exp > monos[i].exp) //tablica nie jest posortowana
+        {
+            qsort(monos, size, sizeof(Mono), CmpMonos);
+            return;
+        }
+    }
+}
+
+
+/**
+ * Przepisuje jednomian do innego indeksu w tablicy, a pod stary indeks wstawia wielomiaan zerowy.
+ * @param[in] monos : tablica jednomianów
+ * @param[in] current_index :  indeks, z którego kopiujemy i który wypełniamy zerem
+ * @param[in] last_used_index : indeks, do którego kopiujemy wielomian
+ */
+static void PushMonoToEmpty(Mono *monos, size_t current_index, size_t last_used_index)
+{
+    assert(PolyIsZero(&monos[last_used_index].p));
+    monos[last_used_index].p = monos[current_index].p;
+    monos[last_used_index].exp = monos[current_index].exp;
+    monos[current_index].p = PolyZero();
+}
+
+/**
+ * Dodaje jednomian do innego jednomianu w tablicy jednomianów.
+ * Pod indeks, z którego zabiera jednoman, wpisuje jako współczynnik wielomian zerowy.
+ * @param[in] monos : tablica jednomianów
+ * @param[in] current_index :  indeks, z którego uzyskujemy jednomian do sumy i który wypełniamy zerem
+ * @param[in] last_used_index : indeks, do którego dodajemy jednomian
+ */
+static void AddMonoToMono(Mono *monos, size_t current_index, size_t *last_used_index)
+{
+    Poly temp = PolyClone(&monos[*last_used_index].p); //musimy skopiować, żeby potem móc zwolnić pamięć
+    PolyDestroy(&monos[*last_used_index].p);
+    monos[*last_used_index].p = PolyAdd(&temp, &monos[current_index].p);
+
+    PolyDestroy(&monos[current_index].p);
+    monos[current_index].p = PolyZero();
+    PolyDestroy(&temp);
+
+    if (PolyIsZero(&monos[*last_used_index].p))
+    {
+        if (*last_used_index > 0)
+            (*last_used_index)--;
+    }
+}
+
+/**
+ * Kopiuje tablicę jednomianów (płytka kopia).
+ * @param[in] monos : tablica jednomianów
+ * @param[in] size : rozmiar tablicy @f$monos@f$
+ * @return tablica z kopią jednomianów
+ */
+static Mono *CopyMonosArr(const Mono monos[], size_t size)
+{
+    Mono *res = malloc(size * sizeof(Mono));
+    CHECK_PTR(res);
+    for (size_t i = 0; i < size; i++)
+        res[i] = monos[i];
+
+    return res;
+}
+
+/**
+ * Klonuje tablicę jednomianów (głęboka kopia).
+ * @param[in] monos : tablica jednomianów
+ * @param[in] size : rozmiar tablicy @f$monos@f$
+ * @return tablica z kopią jednomianów
+ */
+static Mono *CloneMonosArr(const Mono *monos, size_t size)
+{
+    Mono *res = malloc(size * sizeof(Mono));
+    CHECK_PTR(res);
+    for (size_t i = 0; i < size; i++)
+    {
+        res[i].p = PolyClone(&(monos[i].p));
+        res[i].exp = monos[i].exp;
+    }
+    return res;
+}
+
+/**
+ * Redukuje tablicę jednomianów, tak, aby w pierszej części tablicy długości @f$used@f$
+ * każdy wykładnik występował maksymalnie raz.
+ * @param[in] monos : tablica jednomianów
+ * @param[in] size :  rozmiar tablicy @f$monos@f$
+ * @param[in] used : użyte miejsce w tablicy
+ */
+static void ReduceMonosArr(Mono *monos, size_t size, size_t *used)
+{
+    size_t i = 1; //indeks, który aktualnie analizujemy
+    size_t last = 0; //ostatni modyfikowany indeks
+    while (i < size)
+    {
+        if (!PolyIsZero(&monos[i].p)) //jeśli jest zerowy, to go pomijamy
+        {
+            //dodajemy jednomian z indeksu i do jednomianu o tym samym wykładniku pod indeksem last
+            if (monos[i].exp == monos[last].exp)
+            {
+                //last może się zmniejszyć, gdy powstanie wielomian zerowy, pod indeksem i wstawiamy wielomian zerowy
+                AddMonoToMono(monos, i, &last);
+            } else
+            {
+                last++;
+                if (last != i) //przepisujemy jednomian z indeksu i do indeksu last, w miejsce i wstawiamy zerowy
+                    PushMonoToEmpty(monos, i, last);
+            }
+        }
+        i++;
+    }
+    *used = last + 1;
+}
+
+/**
+ * Tworzy wielomian z posortowanej tablicy jednomianów lub jeśli
+ * w tablicy pozostał tylko jeden jednomian, z wykładnikiem 0 i stałym współczynnikiem,
+ * tworzy wielomian stały. Zwalnia pamięć tablicy.
+ * @param[in] monos : tablica jednomianów zaalokowana na stercie
+ * @param[in] count : liczba jednomianów
+ * @return wielomian wynikowy
+ */
+static Poly CreatePolyFromArr(Mono monos[], size_t count)
+{
+    size_t used = count;
+    if (count > 1)
+        ReduceMonosArr(monos, count, &used); //redukowanie tablicy
+    if (used == 1 && PolyIsZero(&monos[0].p)) //wynik będzie wielomianem zerowym
+    {
+        free(monos);
+        return PolyZero();
+    }
+    NodeBuilder result;
+    BuilderInit(&result, used);
+    for (size_t i = 0; i < used; i++)
+        BuilderPush(&result, monos[i].p, monos[i].exp);
+    free(monos); //jednomiany poza zredukowaną częścią mają zerowe współczynniki
+    return BuilderFinish(&result);
+}
+
+Poly PolyAddMonos(size_t count, const Mono monos[])
+{
+    if (count == 0) //pusta tablica - wielomian zerowy
+        return PolyZero();
+    Mono *monos_cp = CopyMonosArr(monos, count);
+    SortMonosArr(monos_cp, count);
+    return CreatePolyFromArr(monos_cp, count);
+}
+
+/**
+ * Sumuje listę jednomianów i tworzy z nich wielomian. Przejmuje na własność
+ * pamięć wskazywaną przez @p monos i jej zawartość. Może dowolnie modyfikować
+ * zawartość tej pamięci. Zakładamy, że pamięć wskazywana przez @p monos
+ * została zaalokowana na stercie. Jeśli @p count lub @p monos jest równe zeru
+ * (NULL), tworzy wielomian tożsamościowo równy zeru.
+ * @param[in] count : liczba jednomianów
+ * @param[in] monos : tablica jednomianów
+ * @return wielomian będący sumą jednomianów
+ */
+Poly PolyOwnMonos(size_t count, Mono *monos)
+{
+    if (count == 0) //pusta tablica - wielomian zerowy
+    {
+        free(monos);
+        return PolyZero();
+    }
+    SortMonosArr(monos, count);
+    return CreatePolyFromArr(monos, count);
+}
+
+
+Poly PolyCloneMonos(size_t count, const Mono monos[])
+{
+    if (count == 0) //pusta tablica - wielomian zerowy
+        return PolyZero();
+    Mono *monos_cp = CloneMonosArr(monos, count);
     SortMonosArr(monos_cp, count);
     return CreatePolyFromArr(monos_cp, count);
 }
 
 /**
- * Sumuje listę jednomianów i tworzy z nich wielomian. Przejmuje na własność
- * pamięć wskazywaną przez @p monos i jej zawartość. Może dowolnie modyfikować
- * zawartość tej pamięci. Zakładamy, że pamięć wskazywana przez @p monos
- * została zaalokowana na stercie. Jeśli @p count lub @p monos jest równe zeru
- * (NULL), tworzy wielomian tożsamościowo równy zeru.
+ * Porównuje wielomiany bez przeglądania współczynników ich węzłów.
+ * @param[in] p : wielomian
+ * @param[in] q : wielomian
+ * @param[out] descend : czy oba wielomiany mają węzły, których współczynniki trzeba porównać
+ * @return Czy wielomiany mogą być równe?
+ */
+static inline bool IsEqShallow(const Poly *p, const Poly *q, bool *descend)
+{
+    *descend = false;
+    if (p->arr == NULL && q->arr == NULL)
+        return p->coeff == q->coeff;
+    if (p->arr == NULL || q->arr == NULL)
+        return false;
+    if (IsInlineMono(p) || IsInlineMono(q)) //jednomian w miejscu jest jedyną postacią takiego wielomianu
+        return p->coeff == q->coeff && p->arr == q->arr;
+    //oba mają węzły, więc muszą mieć tę samą liczbę jednomianów w tablicy
+    if (p->size != q->size)
+        return false;
+    //wykładniki muszą być równe
+    if (memcmp(Exps(p), Exps(q), p->size * sizeof(poly_exp_t)) != 0)
+        return false;
+    *descend = Coeffs(p) != Coeffs(q); //współdzielony węzeł jest równy sam sobie
+    return true;
+}
+
+/**
+ * Sprawdza strukturalną równość dwóch wielomianów, porównując kolejne jednomiany.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @return @f$p = q@f$
+ */
+static bool PolyIsEqHelp(const Poly *p, const Poly *q)
+{
+    bool descend;
+    if (!IsEqShallow(p, q, &descend))
+        return false;
+    if (!descend)
+        return true;
+
+    WalkStack stack;
+    WalkInit(&stack);
+    WalkPush(&stack, (WalkFrame) {.p = p, .q = q});
+    bool equal = true;
+    while (stack.size > 0 && equal)
+    {
+        WalkFrame *top = &stack.frames[stack.size - 1];
+        if (top->i == top->p->size)
+        {
+            stack.size--;
+            continue;
+        }
+        const Poly *p_coeff = &Coeffs(top->p)[top->i];
+        const Poly *q_coeff = &Coeffs(top->q)[top->i];
+        top->i++;
+        if (top->i < top->p->size)
+        {
+            PrefetchNode(p_coeff + 1);
+            PrefetchNode(q_coeff + 1);
+        }
+        //współczynniki muszą być takie same
+        equal = IsEqShallow(p_coeff, q_coeff, &descend);
+        if (equal && descend)
+            WalkPush(&stack, (WalkFrame) {.p = p_coeff, .q = q_coeff});
+    }
+    WalkDestroy(&stack);
+    return equal;
+}
+
+bool PolyIsEq(const Poly *p, const Poly *q)
+{
+    if (HasNode(p) && HasNode(q))
+    {
+        if (Coeffs(p) == Coeffs(q)) //wielomian współdzielony
+            return true;
+        if (p->size != q->size)
+            return false;
+        //różne skróty wykluczają równość bez przeglądania drzewa
+        if (PolyHash(p) != PolyHash(q))
+            return false;
+    }
+    return PolyIsEqHelp(p, q);
+}
+
+static Poly PolyMulByCoeff(Poly *p, poly_coeff_t coeff);
+
+/**
+ * Mnoży wielomian przez stały współczynnik.
+ * @param[in] p : wielomian  @f$p@f$
+ * @param[in] coeff : współczynnik
+ * @return @f$p * coeff@f$
+ */
+Poly PolyMulByCoeff(Poly *p, poly_coeff_t coeff)
+{
+    if (PolyIsCoeff(p))
+        return PolyFromCoeff(coeff * (p->coeff));
+    if (IsInlineMono(p))
+    {
+        poly_coeff_t product = coeff * p->coeff;
+        return product == 0 ? PolyZero() : InlineMono(product, InlineExp(p));
+    }
+    NodeBuilder result;
+    BuilderInit(&result, p->size);
+    const Poly *coeffs = Coeffs(p);
+    const poly_exp_t *exps = Exps(p);
+    if (IsLeaf(p)) //współczynniki są stałe, więc wystarczy je przemnożyć
+    {
+        for (size_t i = 0; i < p->size; i++)
+        {
+            poly_coeff_t product = (poly_coeff_t) ((uint64_t) coeffs[i].coeff * (uint64_t) coeff);
+            if (product != 0) //iloczyn może być zerem modulo 2^64
+                BuilderPush(&result, PolyFromCoeff(product), exps[i]);
+        }
+        return BuilderFinish(&result);
+    }
+    for (size_t i = 0; i < p->size; i++)
+    {
+        Poly temp = PolyMulByCoeff((Poly *) &coeffs[i], coeff);
+        if (!PolyIsZero(&temp)) //mnożenie dwóch niezerowych może dać w wyniku zero (overflow)
+            BuilderPush(&result, temp, exps[i]);
+    }
+    return BuilderFinish(&result);
+}
+
+Poly PolyNeg(const Poly *p)
+{
+    return PolyMulByCoeff((Poly *) p, -1);
+}
+
+Poly PolySub(const Poly *p, const Poly *q)
+{
+    Poly neg_q = PolyNeg(q);
+    Poly res = PolyAdd(p, &neg_q);
+    PolyDestroy(&neg_q);
+    return res;
+}
+
+/**
+ * Tworzy tablicę jednomianów, która jest wynikiem mnożenia dwóch wielomianów - każdy jednomian z każdym.
+ * @param[in] p : jednomiany wielomianu  @f$p@f$
+ * @param[in] q : jednomiany wielomianu  @f$q@f$
+ * @param[in] size : rozmiar wynikowej tablicy
+ * @return tablica jednomianów
+ */
+static Mono *FillMonoMulArray(const NodeView *p, const NodeView *q, size_t size)
+{
+    Mono *monos = calloc(size, sizeof(Mono));
+    CHECK_PTR(monos);
+    size_t monos_index = 0;
+    for (size_t i = 0; i < p->size; i++)
+    {
+        for (size_t j = 0; j < q->size; j++)
+        {
+            monos[monos_index].exp = p->exps[i] + q->exps[j];
+            monos[monos_index].p = PolyMul(&p->coeffs[i], &q->coeffs[j]);
+            monos_index++;
+        }
+    }
+    return monos;
+}
+
+/**
+ * Mnoży dwa wielomiany o węzłach gęstych, sumując iloczyny współczynników wprost w tablicy
+ * indeksowanej wykładnikiem, zamiast sortować i redukować tablicę wszystkich iloczynów.
+ * Współczynniki liści są mnożone i sumowane jako liczby.
+ * @param[in] p : wielomian o węźle gęstym @f$p@f$
+ * @param[in] q : wielomian o węźle gęstym @f$q@f$
+ * @return @f$p * q@f$
+ */
+static Poly DenseMul(const Poly *p, const Poly *q)
+{
+    const Poly *p_coeffs = Coeffs(p);
+    const Poly *q_coeffs = Coeffs(q);
+    size_t size = p->size + q->size - 1;
+    Poly *sums = calloc(size, sizeof(Poly));
+    CHECK_PTR(sums);
+    if (IsLeaf(p) && IsLeaf(q))
+    {
+        for (size_t i = 0; i < p->size; i++)
+        {
+            uint64_t coeff = (uint64_t) p_coeffs[i].coeff;
+            for (size_t j = 0; j < q->size; j++) //obliczenia modulo 2^64
+                sums[i + j].coeff = (poly_coeff_t) ((uint64_t) sums[i + j].coeff + coeff * (uint64_t) q_coeffs[j].coeff);
+        }
+    } else
+    {
+        for (size_t i = 0; i < p->size; i++)
+        {
+            for (size_t j = 0; j < q->size; j++)
+            {
+                Poly product = PolyMul(&p_coeffs[i], &q_coeffs[j]);
+                if (PolyIsZero(&sums[i + j]))
+                {
+                    sums[i + j] = product;
+                    continue;
+                }
+                Poly sum = PolyAdd(&sums[i + j], &product);
+                PolyDestroy(&sums[i + j]);
+                PolyDestroy(&product);
+                sums[i + j] = sum;
+            }
+        }
+    }
+
+    //tak jak w ReduceMonosArr zerowa suma przy wykładniku 0 zostaje, jeśli po niej są niezerowe jednomiany
+    bool keep_first = false;
+    for (size_t k = 1; k < size && !keep_first; k++)
+        keep_first = !PolyIsZero(&sums[k]);
+    NodeBuilder result;
+    BuilderInit(&result, size);
+    for (size_t k = 0; k < size; k++)
+    {
+        if (!PolyIsZero(&sums[k]) || (k == 0 && keep_first))
+            BuilderPush(&result, sums[k], (poly_exp_t) k);
+        else
+            PolyDestroy(&sums[k]);
+    }
+    free(sums);
+    return BuilderFinish(&result);
+}
+
+Poly PolyMul(const Poly *p, const Poly *q)
+{
+    if (HasNode(p) && HasNode(q) && IsDense(p) && IsDense(q))
+        return DenseMul(p, q);
+    if (IsInlineMono(p) && IsInlineMono(q)) //iloczyn też nie potrzebuje węzła
+    {
+        poly_coeff_t product = p->coeff * q->coeff;
+        return product == 0 ? PolyZero() : InlineMono(product, InlineExp(p) + InlineExp(q));
+    } else if (p->arr != NULL && q->arr != NULL)
+    {
+        NodeView p_view, q_view;
+        ViewInit(&p_view, p);
+        ViewInit(&q_view, q);
+        size_t size_of_monos = p_view.size * q_view.size;
+        Mono *monos = FillMonoMulArray(&p_view, &q_view, size_of_monos);
+        return PolyOwnMonos(size_of_monos, monos);
+    } else if (p->arr == NULL && q->arr == NULL)
+    {
+        return PolyFromCoeff(p->coeff * q->coeff);
+    } else if (q->arr != NULL)
+    {
+        return PolyMulByCoeff((Poly *) q, p->coeff);
+    } else
+        return PolyMulByCoeff((Poly *) p, q->coeff);
+}
+
+/**
+ * Wykonuje szybkie potęgowanie.
+ * @param[in] x : podstawa
+ * @param[in] n : wykładnik
+ * @return @f$x^n@f$
+ */
+static poly_coeff_t QuickPow(poly_coeff_t x, poly_exp_t n)
+{
+    poly_coeff_t res = 1;
+    while (n > 0)
+    {
+        if (n % 2 == 1)
+            res *= x;
+
+        x *= x;
+        n /= 2;
+    }
+    return res;
+}
+
+
+/**
+ * Wykonuje szybkie potęgowanie modulo @f$2^{64}@f$.
+ * @param[in] x : podstawa
+ * @param[in] n : wykładnik
+ * @return @f$x^n \bmod 2^{64}@f$
+ */
+static uint64_t QuickPowMod(uint64_t x, poly_exp_t n)
+{
+    uint64_t res = 1;
+    while (n > 0)
+    {
+        if (n % 2 == 1)
+            res *= x;
+
+        x *= x;
+        n /= 2;
+    }
+    return res;
+}
+
+/**
+ * Wylicza wartość liścia w punkcie @p x schematem Hornera, bez alokacji pamięci.
+ * Obliczenia są prowadzone modulo @f$2^{64}@f$, więc wynik jest taki sam jak przy
+ * sumowaniu jednomianów.
+ * @param[in] p : jednomiany liścia
+ * @param[in] x : wartość zmiennej
+ * @return @f$p(x)@f$
+ */
+static poly_coeff_t LeafAt(const NodeView *p, poly_coeff_t x)
+{
+    uint64_t res = 0;
+    for (size_t i = p->size; i-- > 0;)
+    {
+        poly_exp_t next_exp = i > 0 ? p->exps[i - 1] : 0;
+        res += (uint64_t) p->coeffs[i].coeff;
+        res *= QuickPowMod((uint64_t) x, p->exps[i] - next_exp);
+    }
+    return (poly_coeff_t) res;
+}
+
+Poly PolyAt(const Poly *p, poly_coeff_t x)
+{
+    if (p->arr == NULL)
+        return PolyClone(p);
+
+    NodeView view;
+    ViewInit(&view, p);
+    if (IsLeaf(p))
+        return PolyFromCoeff(LeafAt(&view, x));
+    bool dense = HasNode(p) && IsDense(p);
+    poly_coeff_t power = 1;
+    Poly result = PolyZero();
+    for (size_t i = 0; i < view.size; i++)
+    {
+        //w węźle gęstym kolejne wykładniki rosną o 1, więc potęgi x wystarczy domnażać
+        if (dense)
+            power = i == 0 ? 1 : (poly_coeff_t) ((uint64_t) power * (uint64_t) x);
+        else
+            power = QuickPow(x, view.exps[i]);
+        //mnożenie wielomianów z tablicy przez x podniesiony do wykładnika
+        Poly mul_result = PolyMulByCoeff((Poly *) &view.coeffs[i], power);
+        Poly temp = result; //trzymamy, żeby potem zwolnić pamięć
+        result = PolyAdd(&result, &mul_result);
+        PolyDestroy(&temp);
+        PolyDestroy(&mul_result);
+    }
+    return result;
+}
+
+/**
+ * To jest stała reprezentująca liczbę losowych punktów, w których porównywane są wartości wielomianów
+ */
+#define IS_EQ_MUL_TRIALS 4
+
+/**
+ * To jest stała reprezentująca liczbę pierwszą @f$2^{61} - 1@f$, modulo której wartości wielomianów
+ * są porównywane w ciele
+ */
+#define EVAL_PRIME ((UINT64_C(1) << 61) - 1)
+
+/**
+ * Redukuje liczbę mniejszą od @f$2^{63}@f$ modulo EVAL_PRIME.
+ * @param[in] x : liczba
+ * @return @f$x \bmod (2^{61} - 1)@f$
+ */
+static inline uint64_t ReducePrime(uint64_t x)
+{
+    x = (x & EVAL_PRIME) + (x >> 61); //2^61 ≡ 1
+    return x >= EVAL_PRIME ? x - EVAL_PRIME : x;
+}
+
+/**
+ * Mnoży liczby modulo EVAL_PRIME.
+ * @param[in] a : liczba mniejsza od EVAL_PRIME
+ * @param[in] b : liczba mniejsza od EVAL_PRIME
+ * @return @f$a b \bmod (2^{61} - 1)@f$
+ */
+static inline uint64_t MulPrime(uint64_t a, uint64_t b)
+{
+    uint64_t a_hi = a >> 32, a_lo = a & UINT32_MAX;
+    uint64_t b_hi = b >> 32, b_lo = b & UINT32_MAX;
+    uint64_t hi = a_hi * b_hi;                  //mnożnik 2^64 ≡ 8
+    uint64_t mid = a_hi * b_lo + a_lo * b_hi;   //mnożnik 2^32, a 2^61 ≡ 1
+    uint64_t lo = a_lo * b_lo;
+    //każdy składnik jest mniejszy od 2^61, więc suma mieści się w 2^63
+    return ReducePrime((hi << 3) + (mid >> 29) + ((mid & ((UINT64_C(1) << 29) - 1)) << 32) +
+                       (lo >> 61) + (lo & EVAL_PRIME));
+}
+
+/**
+ * Wykonuje szybkie potęgowanie modulo EVAL_PRIME.
+ * @param[in] x : podstawa mniejsza od EVAL_PRIME
+ * @param[in] n : wykładnik
+ * @return @f$x^n \bmod (2^{61} - 1)@f$
+ */
+static uint64_t QuickPowPrime(uint64_t x, poly_exp_t n)
+{
+    uint64_t res = 1;
+    while (n > 0)
+    {
+        if (n % 2 == 1)
+            res = MulPrime(res, x);
+        x = MulPrime(x, x);
+        n /= 2;
+    }
+    return res;
+}
+
+/**
+ * Daje resztę współczynnika (jako liczby całkowitej ze znakiem) modulo EVAL_PRIME.
+ * @param[in] c : współczynnik
+ * @return @f$c \bmod (2^{61} - 1)@f$
+ */
+static inline uint64_t CoeffPrime(poly_coeff_t c)
+{
+    if (c >= 0)
+        return (uint64_t) c % EVAL_PRIME;
+    uint64_t rest = (0 - (uint64_t) c) % EVAL_PRIME;
+    return rest == 0 ? 0 : EVAL_PRIME - rest;
+}
+
+/**
+ * Struktura opisująca wartość wielomianu w punkcie liczoną jednocześnie modulo @f$2^{64}@f$
+ * i w ciele modulo EVAL_PRIME.
+ */
+typedef struct EvalPair {
+    uint64_t wrap;  ///< wartość modulo @f$2^{64}@f$
+    uint64_t prime; ///< wartość modulo EVAL_PRIME
+} EvalPair;
+
+/**
+ * Wyznacza pseudolosową wartość zmiennej o danym indeksie dla danego ziarna.
+ * @param[in] seed : ziarno
+ * @param[in] var_idx : indeks zmiennej
+ * @return wartość zmiennej @f$x_{var\_idx}@f$
+ */
+static uint64_t RandomPoint(uint64_t seed, size_t var_idx)
+{
+    return PolyHashMix(seed + POLY_HASH_SEED * (var_idx + 1));
+}
+
+/**
+ * Wylicza wartość wielomianu w punkcie, w którym zmienna @f$x_i@f$ ma wartość RandomPoint(seed, i),
+ * jednocześnie modulo @f$2^{64}@f$ i modulo EVAL_PRIME (w tym ciele zmienna ma wartość
+ * RandomPoint(seed, i) modulo EVAL_PRIME). Nie alokuje pamięci. Współczynniki wielomianów są
+ * liczone modulo @f$2^{64}@f$, więc pierwsza wartość jest zgodna z działaniami na wielomianach;
+ * druga traktuje współczynniki jak liczby całkowite ze znakiem.
+ * @param[in] p : wielomian
+ * @param[in] seed : ziarno wyznaczające punkt
+ * @param[in] var_idx : indeks zmiennej głównej wielomianu @p p
+ * @return wartości wielomianu
+ */
+static EvalPair PolyEvalRandom(const Poly *p, uint64_t seed, size_t var_idx)
+{
+    if (p->arr == NULL)
+        return (EvalPair) {.wrap = (uint64_t) p->coeff, .prime = CoeffPrime(p->coeff)};
+
+    uint64_t x = RandomPoint(seed, var_idx);
+    uint64_t x_prime = x % EVAL_PRIME;
+    NodeView view;
+    ViewInit(&view, p);
+    EvalPair res = {0, 0};
+    //schemat Hornera od największego wykładnika
+    for (size_t i = view.size; i-- > 0;)
+    {
+        poly_exp_t next_exp = i > 0 ? view.exps[i - 1] : 0;
+        EvalPair coeff = PolyEvalRandom(&view.coeffs[i], seed, var_idx + 1);
+        res.wrap += coeff.wrap;
+        res.wrap *= QuickPowMod(x, view.exps[i] - next_exp);
+        res.prime = ReducePrime(res.prime + coeff.prime);
+        res.prime = MulPrime(res.prime, QuickPowPrime(x_prime, view.exps[i] - next_exp));
+    }
+    return res;
+}
+
+bool PolyIsEqMul(const Poly *p, const Poly *q, const Poly *r)
+{
+    for (uint64_t trial = 0; trial < IS_EQ_MUL_TRIALS; trial++)
+    {
+        uint64_t seed = PolyHashMix(trial);
+        EvalPair p_value = PolyEvalRandom(p, seed, 0);
+        EvalPair q_value = PolyEvalRandom(q, seed, 0);
+        EvalPair r_value = PolyEvalRandom(r, seed, 0);
+        //wartościowanie modulo 2^64 jest homomorfizmem, więc różne wartości przesądzają o nierówności
+        if (p_value.wrap * q_value.wrap != r_value.wrap)
+            return false;
+        //w ciele lemat Schwartza-Zippela ogranicza prawdopodobieństwo pomyłki; jeśli równość
+        //nie zachodzi dla liczb całkowitych, to iloczyn przepełnił współczynniki albo wartości
+        //modulo 2^64 zgodziły się przez dzielniki zera, więc trzeba porównać dokładnie
+        if (MulPrime(p_value.prime, q_value.prime) != r_value.prime)
+        {
+            Poly product = PolyMul(p, q);
+            bool equal = PolyIsEq(&product, r);
+            PolyDestroy(&product);
+            return equal;
+        }
+    }
+    return true;
+}
+
+poly_exp_t PolyDeg(const Poly *p)
+{
+    if (PolyIsZero(p))
+        return DEG_OF_ZERO_POLY;
+    if (p->arr == NULL)
+        return 0;
+    if (IsInlineMono(p))
+        return InlineExp(p);
+    return PolyGetMeta(p)->deg;
+}
+
+/**
+ * Zwraca stopień wielomianu ze względu na jego główną (najpłytszą) zmienną $x_0$.
+ * @param[in] p : wielomian
+ * @return stopień wielomianu @p p z względu na zmienną o indeksie 0
+ */
+static poly_exp_t PolyDegByZero(const Poly *p)
+{
+    assert(!PolyIsZero(p));
+    if (p->arr == NULL)
+        return 0;
+    else if (IsInlineMono(p))
+        return InlineExp(p);
+    else
+        return Exps(p)[p->size - 1];
+}
+
+poly_exp_t PolyDegBy(const Poly *p, size_t var_idx)
+{
+    if (PolyIsZero(p))
+        return DEG_OF_ZERO_POLY;
+
+    if (var_idx == 0)
+        return PolyDegByZero(p);
+
+    if (!HasNode(p)) //współczynnik jednomianu w miejscu jest stały
+        return 0;
+
+    poly_exp_t max_deg = DEG_OF_ZERO_POLY;
+    for (size_t i = 0; i < p->size; i++)
+    {
+        //stopień ze względu na zmienną nie przekracza stopnia współczynnika, więc możemy go pominąć
+        if (PolyDeg(&Coeffs(p)[i]) <= max_deg)
+            continue;
+        poly_exp_t temp = PolyDegBy(&Coeffs(p)[i], var_idx - 1);
+        if (temp > max_deg)
+            max_deg = temp;
+    }
+    return max_deg;
+}
+
+/**
+ * To jest stała reprezentująca rozmiar bufora PolyWriter
+ */
+#define POLY_WRITER_BUFFER_SIZE (1 << 16)
+
+/**
+ * To jest stała reprezentująca największą liczbę bajtów dopisywaną do bufora PolyWriter
+ * w jednym kroku (współczynnik albo jednomian przechowywany w miejscu i zamknięcie jednomianu)
+ */
+#define POLY_WRITER_MAX_STEP 64
+
+/**
+ * To jest stała reprezentująca początkowy rozmiar stosu przejścia PolyWriter
+ */
+#define POLY_WRITER_INITIAL_DEPTH 16
+
+/**
+ * Struktura opisująca wielomian niestały, którego jednomiany są w trakcie wypisywania.
+ */
+struct PolyWriterFrame {
+    const Poly *p;  ///< wypisywany wielomian
+    size_t i;       ///< indeks wypisywanego jednomianu
+};
+
+void PolyWriterInit(PolyWriter *writer, FILE *out)
+{
+    writer->out = out;
+    writer->buf = malloc(POLY_WRITER_BUFFER_SIZE);
+    CHECK_PTR(writer->buf);
+    writer->used = 0;
+    writer->size = POLY_WRITER_BUFFER_SIZE;
+    writer->frames = NULL;
+    writer->frames_size = 0;
+}
+
+void PolyWriterFlush(PolyWriter *writer)
+{
+    if (writer->used > 0)
+        fwrite(writer->buf, 1, writer->used, writer->out);
+    writer->used = 0;
+}
+
+void PolyWriterDestroy(PolyWriter *writer)
+{
+    PolyWriterFlush(writer);
+    free(writer->buf);
+    free(writer->frames);
+    writer->buf = NULL;
+    writer->frames = NULL;
+}
+
+/**
+ * Zapewnia, że w buforze jest miejsce na POLY_WRITER_MAX_STEP bajtów.
+ * @param[in] writer : bufor
+ */
+static inline void WriterReserve(PolyWriter *writer)
+{
+    if (writer->size - writer->used < POLY_WRITER_MAX_STEP)
+        PolyWriterFlush(writer);
+}
+
+void PolyWriterPutChar(PolyWriter *writer, char c)
+{
+    WriterReserve(writer);
+    writer->buf[writer->used++] = c;
+}
+
+/**
+ * Dopisuje do bufora liczbę bez znaku. Bufor musi mieć wystarczająco dużo miejsca.
+ * @param[in] writer : bufor
+ * @param[in] value : liczba
+ */
+static inline void WriterPutUnsigned(PolyWriter *writer, uint64_t value)
+{
+    char digits[20];
+    size_t count = 0;
+    do
+    {
+        digits[count++] = (char) ('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    char *dest = writer->buf + writer->used;
+    for (size_t i = 0; i < count; i++)
+        dest[i] = digits[count - 1 - i];
+    writer->used += count;
+}
+
+/**
+ * Dopisuje do bufora współczynnik. Bufor musi mieć wystarczająco dużo miejsca.
+ * @param[in] writer : bufor
+ * @param[in] coeff : współczynnik
+ */
+static inline void WriterPutCoeff(PolyWriter *writer, poly_coeff_t coeff)
+{
+    if (coeff < 0)
+    {
+        writer->buf[writer->used++] = '-';
+        WriterPutUnsigned(writer, -(uint64_t) coeff); //działa także dla LONG_MIN
+    } else
+        WriterPutUnsigned(writer, (uint64_t) coeff);
+}
+
+/**
+ * Dopisuje do bufora zamknięcie jednomianu ",exp)". Bufor musi mieć wystarczająco dużo miejsca.
+ * @param[in] writer : bufor
+ * @param[in] exp : wykładnik
+ */
+static inline void WriterPutMonoEnd(PolyWriter *writer, poly_exp_t exp)
+{
+    writer->buf[writer->used++] = ',';
+    WriterPutCoeff(writer, exp);
+    writer->buf[writer->used++] = ')';
+}
+
+/**
+ * Dopisuje do bufora jednomian przechowywany w miejscu "(c,exp)". Bufor musi mieć
+ * wystarczająco dużo miejsca.
+ * @param[in] writer : bufor
+ * @param[in] p : jednomian przechowywany w miejscu
+ */
+static inline void WriterPutInlineMono(PolyWriter *writer, const Poly *p)
+{
+    writer->buf[writer->used++] = '(';
+    WriterPutCoeff(writer, p->coeff);
+    WriterPutMonoEnd(writer, InlineExp(p));
+}
+
+void PolyWrite(PolyWriter *writer, const Poly *p)
+{
+    WriterReserve(writer);
+    if (p->arr == NULL)
+    {
+        WriterPutCoeff(writer, p->coeff);
+        return;
+    }
+    if (IsInlineMono(p))
+    {
+        WriterPutInlineMono(writer, p);
+        return;
+    }
+
+    size_t depth = 0;
+    if (writer->frames_size == 0)
+    {
+        writer->frames_size = POLY_WRITER_INITIAL_DEPTH;
+        writer->frames = malloc(writer->frames_size * sizeof(struct PolyWriterFrame));
+        CHECK_PTR(writer->frames);
+    }
+    writer->frames[depth++] = (struct PolyWriterFrame) {p, 0};
+    while (depth > 0)
+    {
+        struct PolyWriterFrame *frame = &writer->frames[depth - 1];
+        WriterReserve(writer);
+        if (frame->i == frame->p->size) //wszystkie jednomiany wypisane - wracamy do rodzica
+        {
+            depth--;
+            if (depth > 0)
+            {
+                struct PolyWriterFrame *parent = &writer->frames[depth - 1];
+                WriterPutMonoEnd(writer, Exps(parent->p)[parent->i]);
+                parent->i++;
+            }
+            continue;
+        }
+        if (frame->i > 0)
+            writer->buf[writer->used++] = '+';
+        writer->buf[writer->used++] = '(';
+        const Poly *coeff = &Coeffs(frame->p)[frame->i];
+        if (!HasNode(coeff))
+        {
+            if (coeff->arr == NULL)
+                WriterPutCoeff(writer, coeff->coeff);
+            else
+                WriterPutInlineMono(writer, coeff);
+            WriterPutMonoEnd(writer, Exps(frame->p)[frame->i]);
+            frame->i++;
+            continue;
+        }
+        if (depth == writer->frames_size)
+        {
+            writer->frames_size *= 2;
+            writer->frames = realloc(writer->frames, writer->frames_size * sizeof(struct PolyWriterFrame));
+            CHECK_PTR(writer->frames);
+        }
+        writer->frames[depth++] = (struct PolyWriterFrame) {coeff, 0};
+    }
+}
+
+void PolyPrint(Poly *p)
+{
+    PolyWriter writer;
+    PolyWriterInit(&writer, stdout);
+    PolyWrite(&writer, p);
+    PolyWriterDestroy(&writer);
+}
+
+/**
+ * Dopisuje do bufora liczbę w kodowaniu o zmiennej długości (po 7 bitów w bajcie, najpierw
+ * najmłodsze, najstarszy bit bajtu oznacza, że liczba ma kolejne bajty). Bufor musi mieć
+ * wystarczająco dużo miejsca.
+ * @param[in] writer : bufor
+ * @param[in] value : liczba
+ */
+static inline void WriterPutVarint(PolyWriter *writer, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        writer->buf[writer->used++] = (char) (value | 0x80);
+        value >>= 7;
+    }
+    writer->buf[writer->used++] = (char) value;
+}
+
+/**
+ * Zamienia współczynnik na liczbę bez znaku tak, aby liczby o małej wartości bezwzględnej
+ * miały krótkie kodowanie (0, -1, 1, -2, … przechodzą na 0, 1, 2, 3, …).
+ * @param[in] coeff : współczynnik
+ * @return zakodowany współczynnik
+ */
+static inline uint64_t ZigZag(poly_coeff_t coeff)
+{
+    return ((uint64_t) coeff << 1) ^ (coeff < 0 ? UINT64_MAX : 0);
+}
+
+/**
+ * Odwraca ZigZag.
+ * @param[in] value : zakodowany współczynnik
+ * @return współczynnik
+ */
+static inline poly_coeff_t UnZigZag(uint64_t value)
+{
+    return (poly_coeff_t) ((value >> 1) ^ (0 - (value & 1)));
+}
+
+/**
+ * Dopisuje do bufora jednomian przechowywany w miejscu w postaci węzła z jednym jednomianem.
+ * Bufor musi mieć wystarczająco dużo miejsca.
+ * @param[in] writer : bufor
+ * @param[in] p : jednomian przechowywany w miejscu
+ */
+static inline void WriterPutBinaryInlineMono(PolyWriter *writer, const Poly *p)
+{
+    WriterPutVarint(writer, 1);
+    WriterPutVarint(writer, ((uint64_t) InlineExp(p) << 1) | 1);
+    WriterPutVarint(writer, ZigZag(p->coeff));
+}
+
+void PolyWriteBinary(PolyWriter *writer, const Poly *p)
+{
+    WriterReserve(writer);
+    if (p->arr == NULL)
+    {
+        WriterPutVarint(writer, 0);
+        WriterPutVarint(writer, ZigZag(p->coeff));
+        return;
+    }
+    if (IsInlineMono(p))
+    {
+        WriterPutBinaryInlineMono(writer, p);
+        return;
+    }
+
+    size_t depth = 0;
+    if (writer->frames_size == 0)
+    {
+        writer->frames_size = POLY_WRITER_INITIAL_DEPTH;
+        writer->frames = malloc(writer->frames_size * sizeof(struct PolyWriterFrame));
+        CHECK_PTR(writer->frames);
+    }
+    WriterPutVarint(writer, p->size);
+    writer->frames[depth++] = (struct PolyWriterFrame) {p, 0};
+    while (depth > 0)
+    {
+        struct PolyWriterFrame *frame = &writer->frames[depth - 1];
+        if (frame->i == frame->p->size)
+        {
+            depth--;
+            continue;
+        }
+        WriterReserve(writer);
+        const Poly *coeff = &Coeffs(frame->p)[frame->i];
+        const poly_exp_t *exps = Exps(frame->p);
+        poly_exp_t previous = frame->i > 0 ? exps[frame->i - 1] : 0;
+        bool is_coeff = coeff->arr == NULL;
+        WriterPutVarint(writer, ((uint64_t) (exps[frame->i] - previous) << 1) | is_coeff);
+        frame->i++;
+        if (is_coeff)
+        {
+            WriterPutVarint(writer, ZigZag(coeff->coeff));
+            continue;
+        }
+        if (IsInlineMono(coeff))
+        {
+            WriterPutBinaryInlineMono(writer, coeff);
+            continue;
+        }
+        WriterPutVarint(writer, coeff->size);
+        if (depth == writer->frames_size)
+        {
+            writer->frames_size *= 2;
+            writer->frames = realloc(writer->frames, writer->frames_size * sizeof(struct PolyWriterFrame));
+            CHECK_PTR(writer->frames);
+        }
+        writer->frames[depth++] = (struct PolyWriterFrame) {coeff, 0};
+    }
+}
+
+/**
+ * Struktura opisująca pozycję w odczytywanych danych binarnych.
+ */
+typedef struct BinaryReader {
+    const unsigned char *pos;   ///< pierwszy nieodczytany bajt
+    const unsigned char *end;   ///< koniec danych
+} BinaryReader;
+
+/**
+ * Odczytuje liczbę zapisaną przez WriterPutVarint.
+ * @param[in] reader : pozycja w danych
+ * @param[out] value : odczytana liczba
+ * @return Czy odczytano poprawną liczbę?
+ */
+static bool ReadVarint(BinaryReader *reader, uint64_t *value)
+{
+    uint64_t result = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7)
+    {
+        if (reader->pos == reader->end)
+            return false;
+        unsigned char byte = *reader->pos++;
+        result |= (uint64_t) (byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Rozpoczyna odczyt wielomianu niestałego o @p count jednomianach. Jednomiany są dopisywane
+ * do węzła po kolei, więc częściowo odczytany wielomian można usunąć przez PolyDestroy.
+ * Końcowa liczba jednomianów jest znana, więc wykładniki od razu trafiają na swoje miejsce
+ * za @p count współczynnikami.
+ * @param[in] reader : pozycja w danych
  * @param[in] count : liczba jednomianów
- * @param[in] monos : tablica jednomianów
- * @return wielomian będący sumą jednomianów
+ * @param[out] p : wielomian
+ * @return Czy liczba jednomianów jest poprawna?
  */
-Poly PolyOwnMonos(size_t count, Mono *monos)
+static bool StartBinaryPoly(const BinaryReader *reader, uint64_t count, Poly *p)
 {
-    if (count == 0) //pusta tablica - wielomian zerowy
-        return PolyZero();
-    SortMonosArr(monos, count);
-    return CreatePolyFromArr(monos, count);
+    if (count == 0 || count > (uint64_t) (reader->end - reader->pos) / 2) //każdy jednomian zajmuje co najmniej 2 bajty
+        return false;
+    p->size = 0;
+    p->arr = (Mono *) NodeAlloc(count, false);
+    return true;
 }
 
+/**
+ * Struktura opisująca wielomian niestały, którego jednomiany są w trakcie odczytu.
+ */
+typedef struct BinaryFrame {
+    Poly *p;        ///< odczytywany wielomian
+    size_t count;   ///< liczba jednomianów do odczytania
+} BinaryFrame;
 
-Poly PolyCloneMonos(size_t count, const Mono monos[])
+size_t PolyReadBinary(const void *data, size_t size, Poly *p)
 {
-    if (count == 0) //pusta tablica - wielomian zerowy
-        return PolyZero();
-    Mono *monos_cp = CloneMonosArr(monos, count);
-    SortMonosArr(monos_cp, count);
-    return CreatePolyFromArr(monos_cp, count);
+    BinaryReader reader = {data, (const unsigned char *) data + size};
+    uint64_t count;
+    uint64_t value = 0;
+    if (!ReadVarint(&reader, &count))
+        return 0;
+    if (count == 0)
+    {
+        if (!ReadVarint(&reader, &value))
+            return 0;
+        *p = PolyFromCoeff(UnZigZag(value));
+        return reader.pos - (const unsigned char *) data;
+    }
+
+    Poly result;
+    if (!StartBinaryPoly(&reader, count, &result))
+        return 0;
+    size_t frames_size = POLY_WRITER_INITIAL_DEPTH;
+    BinaryFrame *frames = malloc(frames_size * sizeof(BinaryFrame));
+    CHECK_PTR(frames);
+    size_t depth = 0;
+    frames[depth++] = (BinaryFrame) {&result, count};
+    bool correct = true;
+    while (depth > 0 && correct)
+    {
+        BinaryFrame *frame = &frames[depth - 1];
+        if (frame->p->size == frame->count)
+        {
+            depth--;
+            Poly *coeffs = Coeffs(frame->p);
+            if (frame->count == 1 && coeffs[0].arr == NULL && Exps(frame->p)[0] == 0)
+            {
+                correct = false; //stała przy wykładniku 0 nie jest zapisywana jako węzeł
+                continue;
+            }
+            if (frame->count == 1 && coeffs[0].arr == NULL)
+            {
+                Poly mono = InlineMono(coeffs[0].coeff, Exps(frame->p)[0]); //taki jednomian nie ma węzła
+                NodeFree(coeffs);
+                *frame->p = mono;
+                continue;
+            }
+            bool leaf = true;
+            for (size_t i = 0; i < frame->count; i++)
+                leaf = leaf && coeffs[i].arr == NULL;
+            const poly_exp_t *exps = Exps(frame->p);
+            PolyMeta *meta = (PolyMeta *) coeffs - 1;
+            meta->leaf = leaf;
+            meta->dense = frame->count <= DENSE_MAX_SIZE && exps[0] == 0 && exps[frame->count - 1] == (poly_exp_t) frame->count - 1;
+            continue;
+        }
+        uint64_t tag = 0;
+        correct = ReadVarint(&reader, &tag);
+        Poly *coeffs = Coeffs(frame->p);
+        poly_exp_t *exps = (poly_exp_t *) (coeffs + frame->count);
+        uint64_t previous = frame->p->size > 0 ? (uint64_t) exps[frame->p->size - 1] : 0;
+        uint64_t delta = tag >> 1;
+        if (!correct || (frame->p->size > 0 && delta == 0) || delta > (uint64_t) INT_MAX - previous)
+        {
+            correct = false;
+            continue;
+        }
+        Poly *coeff = &coeffs[frame->p->size];
+        exps[frame->p->size] = (poly_exp_t) (previous + delta);
+        *coeff = PolyZero();
+        frame->p->size++;
+        if (tag & 1)
+        {
+            correct = ReadVarint(&reader, &value) && value != 0; //zerowe jednomiany nie są zapisywane
+            coeff->coeff = UnZigZag(value);
+            continue;
+        }
+        correct = ReadVarint(&reader, &count) && StartBinaryPoly(&reader, count, coeff);
+        if (!correct)
+            continue;
+        if (depth == frames_size)
+        {
+            frames_size *= 2;
+            frames = realloc(frames, frames_size * sizeof(BinaryFrame));
+            CHECK_PTR(frames);
+        }
+        frames[depth++] = (BinaryFrame) {coeff, count};
+    }
+    free(frames);
+    if (!correct)
+    {
+        PolyDestroy(&result);
+        return 0;
+    }
+    *p = result;
+    return reader.pos - (const unsigned char *) data;
 }
 
-bool PolyIsEq(const Poly *p, const Poly *q)
+/**
+ * To jest stała reprezentująca nagłówek obrazu wielomianu (z numerem wersji formatu)
+ */
+#define POLY_IMAGE_MAGIC "POLYIMG4"
+
+/**
+ * Nagłówek obrazu wielomianu. Obraz zawiera węzły w takim samym układzie jak w pamięci
+ * (z nagłówkami metadanych), ułożone w kolejności preorder, więc jest zgodny
+ * tylko z programem skompilowanym dla tej samej architektury.
+ */
+typedef struct PolyImageHeader {
+    char magic[8];          ///< POLY_IMAGE_MAGIC
+    uint32_t poly_size;     ///< sizeof(Poly)
+    uint32_t meta_size;     ///< sizeof(PolyMeta)
+    uint64_t size;          ///< rozmiar obrazu w bajtach
+    uint64_t coeff_or_size; ///< współczynnik albo liczba jednomianów wielomianu
+    uint64_t root;          ///< położenie węzła wielomianu względem początku obrazu albo 0
+    uint64_t inline_exp;    ///< wykładnik wielomianu będącego jednomianem przechowywanym w miejscu albo 0
+} PolyImageHeader;
+
+/**
+ * Układa w bloku pamięci węzeł wielomianu niestałego, a po nim kolejno węzły jego
+ * współczynników (w kolejności preorder). W obrazie (PolyWriteImage) współczynniki wskazują
+ * swoje węzły przesunięciami, a w bloku zamrożonym (PolyFreeze) wskaźnikami.
+ * @param[in] block : początek bloku
+ * @param[in] p : wielomian niestały
+ * @param[in] pos : położenie nagłówka metadanych węzła względem początku bloku
+ * @param[in] image : czy blok jest obrazem
+ */
+static void LayoutNode(char *block, const Poly *p, size_t pos, bool image)
 {
-    if (p->arr == NULL && q->arr == NULL)
-        return p->coeff == q->coeff;
-    if (p->arr == NULL || q->arr == NULL)
+    PolyMeta *meta = (PolyMeta *) (block + pos);
+    *meta = *PolyGetMeta(p);
+    meta->refs = image ? IMMORTAL_REFS : FROZEN_REFS_TAG | pos;
+    meta->frozen = false;
+    Poly *coeffs = (Poly *) (meta + 1);
+    if (!meta->dense)
+        memcpy(coeffs + p->size, Exps(p), p->size * sizeof(poly_exp_t));
+    size_t child_pos = pos + NodeBytes(p->size, meta->dense);
+    for (size_t i = 0; i < p->size; i++)
+    {
+        const Poly *coeff = &Coeffs(p)[i];
+        coeffs[i] = *coeff;
+        if (!HasNode(coeff))
+            continue;
+        LayoutNode(block, coeff, child_pos, image);
+        Poly *child = (Poly *) (block + child_pos + sizeof(PolyMeta));
+        if (image)
+        {
+            size_t offset = (size_t) ((char *) child - (char *) &coeffs[i].arr);
+            coeffs[i].arr = (Mono *) ((offset << 1) | IMAGE_OFFSET_TAG);
+        }
+        else
+            coeffs[i].arr = (Mono *) child;
+        child_pos += PolyMemory(coeff);
+    }
+}
+
+bool PolyWriteImage(FILE *out, const Poly *p)
+{
+    if (PolyMemory(p) > SIZE_MAX - sizeof(PolyImageHeader)) //rozmiar drzewa przekroczył zakres
         return false;
-    //oba są niestałe, więc muszą mieć tę samą liczbę jednomianów w tablicy
-    if (p->size != q->size)
+    size_t size = sizeof(PolyImageHeader) + PolyMemory(p);
+    char *image = calloc(1, size);
+    if (image == NULL)
         return false;
+    PolyImageHeader *header = (PolyImageHeader *) image;
+    memcpy(header->magic, POLY_IMAGE_MAGIC, sizeof(header->magic));
+    header->poly_size = sizeof(Poly);
+    header->meta_size = sizeof(PolyMeta);
+    header->size = size;
+    if (!HasNode(p))
+    {
+        header->coeff_or_size = (uint64_t) p->coeff;
+        header->inline_exp = p->arr == NULL ? 0 : (uint64_t) InlineExp(p);
+    } else
+    {
+        header->coeff_or_size = p->size;
+        header->root = sizeof(PolyImageHeader);
+        LayoutNode(image, p, sizeof(PolyImageHeader), true);
+    }
+    bool written = fwrite(image, 1, size, out) == size;
+    free(image);
+    return written;
+}
 
+/**
+ * Sprawdza węzeł leżący w obrazie na pozycji @p pos, zanim zostaną sprawdzone węzły jego
+ * współczynników: czy węzeł razem z tablicami współczynników i wykładników mieści się
+ * w obrazie, czy ma niezerową liczbę jednomianów i rosnące, nieujemne wykładniki, czy jego
+ * nagłówek jest taki, jaki zapisuje LayoutNode, i czy jednomiany przechowywane w miejscu
+ * są poprawne. Węzeł oznaczony jako liść może mieć tylko stałe współczynniki. Wielomian musi
+ * być w postaci kanonicznej: stałe współczynniki nie są zerami, a węzeł z jednym jednomianem
+ * nie ma stałego współczynnika (taki wielomian jest stałą albo jednomianem w miejscu).
+ * @param[in] image : początek obrazu
+ * @param[in] size : rozmiar obrazu w bajtach
+ * @param[in] p : wielomian wskazujący węzeł
+ * @param[in] pos : położenie nagłówka metadanych węzła względem początku obrazu (nie większe niż @p size)
+ * @return Czy węzeł jest poprawny?
+ */
+static bool ImageNodeValid(const char *image, size_t size, const Poly *p, size_t pos)
+{
+    if (size - pos < sizeof(PolyMeta))
+        return false;
+    const PolyMeta *meta = (const PolyMeta *) (image + pos);
+    unsigned char valid, frozen, leaf, dense; //pola logiczne obrazu mogą mieć dowolne bajty
+    memcpy(&valid, &meta->valid, 1);
+    memcpy(&frozen, &meta->frozen, 1);
+    memcpy(&leaf, &meta->leaf, 1);
+    memcpy(&dense, &meta->dense, 1);
+    if (meta->refs != IMMORTAL_REFS || valid != 1 || frozen != 0 || leaf > 1 || dense > 1)
+        return false;
+    if (p->size == 0 || p->size > (size - pos - sizeof(PolyMeta)) / sizeof(Poly) ||
+        (dense && p->size > DENSE_MAX_SIZE) || NodeBytes(p->size, dense) > size - pos)
+        return false;
+    const Poly *coeffs = (const Poly *) (meta + 1);
+    const poly_exp_t *exps = dense ? DENSE_EXPS : (const poly_exp_t *) (coeffs + p->size);
     for (size_t i = 0; i < p->size; i++)
     {
-        if (p->arr[i].exp != q->arr[i].exp) //wykładniki muszą być równe
+        if (exps[i] < 0 || (i > 0 && exps[i] <= exps[i - 1]))
+            return false;
+        uintptr_t arr = (uintptr_t) coeffs[i].arr;
+        if (arr == 0 && (coeffs[i].coeff == 0 || p->size == 1)) //postać kanoniczna, jak w BuilderFinish
             return false;
-        if (!PolyIsEq(&p->arr[i].p, &q->arr[i].p)) //współczynniki muszą być takie same
+        if (arr == 0)
+            continue;
+        if (leaf || (arr & ARR_TAG_MASK) == 0) //wskaźnik nie może leżeć w obrazie
+            return false;
+        if (IsInlineMono(&coeffs[i]) &&
+            (coeffs[i].coeff == 0 || arr >> INLINE_EXP_SHIFT == 0 || arr >> INLINE_EXP_SHIFT > INT_MAX))
             return false;
     }
     return true;
 }
 
-static Poly PolyMulByCoeff(Poly *p, poly_coeff_t coeff);
+/**
+ * Sprawdza całe drzewo wielomianu w obrazie, zanim zostanie udostępnione: węzły muszą leżeć
+ * kolejno w porządku preorder, tak jak układa je LayoutNode, więc każde przesunięcie wskazuje
+ * wnętrze obrazu za swoim węzłem, drzewo nie ma cykli ani współdzielonych węzłów i zajmuje
+ * cały obraz. Zapisane metadane każdego węzła muszą zgadzać się z wyznaczonymi na nowo.
+ * Węzły są odwiedzane z jawnym stosem, tak jak w PolyGetMeta.
+ * @param[in] image : początek obrazu
+ * @param[in] size : rozmiar obrazu w bajtach
+ * @param[in] root : wielomian wskazujący węzeł w obrazie na pozycji @p pos
+ * @param[in] pos : położenie nagłówka metadanych węzła wielomianu względem początku obrazu
+ * @return Czy drzewo jest poprawne?
+ */
+static bool ImageTreeValid(const char *image, size_t size, const Poly *root, size_t pos)
+{
+    if (pos > size || !ImageNodeValid(image, size, root, pos))
+        return false;
+    size_t next = pos + NodeBytes(root->size, IsDense(root)); //położenie kolejnego węzła
+    bool valid = true;
+    WalkStack stack;
+    WalkInit(&stack);
+    WalkPush(&stack, (WalkFrame) {.p = root});
+    while (valid && stack.size > 0)
+    {
+        WalkFrame *top = &stack.frames[stack.size - 1];
+        const Poly *coeffs = Coeffs(top->p);
+        if (top->i == top->p->size)
+        {
+            const PolyMeta *meta = (const PolyMeta *) coeffs - 1;
+            const poly_exp_t *exps = Exps(top->p);
+            for (size_t i = 0; i < top->p->size; i++)
+                if (PolyDeg(&coeffs[i]) > 0 && exps[i] > INT_MAX - PolyDeg(&coeffs[i])) //stopień poza zakresem
+                    valid = false;
+            PolyMeta expected;
+            ComputeMeta(top->p, &expected);
+            valid = valid && meta->deg == expected.deg && meta->terms == expected.terms &&
+                    meta->bytes == expected.bytes && meta->hash == expected.hash;
+            stack.size--;
+            continue;
+        }
+        const Poly *coeff = &coeffs[top->i++];
+        if (!HasNode(coeff))
+            continue;
+        size_t field = (size_t) ((const char *) &coeff->arr - image);
+        uintptr_t arr = (uintptr_t) coeff->arr;
+        valid = (arr & IMAGE_OFFSET_TAG) && (arr >> 1) == next + sizeof(PolyMeta) - field &&
+                ImageNodeValid(image, size, coeff, next);
+        if (valid)
+        {
+            next += NodeBytes(coeff->size, IsDense(coeff));
+            WalkPush(&stack, (WalkFrame) {.p = coeff});
+        }
+    }
+    WalkDestroy(&stack);
+    return valid && next == size;
+}
+
+bool PolyFromImage(const void *image, size_t size, Poly *p)
+{
+    if (size < sizeof(PolyImageHeader) || (uintptr_t) image % sizeof(uint64_t) != 0)
+        return false;
+    const PolyImageHeader *header = image;
+    if (memcmp(header->magic, POLY_IMAGE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->poly_size != sizeof(Poly) || header->meta_size != sizeof(PolyMeta) || header->size != size)
+        return false;
+    if (header->root == 0)
+    {
+        if (header->inline_exp == 0)
+            *p = PolyFromCoeff((poly_coeff_t) header->coeff_or_size);
+        else if (header->coeff_or_size != 0 && header->inline_exp <= INT_MAX)
+            *p = InlineMono((poly_coeff_t) header->coeff_or_size, (poly_exp_t) header->inline_exp);
+        else
+            return false;
+        return true;
+    }
+    if (header->root != sizeof(PolyImageHeader) || size - header->root < sizeof(PolyMeta) ||
+        header->coeff_or_size == 0 || header->coeff_or_size > (size - header->root - sizeof(PolyMeta)) / sizeof(Poly))
+        return false;
+    Poly root = {.size = header->coeff_or_size,
+                 .arr = (Mono *) ((const char *) image + header->root + sizeof(PolyMeta))};
+    if (!ImageTreeValid(image, size, &root, header->root))
+        return false;
+    *p = root;
+    return true;
+}
+
+Poly PolyFreeze(const Poly *p)
+{
+    if (!HasNode(p) || PolyMemory(p) == SIZE_MAX)
+        return PolyShare(p);
+    PolyMeta *owner = RefsOwner(Coeffs(p));
+    if (owner->frozen || owner->refs == IMMORTAL_REFS) //wielomian już leży w jednym bloku
+        return PolyShare(p);
+    char *block = malloc(PolyMemory(p));
+    if (block == NULL) //zamrożenie jest tylko optymalizacją
+        return PolyShare(p);
+    LayoutNode(block, p, 0, false);
+    PolyMeta *root = (PolyMeta *) block;
+    root->refs = 1;
+    root->frozen = true;
+    return (Poly) {.size = p->size, .arr = (Mono *) (root + 1)};
+}
 
 /**
- * Wypełnia tablicę jednomianów wynikiem mnożenia jednomianów przez stały współczynnik
- * @param[in] p : wielomian  @f$p@f$
- * @param[in] result : wielomian wynikowy @f$result@f$
- * @param[in] coeff : współczynnik
- * @param[in] count : licznik jednomianów w tablicy @f$arr@f$ wielomianu  @f$result@f$
+ * Wykonuje szybkie potęgowanie wielomianu.
+ * @param[in] p : podstawa - wielomian
+ * @param[in] exp : wykładnik
+ * @return @f$p^exp@f$
+ */
+static Poly PolyQuickPow(const Poly *p, poly_exp_t exp)
+{
+    Poly res = PolyFromCoeff(1);
+    Poly q = PolyClone(p);
+    while (exp > 0)
+    {
+        if (exp % 2 == 1)
+        {
+            Poly temp = PolyMul(&res, &q);
+            PolyDestroy(&res);
+            res = temp;
+        }
+        Poly temp = PolyMul(&q, &q);
+        PolyDestroy(&q);
+        q = temp;
+        exp /= 2;
+    }
+    PolyDestroy(&q);
+    return res;
+}
+
+/**
+ * Funkcja rekurencyjna, wykonuje operację składania wielomianów. jeśli @p p jest wielomianem stałym, zwraca jego kopię.
+ * W przeciwnym razie tworzy wielomian wyjściowy i dla wszystkich elementów w tablicy jednomianów:
+ * wywołuje się dla wielomianu tego jednomianu, przekazując stopień zagłębienia o jeden większy,
+ * potęguje q[depth] do potęgi tego jednomianu (lub jeśli k jest mniejsze od stopnia, to wynik potęgowania jest zerem),
+ * mnoży wynik rekurencji i potęgowania i wynik mnożenia dodaje do wielomianu wyjściowego.
+ *
+ * @param[in] p : wielomian, do którego podstawiamy wieomiany z tablicy q
+ * @param[in] k : liczba wielomianóœ w tablicy q
+ * @param[in] q : tablica wielomianów
+ * @param[in] depth : stopień zagłębienia w wielomianie p
+ * @return złożenie wielomianów
  */
-static void PolyMulByCoeffHelp(Poly *p, Poly *result, poly_coeff_t coeff, size_t *count)
+static Poly PolyComposeHelp(const Poly *p, size_t k, const Poly q[], size_t depth)
+{
+    if (PolyIsCoeff(p))
+        return PolyClone(p);
+
+    NodeView view;
+    ViewInit(&view, p);
+    Poly res = PolyZero();
+    for (size_t i = 0; i < view.size; i++)
+    {
+        Poly deep_result = PolyComposeHelp(&view.coeffs[i], k, q, depth + 1);
+        Poly power_result;
+        if (k == 0 || depth >= k)
+        {
+            Poly temp = PolyZero();
+            //nie można zrobić power_result=PolyZero, bo jeśli exp=0, to wtedy powinien być wielomian stały 1
+            power_result = PolyQuickPow(&temp, view.exps[i]);
+        } else
+            power_result = PolyQuickPow(&(q[depth]), view.exps[i]);
+        Poly current_index_res = PolyMul(&deep_result, &power_result);
+        Poly add_result = PolyAdd(&res, &current_index_res);
+        PolyDestroy(&power_result);
+        PolyDestroy(&res);
+        PolyDestroy(&deep_result);
+        PolyDestroy(&current_index_res);
+        res = add_result;
+    }
+    return res;
+}
+
+Poly PolyCompose(const Poly *p, size_t k, const Poly q[])
 {
-    assert(*count == 0);
+    return PolyComposeHelp(p, k, q, 0);
+}
+
+
+size_t PolyVarCount(const Poly *p)
+{
+    if (PolyIsCoeff(p))
+        return 0;
+    if (!HasNode(p))
+        return 1;
+    size_t count = 0;
     for (size_t i = 0; i < p->size; i++)
     {
-        Poly temp = PolyMulByCoeff(&p->arr[i].p, coeff);
-        if (!PolyIsZero(&temp)) //mnożenie dwóch niezerowych może dać w wyniku zero (overflow)
+        size_t coeff_count = PolyVarCount(&Coeffs(p)[i]);
+        if (coeff_count > count)
+            count = coeff_count;
+    }
+    return count + 1;
+}
+
+/**
+ * Struktura opisująca wielomian rozwinięty do głębokości @p width: każdy wiersz to wektor
+ * wykładników zmiennych @f$x_0, …, x_{width-1}@f$ i współczynnik leżący na tej głębokości
+ * (wielomian zmiennych @f$x_{width}, x_{width+1}, …@f$ albo stała).
+ */
+typedef struct TermRows {
+    poly_exp_t *exps;   ///< wykładniki, @p width kolejnych na wiersz
+    Poly *coeffs;       ///< współczynniki wierszy
+    size_t width;       ///< liczba zmiennych w wierszu
+    size_t count;       ///< liczba wierszy
+    size_t capacity;    ///< liczba wierszy, na które jest miejsce
+} TermRows;
+
+/**
+ * Struktura opisująca wiersz w trakcie grupowania według kolejnych zmiennych.
+ */
+typedef struct RowRef {
+    size_t group;       ///< numer grupy wierszy o równych wykładnikach dotąd rozpatrzonych zmiennych
+    poly_exp_t key;     ///< wykładnik rozpatrywanej zmiennej
+    size_t row;         ///< numer wiersza
+} RowRef;
+
+/**
+ * Dopisuje wiersze wielomianu @p p leżącego na głębokości @p depth, o wykładnikach
+ * zmiennych powyżej zapisanych w @p prefix. Jednomiany o zerowych współczynnikach są pomijane.
+ * @param[in,out] rows : wiersze
+ * @param[in] p : wielomian
+ * @param[in,out] prefix : wykładniki zmiennych @f$x_0, …, x_{depth-1}@f$
+ * @param[in] depth : głębokość
+ * @param[in] share : czy współdzielić współczynniki (w przeciwnym razie nie wolno ich usuwać)
+ */
+static void RowsCollect(TermRows *rows, const Poly *p, poly_exp_t *prefix, size_t depth, bool share)
+{
+    if (PolyIsZero(p))
+        return;
+    if (depth < rows->width && !PolyIsCoeff(p))
+    {
+        NodeView view;
+        ViewInit(&view, p);
+        for (size_t i = 0; i < view.size; i++)
         {
-            result->arr[*count].p = temp;
-            result->arr[*count].exp = p->arr[i].exp;
-            (*count)++;
+            prefix[depth] = view.exps[i];
+            RowsCollect(rows, &view.coeffs[i], prefix, depth + 1, share);
         }
+        return;
+    }
+    if (rows->count == rows->capacity)
+    {
+        rows->capacity = rows->capacity * 2 + 1;
+        rows->coeffs = realloc(rows->coeffs, rows->capacity * sizeof(Poly));
+        CHECK_PTR(rows->coeffs);
+        rows->exps = realloc(rows->exps, rows->capacity * (rows->width > 0 ? rows->width : 1) * sizeof(poly_exp_t));
+        CHECK_PTR(rows->exps);
     }
+    poly_exp_t *exps = rows->exps + rows->count * rows->width;
+    for (size_t i = 0; i < rows->width; i++)
+        exps[i] = i < depth ? prefix[i] : 0;
+    rows->coeffs[rows->count] = share ? PolyShare(p) : *p;
+    rows->count++;
 }
 
 /**
- * Mnoży wielomian przez stały współczynnik.
- * @param[in] p : wielomian  @f$p@f$
- * @param[in] coeff : współczynnik
- * @return @f$p * coeff@f$
+ * Rozwija wielomian do głębokości @p width.
+ * @param[out] rows : wiersze (do zwolnienia przez RowsDestroy)
+ * @param[in] p : wielomian
+ * @param[in] width : głębokość
+ * @param[in] share : czy współdzielić współczynniki
+ */
+static void RowsInit(TermRows *rows, const Poly *p, size_t width, bool share)
+{
+    rows->exps = NULL;
+    rows->coeffs = NULL;
+    rows->width = width;
+    rows->count = 0;
+    rows->capacity = 0;
+    poly_exp_t *prefix = malloc((width > 0 ? width : 1) * sizeof(poly_exp_t));
+    CHECK_PTR(prefix);
+    RowsCollect(rows, p, prefix, 0, share);
+    free(prefix);
+}
+
+/**
+ * Zwalnia tablice wierszy (bez współczynników).
+ * @param[in] rows : wiersze
+ */
+static void RowsDestroy(TermRows *rows)
+{
+    free(rows->exps);
+    free(rows->coeffs);
+}
+
+/**
+ * Daje wykładnik zmiennej @p var w wierszu. Zmienne spoza wierszy mają wykładnik 0.
+ * @param[in] rows : wiersze
+ * @param[in] row : numer wiersza
+ * @param[in] var : numer zmiennej
+ * @return wykładnik
+ */
+static inline poly_exp_t RowExp(const TermRows *rows, size_t row, size_t var)
+{
+    return var < rows->width ? rows->exps[row * rows->width + var] : 0;
+}
+
+/**
+ * Porównuje wiersze według grupy, a potem według wykładnika rozpatrywanej zmiennej.
+ */
+static int CmpRowRefs(const void *a, const void *b)
+{
+    const RowRef *r1 = a;
+    const RowRef *r2 = b;
+    if (r1->group != r2->group)
+        return r1->group < r2->group ? -1 : 1;
+    if (r1->key != r2->key)
+        return r1->key < r2->key ? -1 : 1;
+    return 0;
+}
+
+/**
+ * Dzieli grupy wierszy według wykładnika zmiennej @p var i numeruje nowe grupy od 0.
+ * @param[in] rows : wiersze
+ * @param[in,out] refs : opisy wierszy
+ * @param[in] var : numer zmiennej
+ * @return liczba nowych grup, czyli liczba różnych wykładników zmiennych dotąd rozpatrzonych
+ */
+static size_t RowsRefine(const TermRows *rows, RowRef *refs, size_t var)
+{
+    for (size_t i = 0; i < rows->count; i++)
+        refs[i].key = RowExp(rows, refs[i].row, var);
+    qsort(refs, rows->count, sizeof(RowRef), CmpRowRefs);
+    size_t groups = 0;
+    size_t prev_group = 0;
+    poly_exp_t prev_key = 0;
+    for (size_t i = 0; i < rows->count; i++)
+    {
+        if (i == 0 || refs[i].group != prev_group || refs[i].key != prev_key)
+            groups++;
+        prev_group = refs[i].group;
+        prev_key = refs[i].key;
+        refs[i].group = groups - 1;
+    }
+    return groups;
+}
+
+/**
+ * Sortuje wiersze leksykograficznie według wykładników zmiennych @f$x_{order[0]}, …,
+ * x_{order[width-1]}@f$.
+ * @param[in] rows : wiersze
+ * @param[out] refs : opisy wierszy w kolejności posortowanej
+ * @param[in] order : kolejność zmiennych
+ * @param[in] width : liczba zmiennych w kolejności
+ * @return łączna liczba różnych przedrostków długości @f$1, …, width@f$
+ */
+static size_t RowsOrder(const TermRows *rows, RowRef *refs, const size_t order[], size_t width)
+{
+    for (size_t i = 0; i < rows->count; i++)
+        refs[i] = (RowRef) {.group = 0, .key = 0, .row = i};
+    size_t cost = 0;
+    for (size_t depth = 0; depth < width; depth++)
+        cost = TermsAdd(cost, RowsRefine(rows, refs, order[depth]));
+    return cost;
+}
+
+/**
+ * Buduje wielomian z posortowanych przez RowsOrder wierszy @f$refs[lo], …, refs[hi-1]@f$,
+ * które mają równe wykładniki zmiennych na głębokościach mniejszych niż @p depth.
+ * Przejmuje na własność współczynniki wierszy.
+ * @param[in] rows : wiersze
+ * @param[in] refs : opisy wierszy w kolejności posortowanej
+ * @param[in] lo : początek przedziału
+ * @param[in] hi : koniec przedziału
+ * @param[in] depth : głębokość
+ * @param[in] order : kolejność zmiennych
+ * @param[in] width : liczba zmiennych w kolejności
+ * @return wielomian
  */
-Poly PolyMulByCoeff(Poly *p, poly_coeff_t coeff)
+static Poly RowsBuild(const TermRows *rows, const RowRef *refs, size_t lo, size_t hi, size_t depth,
+                      const size_t order[], size_t width)
 {
-    if (PolyIsCoeff(p))
-        return PolyFromCoeff(coeff * (p->coeff));
-    Poly res = PolyNewFromSize(p->size);
-    size_t count = 0;
-    PolyMulByCoeffHelp(p, &res, coeff, &count);
-    if (count == 0)
+    if (depth == width)
     {
-        PolyDestroy(&res);
-        return PolyZero();
+        assert(hi - lo == 1);
+        return rows->coeffs[refs[lo].row];
     }
-    res.size = count;
-    if (count == 1 && res.arr[0].exp == 0 && PolyIsCoeff(&res.arr[0].p)) //można zredukować do wielomianu stałego
+    size_t groups = 0;
+    for (size_t i = lo; i < hi; i++)
     {
-        poly_coeff_t result = res.arr[0].p.coeff;
-        PolyDestroy(&res);
-        return PolyFromCoeff(result);
+        if (i == lo || RowExp(rows, refs[i].row, order[depth]) != RowExp(rows, refs[i - 1].row, order[depth]))
+            groups++;
     }
-    return res;
+    NodeBuilder builder;
+    BuilderInit(&builder, groups);
+    size_t begin = lo;
+    while (begin < hi)
+    {
+        poly_exp_t exp = RowExp(rows, refs[begin].row, order[depth]);
+        size_t end = begin + 1;
+        while (end < hi && RowExp(rows, refs[end].row, order[depth]) == exp)
+            end++;
+        BuilderPush(&builder, RowsBuild(rows, refs, begin, end, depth + 1, order, width), exp);
+        begin = end;
+    }
+    return BuilderFinish(&builder);
 }
 
-Poly PolyNeg(const Poly *p)
+/**
+ * Wyznacza kolejność zmiennych po permutacji: zmienna na głębokości @f$d@f$ to ta zmienna
+ * @f$x_i@f$, dla której @f$perm[i] = d@f$. Głębokości, na które nie trafia żadna z pierwszych
+ * @p count zmiennych, dostają numer spoza wierszy (wykładnik 0).
+ * @param[in] count : liczba permutowanych zmiennych występujących w wielomianie
+ * @param[in] perm : permutacja
+ * @param[out] width : liczba głębokości, na których leżą permutowane zmienne
+ * @return kolejność zmiennych (do zwolnienia przez wywołującego)
+ */
+static size_t *PermOrder(size_t count, const size_t perm[], size_t *width)
 {
-    return PolyMulByCoeff((Poly *) p, -1);
+    *width = count;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (perm[i] + 1 > *width)
+            *width = perm[i] + 1;
+    }
+    size_t *order = malloc((*width > 0 ? *width : 1) * sizeof(size_t));
+    CHECK_PTR(order);
+    for (size_t depth = 0; depth < *width; depth++)
+        order[depth] = SIZE_MAX;
+    for (size_t i = 0; i < count; i++)
+        order[perm[i]] = i;
+    return order;
 }
 
-Poly PolySub(const Poly *p, const Poly *q)
+Poly PolyPermuteVars(const Poly *p, size_t k, const size_t perm[])
 {
-    Poly neg_q = PolyNeg(q);
-    Poly res = PolyAdd(p, &neg_q);
-    PolyDestroy(&neg_q);
+    size_t count = PolyVarCount(p);
+    if (k < count)
+        count = k;
+    bool identity = true;
+    for (size_t i = 0; i < count && identity; i++)
+        identity = perm[i] == i;
+    if (identity)
+        return PolyClone(p);
+
+    size_t width;
+    size_t *order = PermOrder(count, perm, &width);
+    TermRows rows;
+    RowsInit(&rows, p, count, true);
+    RowRef *refs = malloc((rows.count > 0 ? rows.count : 1) * sizeof(RowRef));
+    CHECK_PTR(refs);
+    RowsOrder(&rows, refs, order, width);
+    Poly res = RowsBuild(&rows, refs, 0, rows.count, 0, order, width);
+    free(refs);
+    RowsDestroy(&rows);
+    free(order);
     return res;
 }
 
-/**
- * Mnoży dwa jednomiany
- * @param[in] p : jednomian  @f$p@f$
- * @param[in] q : jednomian  @f$q@f$
- * @return @f$p * q@f$
- */
-static Mono MonoMul(Mono *p, Mono *q)
+size_t PolyOrderCost(const Poly *p, size_t k, const size_t perm[])
 {
-    Mono res;
-    res.exp = p->exp + q->exp;
-    res.p = PolyMul(&p->p, &q->p);
-    return res;
+    size_t count = PolyVarCount(p);
+    if (k < count)
+        count = k;
+    size_t width;
+    size_t *order = PermOrder(count, perm, &width);
+    TermRows rows;
+    RowsInit(&rows, p, count, false);
+    RowRef *refs = malloc((rows.count > 0 ? rows.count : 1) * sizeof(RowRef));
+    CHECK_PTR(refs);
+    size_t cost = RowsOrder(&rows, refs, order, width);
+    free(refs);
+    RowsDestroy(&rows);
+    free(order);
+    return cost;
 }
 
-/**
- * Tworzy tablicę jednomianów, która jest wynikiem mnożenia dwóch tablic - każdy indeks z każdym.
- * @param[in] p : wielomian  @f$p@f$
- * @param[in] q : wielomian  @f$q@f$
- * @param[in] size : rozmiar wynikowej tablicy
- * @return tablica jednomianów
- */
-static Mono *FillMonoMulArray(const Poly *p, const Poly *q, size_t size)
+void PolyBestVarOrder(const Poly *p, size_t k, size_t perm[])
 {
-    Mono *monos = calloc(size, sizeof(Mono));
-    CHECK_PTR(monos);
-    size_t monos_index = 0;
-    for (size_t i = 0; i < p->size; i++)
+    size_t count = PolyVarCount(p);
+    if (k < count)
+        count = k;
+    for (size_t i = count; i < k; i++)
+        perm[i] = i;
+    if (count == 0)
+        return;
+
+    TermRows rows;
+    RowsInit(&rows, p, count, false);
+    size_t refs_bytes = (rows.count > 0 ? rows.count : 1) * sizeof(RowRef);
+    RowRef *refs = malloc(refs_bytes);
+    RowRef *candidate = malloc(refs_bytes);
+    RowRef *best = malloc(refs_bytes);
+    bool *used = calloc(count, sizeof(bool));
+    CHECK_PTR(refs);
+    CHECK_PTR(candidate);
+    CHECK_PTR(best);
+    CHECK_PTR(used);
+    for (size_t i = 0; i < rows.count; i++)
+        refs[i] = (RowRef) {.group = 0, .key = 0, .row = i};
+
+    size_t groups = rows.count > 0 ? 1 : 0;
+    for (size_t depth = 0; depth < count; depth++)
     {
-        for (size_t j = 0; j < q->size; j++)
+        size_t best_var = count;
+        size_t best_groups = SIZE_MAX;
+        for (size_t var = 0; var < count; var++)
         {
-            monos[monos_index] = MonoMul(&p->arr[i], &q->arr[j]);
-            monos_index++;
+            if (used[var])
+                continue;
+            if (groups == rows.count) //wiersze są już rozróżnione, więc zachowujemy pierwotną kolejność
+            {
+                best_var = var;
+                break;
+            }
+            memcpy(candidate, refs, rows.count * sizeof(RowRef));
+            size_t candidate_groups = RowsRefine(&rows, candidate, var);
+            if (candidate_groups < best_groups)
+            {
+                best_var = var;
+                best_groups = candidate_groups;
+                RowRef *temp = best;
+                best = candidate;
+                candidate = temp;
+            }
         }
+        if (groups != rows.count)
+        {
+            RowRef *temp = refs;
+            refs = best;
+            best = temp;
+            groups = best_groups;
+        }
+        used[best_var] = true;
+        perm[best_var] = depth;
     }
-    return monos;
+    free(used);
+    free(best);
+    free(candidate);
+    free(refs);
+    RowsDestroy(&rows);
 }
 
-Poly PolyMul(const Poly *p, const Poly *q)
-{
-    if (p->arr != NULL && q->arr != NULL)
-    {
-        size_t size_of_monos = p->size * q->size;
-        Mono *monos = FillMonoMulArray(p, q, size_of_monos);
-        Poly res = PolyAddMonos(size_of_monos, monos);
-        free(monos);
-        return res;
-    } else if (p->arr == NULL && q->arr == NULL)
-    {
-        return PolyFromCoeff(p->coeff * q->coeff);
-    } else if (q->arr != NULL)
-    {
-        return PolyMulByCoeff((Poly *) q, p->coeff);
-    } else
-        return PolyMulByCoeff((Poly *) p, q->coeff);
-}
+/**
+ * To jest stała reprezentująca największą liczbę potęg wartości zmiennej w tablicy
+ * używanej przez PolyPartialEval
+ */
+#define PARTIAL_EVAL_TABLE_SIZE 1024
 
 /**
- * Wykonuje szybkie potęgowanie.
- * @param[in] x : podstawa
- * @param[in] n : wykładnik
- * @return @f$x^n@f$
+ * Struktura opisująca podstawianie wartości pod wybrane zmienne.
  */
-static poly_coeff_t QuickPow(poly_coeff_t x, poly_exp_t n)
+typedef struct PartialEval {
+    const bool *mask;               ///< które zmienne są podstawiane
+    const poly_coeff_t *values;     ///< wartości zmiennych
+    size_t limit;                   ///< numer ostatniej podstawianej zmiennej powiększony o 1
+    size_t table_size;              ///< liczba potęg w tablicy
+    uint64_t **powers;              ///< tablice potęg wartości zmiennych albo NULL, jeśli jeszcze nie były potrzebne
+} PartialEval;
+
+/**
+ * Daje potęgę wartości podstawianej zmiennej modulo @f$2^{64}@f$. Tablica potęg zmiennej
+ * jest wypełniana przy pierwszym użyciu.
+ * @param[in,out] eval : opis podstawiania
+ * @param[in] var : numer zmiennej
+ * @param[in] exp : wykładnik
+ * @return @f$values[var]^{exp}@f$
+ */
+static uint64_t PartialEvalPower(PartialEval *eval, size_t var, poly_exp_t exp)
 {
-    poly_coeff_t res = 1;
-    while (n > 0)
+    uint64_t x = (uint64_t) eval->values[var];
+    if ((size_t) exp >= eval->table_size)
+        return QuickPowMod(x, exp);
+    if (eval->powers[var] == NULL)
     {
-        if (n % 2 == 1)
-            res *= x;
-
-        x *= x;
-        n /= 2;
+        eval->powers[var] = malloc(eval->table_size * sizeof(uint64_t));
+        CHECK_PTR(eval->powers[var]);
+        eval->powers[var][0] = 1;
+        for (size_t i = 1; i < eval->table_size; i++)
+            eval->powers[var][i] = eval->powers[var][i - 1] * x;
     }
-    return res;
+    return eval->powers[var][exp];
 }
 
+/**
+ * Dodaje wielomiany parami, tak aby dodawane wielomiany miały podobne rozmiary.
+ * Przejmuje na własność wielomiany z tablicy.
+ * @param[in] polys : wielomiany
+ * @param[in] count : liczba wielomianów
+ * @return suma wielomianów
+ */
+static Poly PolySumPairwise(Poly polys[], size_t count)
+{
+    if (count == 0)
+        return PolyZero();
+    if (count == 1)
+        return polys[0];
+    Poly left = PolySumPairwise(polys, count / 2);
+    Poly right = PolySumPairwise(polys + count / 2, count - count / 2);
+    Poly sum = PolyAdd(&left, &right);
+    PolyDestroy(&left);
+    PolyDestroy(&right);
+    return sum;
+}
 
-Poly PolyAt(const Poly *p, poly_coeff_t x)
+/**
+ * Funkcja rekurencyjna, podstawia wartości pod wybrane zmienne wielomianu leżącego
+ * na głębokości @p depth. Poddrzewa bez podstawianych zmiennych są współdzielone z @p p.
+ * @param[in,out] eval : opis podstawiania
+ * @param[in] p : wielomian
+ * @param[in] depth : głębokość
+ * @return wielomian po podstawieniu
+ */
+static Poly PartialEvalHelp(PartialEval *eval, const Poly *p, size_t depth)
 {
-    if (p->arr == NULL)
-        return PolyClone(p);
+    if (depth >= eval->limit || PolyIsCoeff(p))
+        return PolyShare(p);
 
-    Poly result = PolyZero();
-    for (size_t i = 0; i < p->size; i++)
+    NodeView view;
+    ViewInit(&view, p);
+    if (!eval->mask[depth])
     {
-        //mnożenie wielomianów z tablicy przez x podniesiony do wykładnika
-        Poly mul_result = PolyMulByCoeff(&p->arr[i].p, QuickPow(x, p->arr[i].exp));
-        Poly temp = result; //trzymamy, żeby potem zwolnić pamięć
-        result = PolyAdd(&result, &mul_result);
-        PolyDestroy(&temp);
-        PolyDestroy(&mul_result);
+        NodeBuilder result;
+        BuilderInit(&result, view.size);
+        for (size_t i = 0; i < view.size; i++)
+        {
+            Poly coeff = PartialEvalHelp(eval, &view.coeffs[i], depth + 1);
+            if (!PolyIsZero(&coeff))
+                BuilderPush(&result, coeff, view.exps[i]);
+        }
+        return BuilderFinish(&result);
     }
-    return result;
+    if (IsLeaf(p)) //współczynniki są stałe, więc wynik jest stałą
+    {
+        uint64_t sum = 0;
+        for (size_t i = 0; i < view.size; i++)
+            sum += (uint64_t) view.coeffs[i].coeff * PartialEvalPower(eval, depth, view.exps[i]);
+        return PolyFromCoeff((poly_coeff_t) sum);
+    }
+    Poly *terms = malloc(view.size * sizeof(Poly));
+    CHECK_PTR(terms);
+    for (size_t i = 0; i < view.size; i++)
+    {
+        Poly coeff = PartialEvalHelp(eval, &view.coeffs[i], depth + 1);
+        terms[i] = PolyMulByCoeff(&coeff, (poly_coeff_t) PartialEvalPower(eval, depth, view.exps[i]));
+        PolyDestroy(&coeff);
+    }
+    Poly sum = PolySumPairwise(terms, view.size);
+    free(terms);
+    //zmienne nie są przenumerowywane, więc suma jest współczynnikiem przy x_depth^0
+    NodeBuilder result;
+    BuilderInit(&result, 1);
+    if (!PolyIsZero(&sum))
+        BuilderPush(&result, sum, 0);
+    return BuilderFinish(&result);
 }
 
-poly_exp_t PolyDeg(const Poly *p)
+Poly PolyPartialEval(const Poly *p, size_t k, const bool mask[], const poly_coeff_t values[])
 {
-    if (PolyIsZero(p))
-        return DEG_OF_ZERO_POLY;
-    if (p->arr == NULL)
-        return 0;
-    poly_exp_t result = 0;
-    for (size_t i = 0; i < p->size; i++) //szukamy największego występującego wykładnika
+    PartialEval eval = {.mask = mask, .values = values, .limit = 0};
+    for (size_t i = 0; i < k; i++)
     {
-        poly_exp_t temp = p->arr[i].exp + PolyDeg(&p->arr[i].p);
-        if (temp > result)
-            result = temp;
+        if (mask[i])
+            eval.limit = i + 1;
     }
-    return result;
+    if (eval.limit == 0)
+        return PolyShare(p);
+    poly_exp_t deg = PolyDeg(p);
+    eval.table_size = deg < PARTIAL_EVAL_TABLE_SIZE ? (size_t) deg + 1 : PARTIAL_EVAL_TABLE_SIZE;
+    eval.powers = calloc(eval.limit, sizeof(uint64_t *));
+    CHECK_PTR(eval.powers);
+    Poly res = PartialEvalHelp(&eval, p, 0);
+    for (size_t i = 0; i < eval.limit; i++)
+        free(eval.powers[i]);
+    free(eval.powers);
+    return res;
 }
 
 /**
- * Zwraca stopień wielomianu ze względu na jego główną (najpłytszą) zmienną $x_0$.
+ * Funkcja rekurencyjna, wylicza wartość wielomianu leżącego na głębokości @p depth
+ * i dodaje do @p grad jego pochodne cząstkowe pomnożone przez @p weight, czyli przez iloczyn
+ * potęg zmiennych z wyższych poziomów. Obliczenia są prowadzone modulo @f$2^{64}@f$.
  * @param[in] p : wielomian
- * @return stopień wielomianu @p p z względu na zmienną o indeksie 0
+ * @param[in] depth : głębokość
+ * @param[in] k : liczba zmiennych o zadanych wartościach
+ * @param[in] xs : wartości zmiennych
+ * @param[in] weight : mnożnik pochodnych
+ * @param[in,out] grad : pochodne cząstkowe
+ * @return wartość wielomianu
  */
-static poly_exp_t PolyDegByZero(const Poly *p)
+static uint64_t EvalGradHelp(const Poly *p, size_t depth, size_t k, const poly_coeff_t xs[], uint64_t weight,
+                             poly_coeff_t grad[])
 {
-    assert(!PolyIsZero(p));
-    if (p->arr == NULL)
-        return 0;
-    else
-        return p->arr[p->size - 1].exp;
+    if (PolyIsCoeff(p))
+        return (uint64_t) p->coeff;
+
+    NodeView view;
+    ViewInit(&view, p);
+    if (depth >= k) //pozostałe zmienne są równe 0, więc liczy się tylko jednomian z wykładnikiem 0
+        return view.exps[0] == 0 ? EvalGradHelp(&view.coeffs[0], depth + 1, k, xs, 0, grad) : 0;
+
+    uint64_t x = (uint64_t) xs[depth];
+    bool dense = HasNode(p) && IsDense(p);
+    uint64_t value = 0;
+    uint64_t deriv = 0;
+    uint64_t power = 1;
+    uint64_t prev_power = 0; //x^(exp - 1), dla wykładnika 0 nieużywane
+    for (size_t i = 0; i < view.size; i++)
+    {
+        poly_exp_t exp = view.exps[i];
+        //w węźle gęstym kolejne wykładniki rosną o 1, więc potęgi x wystarczy domnażać
+        if (dense)
+        {
+            prev_power = power;
+            power = i == 0 ? 1 : power * x;
+        } else if (exp > 0)
+        {
+            prev_power = QuickPowMod(x, exp - 1);
+            power = prev_power * x;
+        } else
+            power = 1;
+        uint64_t coeff = IsLeaf(p) ? (uint64_t) view.coeffs[i].coeff :
+                         EvalGradHelp(&view.coeffs[i], depth + 1, k, xs, weight * power, grad);
+        value += coeff * power;
+        if (exp > 0)
+            deriv += coeff * (uint64_t) exp * prev_power;
+    }
+    grad[depth] = (poly_coeff_t) ((uint64_t) grad[depth] + weight * deriv);
+    return value;
 }
 
-poly_exp_t PolyDegBy(const Poly *p, size_t var_idx)
+void PolyEvalGrad(const Poly *p, size_t k, const poly_coeff_t xs[], poly_coeff_t *out_value,
+                  poly_coeff_t out_grad[])
 {
-    if (PolyIsZero(p))
-        return DEG_OF_ZERO_POLY;
+    for (size_t i = 0; i < k; i++)
+        out_grad[i] = 0;
+    *out_value = (poly_coeff_t) EvalGradHelp(p, 0, k, xs, 1, out_grad);
+}
 
-    if (var_idx == 0)
-        return PolyDegByZero(p);
+/**
+ * To jest stała reprezentująca liczbę bitów cyfry w sortowaniu pozycyjnym składników
+ */
+#define RADIX_BITS 16
 
-    if (p->arr == NULL)
-        return 0;
+/**
+ * To jest stała reprezentująca liczbę różnych cyfr w sortowaniu pozycyjnym składników
+ */
+#define RADIX_BUCKETS ((size_t) 1 << RADIX_BITS)
 
-    poly_exp_t max_deg = DEG_OF_ZERO_POLY;
-    for (size_t i = 0; i < p->size; i++)
+/**
+ * To jest stała reprezentująca liczbę składników, na które jest miejsce po pierwszej alokacji PolyBuilder
+ */
+#define POLY_BUILDER_INITIAL_SIZE 16
+
+void PolyBuilderInit(PolyBuilder *builder, size_t vars)
+{
+    builder->vars = vars;
+    builder->count = 0;
+    builder->capacity = 0;
+    builder->exps = NULL;
+    builder->coeffs = NULL;
+}
+
+void PolyBuilderAddTerm(PolyBuilder *builder, const poly_exp_t exps[], poly_coeff_t coeff)
+{
+    if (coeff == 0)
+        return;
+    if (builder->count == builder->capacity)
     {
-        poly_exp_t temp = PolyDegBy(&p->arr[i].p, var_idx - 1);
-        if (temp > max_deg)
-            max_deg = temp;
+        builder->capacity = builder->capacity * 2 + POLY_BUILDER_INITIAL_SIZE;
+        builder->coeffs = realloc(builder->coeffs, builder->capacity * sizeof(poly_coeff_t));
+        CHECK_PTR(builder->coeffs);
+        builder->exps = realloc(builder->exps, builder->capacity * (builder->vars > 0 ? builder->vars : 1) *
+                                               sizeof(poly_exp_t));
+        CHECK_PTR(builder->exps);
     }
-    return max_deg;
+    poly_exp_t *dest = builder->exps + builder->count * builder->vars;
+    for (size_t i = 0; i < builder->vars; i++)
+    {
+        assert(exps[i] >= 0);
+        dest[i] = exps[i];
+    }
+    builder->coeffs[builder->count] = coeff;
+    builder->count++;
 }
 
 /**
- * Wypisuje jednomian w formacie (p,exp)
- * @param[in] mono : jednomian do wypisania
+ * Sortuje składniki leksykograficznie według wektorów wykładników, sortowaniem pozycyjnym
+ * (od ostatniej zmiennej i od najmłodszych bitów), więc w czasie liniowym.
+ * Przebiegi, w których wszystkie cyfry są równe, są pomijane.
+ * @param[in] builder : składniki
+ * @param[in,out] idx : tablica numerów składników
+ * @param[in,out] temp : tablica pomocnicza tego samego rozmiaru
+ * @return tablica (@p idx albo @p temp) z numerami składników w kolejności posortowanej
  */
-static void MonoPrint(Mono *mono)
+static size_t *TermsSort(const PolyBuilder *builder, size_t *idx, size_t *temp)
 {
-    printf("(");
-    PolyPrint(&mono->p);
-    printf(",%d)", mono->exp);
+    size_t count = builder->count;
+    size_t *counts = malloc((RADIX_BUCKETS + 1) * sizeof(size_t));
+    CHECK_PTR(counts);
+    for (size_t i = 0; i < count; i++)
+        idx[i] = i;
+    for (size_t var = builder->vars; var-- > 0;)
+    {
+        for (unsigned shift = 0; shift < sizeof(poly_exp_t) * CHAR_BIT; shift += RADIX_BITS)
+        {
+            memset(counts, 0, (RADIX_BUCKETS + 1) * sizeof(size_t));
+            for (size_t i = 0; i < count; i++)
+                counts[(((uint32_t) builder->exps[idx[i] * builder->vars + var] >> shift) & (RADIX_BUCKETS - 1)) + 1]++;
+            bool trivial = false;
+            for (size_t digit = 0; digit < RADIX_BUCKETS && !trivial; digit++)
+                trivial = counts[digit + 1] == count;
+            if (trivial)
+                continue;
+            for (size_t digit = 0; digit < RADIX_BUCKETS; digit++)
+                counts[digit + 1] += counts[digit];
+            for (size_t i = 0; i < count; i++)
+            {
+                size_t digit = ((uint32_t) builder->exps[idx[i] * builder->vars + var] >> shift) & (RADIX_BUCKETS - 1);
+                temp[counts[digit]++] = idx[i];
+            }
+            size_t *swap = idx;
+            idx = temp;
+            temp = swap;
+        }
+    }
+    free(counts);
+    return idx;
 }
 
-void PolyPrint(Poly *p)
+Poly PolyBuilderFinish(PolyBuilder *builder)
 {
-    if (PolyIsCoeff(p))
+    size_t count = builder->count;
+    size_t vars = builder->vars;
+    size_t *idx = malloc((count > 0 ? count : 1) * sizeof(size_t));
+    size_t *temp = malloc((count > 0 ? count : 1) * sizeof(size_t));
+    CHECK_PTR(idx);
+    CHECK_PTR(temp);
+    size_t *sorted = TermsSort(builder, idx, temp);
+
+    //składniki o równych wektorach wykładników są sąsiednie, więc sumujemy je w pierwszym z nich
+    TermRows rows = {.exps = builder->exps, .width = vars, .count = count, .capacity = count};
+    rows.coeffs = malloc((count > 0 ? count : 1) * sizeof(Poly));
+    RowRef *refs = malloc((count > 0 ? count : 1) * sizeof(RowRef));
+    CHECK_PTR(rows.coeffs);
+    CHECK_PTR(refs);
+    size_t used = 0;
+    size_t begin = 0;
+    while (begin < count)
     {
-        printf("%ld", p->coeff);
-    } else
-    {
-        for (size_t i = 0; i < p->size; i++)
+        size_t row = sorted[begin];
+        const poly_exp_t *exps = builder->exps + row * vars;
+        uint64_t sum = (uint64_t) builder->coeffs[row];
+        size_t end = begin + 1;
+        while (end < count && memcmp(builder->exps + sorted[end] * vars, exps, vars * sizeof(poly_exp_t)) == 0)
+            sum += (uint64_t) builder->coeffs[sorted[end++]];
+        if (sum != 0)
         {
-            MonoPrint(&(p->arr[i]));
-            if (i < p->size - 1)
-                printf("+");
+            rows.coeffs[row] = PolyFromCoeff((poly_coeff_t) sum);
+            refs[used++] = (RowRef) {.group = 0, .key = 0, .row = row};
         }
+        begin = end;
+    }
+    free(idx);
+    free(temp);
+
+    Poly res = PolyZero();
+    if (used > 0)
+    {
+        size_t *order = malloc((vars > 0 ? vars : 1) * sizeof(size_t));
+        CHECK_PTR(order);
+        for (size_t var = 0; var < vars; var++)
+            order[var] = var;
+        res = RowsBuild(&rows, refs, 0, used, 0, order, vars);
+        free(order);
     }
+    free(refs);
+    free(rows.coeffs);
+    builder->count = 0;
+    return res;
+}
+
+void PolyBuilderDestroy(PolyBuilder *builder)
+{
+    free(builder->exps);
+    free(builder->coeffs);
 }
 
 /**
- * Wykonuje szybkie potęgowanie wielomianu.
- * @param[in] p : podstawa - wielomian
- * @param[in] exp : wykładnik
- * @return @f$p^exp@f$
+ * Wkłada na stos przeglądania poziom wielomianu niestałego, powiększając w razie potrzeby stos.
+ * @param[in,out] it : stan przeglądania
+ * @param[in] p : wielomian niestały
  */
-static Poly PolyQuickPow(const Poly *p, poly_exp_t exp)
+static void TermIterPush(PolyTermIter *it, const Poly *p)
 {
-    Poly res = PolyFromCoeff(1);
-    Poly q = PolyClone(p);
-    while (exp > 0)
+    if (it->count == it->capacity)
     {
-        if (exp % 2 == 1)
+        it->capacity *= 2;
+        if (it->frames == it->inline_frames)
         {
-            Poly temp = PolyMul(&res, &q);
-            PolyDestroy(&res);
-            res = temp;
+            it->frames = malloc(it->capacity * sizeof(PolyTermFrame));
+            CHECK_PTR(it->frames);
+            memcpy(it->frames, it->inline_frames, sizeof(it->inline_frames));
+        } else
+        {
+            it->frames = realloc(it->frames, it->capacity * sizeof(PolyTermFrame));
+            CHECK_PTR(it->frames);
         }
-        Poly temp = PolyMul(&q, &q);
-        PolyDestroy(&q);
-        q = temp;
-        exp /= 2;
     }
-    PolyDestroy(&q);
-    return res;
+    it->frames[it->count++] = (PolyTermFrame) {.poly = p, .index = 0, .exp = 0};
 }
 
 /**
- * Funkcja rekurencyjna, wykonuje operację składania wielomianów. jeśli @p p jest wielomianem stałym, zwraca jego kopię.
- * W przeciwnym razie tworzy wielomian wyjściowy i dla wszystkich elementów w tablicy jednomianów:
- * wywołuje się dla wielomianu tego jednomianu, przekazując stopień zagłębienia o jeden większy,
- * potęguje q[depth] do potęgi tego jednomianu (lub jeśli k jest mniejsze od stopnia, to wynik potęgowania jest zerem),
- * mnoży wynik rekurencji i potęgowania i wynik mnożenia dodaje do wielomianu wyjściowego.
- *
- * @param[in] p : wielomian, do którego podstawiamy wieomiany z tablicy q
- * @param[in] k : liczba wielomianóœ w tablicy q
- * @param[in] q : tablica wielomianów
- * @param[in] depth : stopień zagłębienia w wielomianie p
- * @return złożenie wielomianów
+ * Ustawia przeglądanie na pierwszy składnik, nie zwalniając stosu.
+ * @param[in,out] it : stan przeglądania
  */
-static Poly PolyComposeHelp(const Poly *p, size_t k, const Poly q[], size_t depth)
+static void TermIterReset(PolyTermIter *it)
 {
-    if (PolyIsCoeff(p))
-        return PolyClone(p);
+    it->count = 0;
+    it->depth = 0;
+    it->pending_coeff = false;
+    if (!PolyIsCoeff(it->root))
+        TermIterPush(it, it->root);
+    else
+        it->pending_coeff = !PolyIsZero(it->root);
+}
 
-    Poly res = PolyZero();
-    for (size_t i = 0; i < p->size; i++)
+void PolyTermIterInit(PolyTermIter *it, const Poly *p)
+{
+    it->root = p;
+    it->frames = it->inline_frames;
+    it->capacity = POLY_TERM_ITER_INLINE_DEPTH;
+    TermIterReset(it);
+}
+
+bool PolyTermIterNext(PolyTermIter *it, poly_coeff_t *coeff)
+{
+    if (it->pending_coeff)
     {
-        Poly deep_result = PolyComposeHelp(&(p->arr[i].p), k, q, depth + 1);
-        Poly power_result;
-        if (k == 0 || depth >= k)
+        it->pending_coeff = false;
+        it->depth = 0;
+        *coeff = it->root->coeff;
+        return true;
+    }
+    while (it->count > 0)
+    {
+        PolyTermFrame *top = &it->frames[it->count - 1];
+        const Poly *p = top->poly;
+        if (top->index == (IsInlineMono(p) ? 1 : p->size))
         {
-            Poly temp = PolyZero();
-            //nie można zrobić power_result=PolyZero, bo jeśli exp=0, to wtedy powinien być wielomian stały 1
-            power_result = PolyQuickPow(&temp, p->arr[i].exp);
-        } else
-            power_result = PolyQuickPow(&(q[depth]), p->arr[i].exp);
-        Poly current_index_res = PolyMul(&deep_result, &power_result);
-        Poly add_result = PolyAdd(&res, &current_index_res);
-        PolyDestroy(&power_result);
-        PolyDestroy(&res);
-        PolyDestroy(&deep_result);
-        PolyDestroy(&current_index_res);
-        res = add_result;
+            it->count--;
+            if (it->count > 0)
+                it->frames[it->count - 1].index++;
+            continue;
+        }
+        if (IsInlineMono(p))
+        {
+            top->exp = InlineExp(p);
+            top->index++;
+            it->depth = it->count;
+            *coeff = p->coeff;
+            return true;
+        }
+        const Poly *child = &Coeffs(p)[top->index];
+        top->exp = Exps(p)[top->index];
+        if (!PolyIsCoeff(child))
+        {
+            TermIterPush(it, child); //po powrocie z poziomu niżej rodzic przejdzie do kolejnego jednomianu
+            continue;
+        }
+        top->index++;
+        if (PolyIsZero(child))
+            continue;
+        it->depth = it->count;
+        *coeff = child->coeff;
+        return true;
     }
-    return res;
+    return false;
 }
 
-Poly PolyCompose(const Poly *p, size_t k, const Poly q[])
+poly_exp_t PolyTermIterExp(const PolyTermIter *it, size_t var_idx)
 {
-    return PolyComposeHelp(p, k, q, 0);
+    return var_idx < it->depth ? it->frames[var_idx].exp : 0;
+}
+
+size_t PolyTermIterDepth(const PolyTermIter *it)
+{
+    return it->depth;
+}
+
+bool PolyTermIterSeek(PolyTermIter *it, size_t k, const poly_exp_t prefix[])
+{
+    TermIterReset(it);
+    if (it->pending_coeff)
+    {
+        for (size_t i = 0; i < k; i++)
+            it->pending_coeff = it->pending_coeff && prefix[i] <= 0;
+        return it->pending_coeff;
+    }
+    for (size_t depth = 0; depth < k && it->count > 0; depth++)
+    {
+        PolyTermFrame *top = &it->frames[it->count - 1];
+        NodeView view;
+        ViewInit(&view, top->poly);
+        //pierwszy jednomian o wykładniku nie mniejszym niż prefix[depth]
+        size_t lo = 0;
+        size_t hi = view.size;
+        while (lo < hi)
+        {
+            size_t mid = lo + (hi - lo) / 2;
+            if (view.exps[mid] < prefix[depth])
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        top->index = lo;
+        if (lo == view.size || view.exps[lo] > prefix[depth])
+            return false;
+        top->exp = view.exps[lo];
+        if (!PolyIsCoeff(&view.coeffs[lo])) //jednomian w miejscu ma stały współczynnik, więc to węzeł
+        {
+            TermIterPush(it, &Coeffs(top->poly)[lo]);
+            continue;
+        }
+        //stały współczynnik to składnik o zerowych wykładnikach dalszych zmiennych
+        bool matches = !PolyIsZero(&view.coeffs[lo]);
+        for (size_t i = depth + 1; i < k && matches; i++)
+            matches = prefix[i] <= 0;
+        if (!matches)
+            top->index++;
+        return matches;
+    }
+    return it->count > 0;
 }
 
+void PolyTermIterDestroy(PolyTermIter *it)
+{
+    if (it->frames != it->inline_frames)
+        free(it->frames);
+    it->frames = it->inline_frames;
+}
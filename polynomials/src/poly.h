@@ -12,6 +12,8 @@
 #include <assert.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
 
 /** To jest typ reprezentujący współczynniki. */
 typedef long poly_coeff_t;
@@ -37,7 +39,13 @@ typedef struct Poly {
         poly_coeff_t coeff; ///< współczynnik
         size_t size; ///< rozmiar wielomianu, liczba jednomianów
     };
-    /** To jest tablica przechowująca listę jednomianów. */
+    /**
+     * To jest wskaźnik na węzeł przechowujący listę jednomianów. Węzeł jest wewnętrzną
+     * strukturą biblioteki (osobne tablice współczynników i wykładników), więc poza
+     * porównaniem z `NULL` nie należy odwoływać się do niego bezpośrednio.
+     * Jednomian @f$cx_i^n@f$ ze stałym współczynnikiem @f$c@f$ i @f$n > 0@f$ nie ma węzła:
+     * `coeff` przechowuje wtedy @f$c@f$, a `arr` – zakodowany wykładnik.
+     */
     struct Mono *arr;
 } Poly;
 
@@ -116,6 +124,24 @@ static inline bool PolyIsZero(const Poly *p) {
  */
 void PolyDestroy(Poly *p);
 
+/**
+ * Usuwa wielomian jak PolyDestroy, ale nie zwalnia od razu dużego drzewa, które straciło
+ * ostatnią referencję. Drzewo jest duże, gdy jego niewspółdzielone węzły zajmują co najmniej
+ * @p min_bytes bajtów. Jeśli rozmiar drzewa nie jest jeszcze znany, węzły są zliczane tylko
+ * do osiągnięcia progu, więc sprawdzenie nie kosztuje więcej niż zwolnienie małego drzewa.
+ * Takie drzewo trzeba potem zwolnić przez PolyDestroyReleased, także w innym wątku.
+ * @param[in] p : wielomian
+ * @param[in] min_bytes : najmniejszy rozmiar drzewa, którego zwolnienie jest odkładane
+ * @return Czy zwolnienie drzewa zostało odłożone?
+ */
+bool PolyReleaseLarge(Poly *p, size_t min_bytes);
+
+/**
+ * Zwalnia drzewo wielomianu, dla którego PolyReleaseLarge zwróciła @c true.
+ * @param[in] p : wielomian
+ */
+void PolyDestroyReleased(Poly *p);
+
 /**
  * Usuwa jednomian z pamięci.
  * @param[in] m : jednomian
@@ -131,6 +157,15 @@ static inline void MonoDestroy(Mono *m) {
  */
 Poly PolyClone(const Poly *p);
 
+/**
+ * Robi płytką, współdzieloną kopię wielomianu w czasie stałym.
+ * Wielomiany nie są modyfikowane po utworzeniu, więc kopia zachowuje się jak pełna kopia:
+ * każdą z nich trzeba usunąć przez PolyDestroy, a pamięć jest zwalniana przy usunięciu ostatniej.
+ * @param[in] p : wielomian
+ * @return współdzielona kopia wielomianu
+ */
+Poly PolyShare(const Poly *p);
+
 /**
  * Robi pełną, głęboką kopię jednomianu.
  * @param[in] m : jednomian
@@ -216,19 +251,76 @@ poly_exp_t PolyDegBy(const Poly *p, size_t var_idx);
 
 /**
  * Zwraca stopień wielomianu (-1 dla wielomianu tożsamościowo równego zeru).
+ * Stopień jest zapamiętywany w wielomianie, więc kolejne wywołania działają w czasie stałym.
  * @param[in] p : wielomian
  * @return stopień wielomianu @p p
  */
 poly_exp_t PolyDeg(const Poly *p);
 
+/**
+ * Zwraca skrót strukturalny wielomianu. Równe wielomiany mają równe skróty.
+ * Skrót jest zapamiętywany w wielomianie, więc kolejne wywołania działają w czasie stałym.
+ * @param[in] p : wielomian
+ * @return skrót wielomianu @p p
+ */
+uint64_t PolyHash(const Poly *p);
+
+/**
+ * Miesza bity liczby (funkcja kończąca generatora splitmix64). Służy do budowania skrótów
+ * wielomianów i kluczy tablic haszujących z nich korzystających.
+ * @param[in] x : liczba
+ * @return wymieszana liczba
+ */
+static inline uint64_t PolyHashMix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+/**
+ * Zwraca liczbę niezerowych jednomianów wielomianu zapisanego w postaci rozwiniętej
+ * (sumy iloczynów potęg wszystkich zmiennych). Wynik jest ograniczony przez SIZE_MAX.
+ * @param[in] p : wielomian
+ * @return liczba jednomianów wielomianu @p p
+ */
+size_t PolyTerms(const Poly *p);
+
+/**
+ * Zwraca liczbę bajtów pamięci zajmowanej przez węzły wielomianu
+ * (0 dla wielomianu stałego). Wynik jest ograniczony przez SIZE_MAX.
+ * @param[in] p : wielomian
+ * @return rozmiar wielomianu @p p w bajtach
+ */
+size_t PolyMemory(const Poly *p);
+
 /**
  * Sprawdza równość dwóch wielomianów.
+ * Wielomiany o różnych skrótach są odrzucane bez przeglądania ich jednomianów.
  * @param[in] p : wielomian @f$p@f$
  * @param[in] q : wielomian @f$q@f$
  * @return @f$p = q@f$
  */
 bool PolyIsEq(const Poly *p, const Poly *q);
 
+/**
+ * Sprawdza probabilistycznie, czy @f$p * q = r@f$, bez wyznaczania iloczynu.
+ * Porównuje wartości obu stron w kilku pseudolosowych punktach, licząc jednocześnie modulo
+ * @f$2^{64}@f$ (tak jak są liczone współczynniki) i w ciele modulo @f$2^{61} - 1@f$, w którym
+ * prawdopodobieństwo pomyłki dla różnych wielomianów stopnia @f$d@f$ nie przekracza
+ * @f$d / (2^{61} - 1)@f$ w każdym punkcie. Każda strona jest wyliczana jednym przejściem po
+ * wielomianach. Jeśli obie wartości się nie zgadzają, wynik jest fałszem; jeśli zgadzają się tylko
+ * modulo @f$2^{64}@f$ (iloczyn przepełnił współczynniki), iloczyn jest wyznaczany i porównywany
+ * dokładnie. Wynik fałsz jest zawsze poprawny, wynik prawda jest poprawny z dużym prawdopodobieństwem.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @param[in] r : wielomian @f$r@f$
+ * @return Czy @f$p * q = r@f$?
+ */
+bool PolyIsEqMul(const Poly *p, const Poly *q, const Poly *r);
+
 /**
  * Wylicza wartość wielomianu w punkcie @p x.
  * Wstawia pod pierwszą zmienną wielomianu wartość @p x.
@@ -250,6 +342,112 @@ Poly PolyAt(const Poly *p, poly_coeff_t x);
  */
 void PolyPrint(Poly *p);
 
+struct PolyWriterFrame;
+
+/**
+ * To jest struktura opisująca bufor, do którego są formatowane wielomiany przed zapisaniem
+ * ich do pliku. Bufor i stos przejścia po drzewie wielomianu są wielokrotnego użytku.
+ */
+typedef struct PolyWriter {
+    FILE *out;                      ///< plik docelowy
+    char *buf;                      ///< bufor
+    size_t used;                    ///< liczba zajętych bajtów bufora
+    size_t size;                    ///< rozmiar bufora
+    struct PolyWriterFrame *frames; ///< stos przejścia po drzewie wielomianu
+    size_t frames_size;             ///< rozmiar stosu przejścia
+} PolyWriter;
+
+/**
+ * Tworzy bufor zapisujący do pliku @p out.
+ * @param[in] writer : bufor
+ * @param[in] out : plik docelowy
+ */
+void PolyWriterInit(PolyWriter *writer, FILE *out);
+
+/**
+ * Formatuje wielomian do bufora w takiej samej postaci jak PolyPrint.
+ * Zapisuje bufor do pliku tylko wtedy, gdy się zapełni.
+ * @param[in] writer : bufor
+ * @param[in] p : wielomian
+ */
+void PolyWrite(PolyWriter *writer, const Poly *p);
+
+/**
+ * Dopisuje znak do bufora.
+ * @param[in] writer : bufor
+ * @param[in] c : znak
+ */
+void PolyWriterPutChar(PolyWriter *writer, char c);
+
+/**
+ * Zapisuje zawartość bufora do pliku (jednym wywołaniem fwrite) i opróżnia bufor.
+ * @param[in] writer : bufor
+ */
+void PolyWriterFlush(PolyWriter *writer);
+
+/**
+ * Zapisuje zawartość bufora do pliku i zwalnia pamięć bufora.
+ * @param[in] writer : bufor
+ */
+void PolyWriterDestroy(PolyWriter *writer);
+
+/**
+ * Zapisuje wielomian do bufora w zwartej postaci binarnej. Liczby jednomianów, różnice
+ * kolejnych wykładników i współczynniki są zapisywane w kodowaniu o zmiennej długości.
+ * @param[in] writer : bufor
+ * @param[in] p : wielomian
+ */
+void PolyWriteBinary(PolyWriter *writer, const Poly *p);
+
+/**
+ * Odczytuje wielomian zapisany przez PolyWriteBinary z początku danych @p data.
+ * Dane opisujące wielomian w postaci niekanonicznej (z zerowym współczynnikiem albo z węzłem,
+ * którego jedynym jednomianem jest stała przy wykładniku 0) są odrzucane.
+ * @param[in] data : dane
+ * @param[in] size : liczba bajtów danych
+ * @param[out] p : odczytany wielomian
+ * @return liczba odczytanych bajtów albo 0, jeśli dane nie zaczynają się poprawnym wielomianem
+ */
+size_t PolyReadBinary(const void *data, size_t size, Poly *p);
+
+/**
+ * Przenosi kopię wielomianu do jednego ciągłego bloku pamięci, w którym węzły
+ * leżą w kolejności preorder, więc przeglądanie wielomianu (np. PolyAt, PolyDeg, PolyIsEq,
+ * PolyPrint) odwołuje się do kolejnych adresów. Zamrożony wielomian jest używany we wszystkich
+ * operacjach jak każdy inny. Wyniki operacji są tworzone poza blokiem, a współdzielone z nimi
+ * fragmenty bloku przedłużają jego życie, więc blok jest zwalniany w całości, gdy nic go już
+ * nie wskazuje. Jeśli wielomian jest już zamrożony albo nie starcza pamięci, daje jego kopię.
+ * @param[in] p : wielomian
+ * @return zamrożony wielomian
+ */
+Poly PolyFreeze(const Poly *p);
+
+/**
+ * Zapisuje do pliku obraz wielomianu, który po odwzorowaniu w pamięci można używać
+ * bez dekodowania (PolyFromImage). Obraz nie zawiera wskaźników, tylko przesunięcia,
+ * więc może być odwzorowany pod dowolnym adresem i współdzielony przez wiele procesów.
+ * @param[in] out : plik
+ * @param[in] p : wielomian
+ * @return Czy zapis się udał?
+ */
+bool PolyWriteImage(FILE *out, const Poly *p);
+
+/**
+ * Daje wielomian leżący w obrazie zapisanym przez PolyWriteImage, bez kopiowania go.
+ * Obraz może leżeć w pamięci tylko do odczytu i musi być wyrównany do 8 bajtów. Wielomianu
+ * można używać we wszystkich operacjach jak każdego innego, dopóki obraz jest w pamięci;
+ * PolyDestroy i PolyShare nie zmieniają obrazu, a PolyClone tworzy zwykłą kopię na stercie.
+ * Przed udostępnieniem wielomianu całe drzewo jest raz przeglądane: każdy węzeł musi leżeć
+ * w obrazie tam, gdzie umieszcza go PolyWriteImage, mieć niezerową liczbę jednomianów,
+ * rosnące wykładniki, zgodne metadane i postać kanoniczną (bez zerowych współczynników i bez
+ * węzłów z jednym stałym współczynnikiem), więc uszkodzony obraz jest odrzucany.
+ * @param[in] image : obraz
+ * @param[in] size : rozmiar obrazu w bajtach
+ * @param[out] p : wielomian
+ * @return Czy obraz jest poprawny?
+ */
+bool PolyFromImage(const void *image, size_t size, Poly *p);
+
 /**
  * Wykonuje operację składania wielomianów.
  * Wynikiem złożenia jest wielomian @f$p(q[0],q[1],q[2],…)@f$, czyli wielomian powstający przez podstawienie w wielomianie @f$p@f$ pod zmienną @f$x_i@f$ wielomianu
@@ -261,4 +459,195 @@ void PolyPrint(Poly *p);
  */
 Poly PolyCompose(const Poly *p, size_t k, const Poly q[]);
 
+/**
+ * Daje liczbę zmiennych, od których zależy postać wielomianu, czyli głębokość drzewa
+ * jego reprezentacji (0 dla wielomianu stałego).
+ * @param[in] p : wielomian
+ * @return liczba zmiennych
+ */
+size_t PolyVarCount(const Poly *p);
+
+/**
+ * Przenumerowuje zmienne wielomianu: zmienna @f$x_i@f$ staje się zmienną @f$x_{perm[i]}@f$
+ * dla @f$i=0,1,…,k-1@f$, a zmienne @f$x_k, x_{k+1}, …@f$ nie zmieniają się.
+ * Współczynniki leżące na głębokości @p k są współdzielone z @p p.
+ * @param[in] p : wielomian
+ * @param[in] k : liczba przenumerowywanych zmiennych
+ * @param[in] perm : permutacja liczb @f$0,1,…,k-1@f$
+ * @return wielomian po przenumerowaniu zmiennych
+ */
+Poly PolyPermuteVars(const Poly *p, size_t k, const size_t perm[]);
+
+/**
+ * Szacuje rozmiar wielomianu po przenumerowaniu zmiennych (PolyPermuteVars) bez tworzenia go:
+ * daje liczbę jednomianów w węzłach na głębokościach, na które trafiają przenumerowane zmienne.
+ * Głębsze węzły nie zależą od permutacji.
+ * @param[in] p : wielomian
+ * @param[in] k : liczba przenumerowywanych zmiennych
+ * @param[in] perm : permutacja liczb @f$0,1,…,k-1@f$
+ * @return liczba jednomianów
+ */
+size_t PolyOrderCost(const Poly *p, size_t k, const size_t perm[]);
+
+/**
+ * Dobiera zachłannie permutację zmiennych @f$x_0, …, x_{k-1}@f$ zmniejszającą rozmiar wielomianu:
+ * na kolejne głębokości trafia zmienna, dla której najmniej jest różnych wykładników zmiennych
+ * z dotąd wybranych głębokości (PolyOrderCost). Przy równych kosztach zachowuje pierwotną
+ * kolejność, a zmienne, od których wielomian nie zależy, zostawia na miejscu.
+ * @param[in] p : wielomian
+ * @param[in] k : liczba przenumerowywanych zmiennych
+ * @param[out] perm : permutacja dla PolyPermuteVars
+ */
+void PolyBestVarOrder(const Poly *p, size_t k, size_t perm[]);
+
+/**
+ * Podstawia wartości pod wybrane zmienne wielomianu w jednym przejściu: pod zmienną @f$x_i@f$
+ * podstawia @f$values[i]@f$ dla każdego @f$i<k@f$, dla którego @f$mask[i]@f$ jest prawdą.
+ * W odróżnieniu od PolyAt nie przenumerowuje pozostałych zmiennych. Potęgi wartości są
+ * wyliczane raz, a poddrzewa bez podstawianych zmiennych są współdzielone z @p p.
+ * @param[in] p : wielomian
+ * @param[in] k : liczba elementów tablic @p mask i @p values
+ * @param[in] mask : które zmienne są podstawiane
+ * @param[in] values : wartości zmiennych (pozostałe elementy nie są czytane)
+ * @return wielomian po podstawieniu
+ */
+Poly PolyPartialEval(const Poly *p, size_t k, const bool mask[], const poly_coeff_t values[]);
+
+/**
+ * Wylicza w jednym przejściu wielomianu, bez alokacji pamięci, jego wartość i wszystkie
+ * pochodne cząstkowe w punkcie @f$(xs[0], …, xs[k-1], 0, 0, …)@f$ (zmienne @f$x_k, x_{k+1}, …@f$
+ * są równe 0). Obliczenia są prowadzone modulo @f$2^{64}@f$, tak jak w PolyAt.
+ * @param[in] p : wielomian
+ * @param[in] k : liczba zmiennych o zadanych wartościach
+ * @param[in] xs : wartości zmiennych @f$x_0, …, x_{k-1}@f$
+ * @param[out] out_value : wartość wielomianu
+ * @param[out] out_grad : pochodne cząstkowe względem zmiennych @f$x_0, …, x_{k-1}@f$
+ */
+void PolyEvalGrad(const Poly *p, size_t k, const poly_coeff_t xs[], poly_coeff_t *out_value,
+                  poly_coeff_t out_grad[]);
+
+/**
+ * To jest struktura zbierająca składniki wielomianu (wektor wykładników i współczynnik)
+ * w dowolnej kolejności. Wielomian jest budowany z nich dopiero w PolyBuilderFinish.
+ */
+typedef struct PolyBuilder {
+    size_t vars;            ///< liczba zmiennych w wektorach wykładników
+    size_t count;           ///< liczba zebranych składników
+    size_t capacity;        ///< liczba składników, na które jest miejsce
+    poly_exp_t *exps;       ///< wektory wykładników, @p vars kolejnych na składnik
+    poly_coeff_t *coeffs;   ///< współczynniki składników
+} PolyBuilder;
+
+/**
+ * Tworzy pusty zbiór składników wielomianu zmiennych @f$x_0, …, x_{vars-1}@f$.
+ * @param[in] builder : zbiór składników
+ * @param[in] vars : liczba zmiennych
+ */
+void PolyBuilderInit(PolyBuilder *builder, size_t vars);
+
+/**
+ * Dodaje składnik @f$coeff \cdot x_0^{exps[0]} \cdots x_{vars-1}^{exps[vars-1]}@f$.
+ * Składniki o równych wektorach wykładników są sumowane.
+ * @param[in] builder : zbiór składników
+ * @param[in] exps : nieujemne wykładniki zmiennych
+ * @param[in] coeff : współczynnik
+ */
+void PolyBuilderAddTerm(PolyBuilder *builder, const poly_exp_t exps[], poly_coeff_t coeff);
+
+/**
+ * Buduje wielomian będący sumą zebranych składników i opróżnia zbiór. Składniki są sortowane
+ * raz, leksykograficznie według wektorów wykładników (w czasie liniowym), a wielomian jest
+ * budowany od liści, bez dodawania wielomianów.
+ * @param[in] builder : zbiór składników
+ * @return wielomian
+ */
+Poly PolyBuilderFinish(PolyBuilder *builder);
+
+/**
+ * Zwalnia pamięć zbioru składników.
+ * @param[in] builder : zbiór składników
+ */
+void PolyBuilderDestroy(PolyBuilder *builder);
+
+/**
+ * To jest stała reprezentująca liczbę poziomów stosu PolyTermIter, które nie wymagają alokacji pamięci
+ */
+#define POLY_TERM_ITER_INLINE_DEPTH 16
+
+/**
+ * To jest struktura opisująca poziom stosu PolyTermIter.
+ */
+typedef struct PolyTermFrame {
+    const Poly *poly;   ///< wielomian niestały na tym poziomie
+    size_t index;       ///< numer następnego jednomianu do odwiedzenia
+    poly_exp_t exp;     ///< wykładnik ostatnio odwiedzonego jednomianu
+} PolyTermFrame;
+
+/**
+ * To jest struktura opisująca przeglądanie składników wielomianu (wektor wykładników
+ * i współczynnik) w kolejności leksykograficznej wektorów wykładników. Stan przeglądania
+ * to jawny stos poziomów drzewa wielomianu, który dla wielomianów co najwyżej
+ * POLY_TERM_ITER_INLINE_DEPTH zmiennych leży w samej strukturze, więc przeglądanie nie alokuje
+ * pamięci. Struktury nie wolno kopiować, a wielomianu nie wolno zmieniać ani usuwać
+ * w trakcie przeglądania.
+ */
+typedef struct PolyTermIter {
+    const Poly *root;           ///< przeglądany wielomian
+    PolyTermFrame *frames;      ///< stos poziomów
+    size_t count;               ///< liczba poziomów na stosie
+    size_t capacity;            ///< rozmiar stosu
+    size_t depth;               ///< liczba poziomów, na których leżą wykładniki bieżącego składnika
+    bool pending_coeff;         ///< czy wielomian jest stały i jeszcze go nie zwrócono
+    PolyTermFrame inline_frames[POLY_TERM_ITER_INLINE_DEPTH]; ///< stos poziomów bez alokacji
+} PolyTermIter;
+
+/**
+ * Rozpoczyna przeglądanie składników wielomianu od pierwszego.
+ * @param[out] it : stan przeglądania
+ * @param[in] p : wielomian
+ */
+void PolyTermIterInit(PolyTermIter *it, const Poly *p);
+
+/**
+ * Przechodzi do następnego składnika. Jednomiany o zerowych współczynnikach są pomijane.
+ * @param[in,out] it : stan przeglądania
+ * @param[out] coeff : współczynnik składnika
+ * @return Czy był jeszcze jakiś składnik?
+ */
+bool PolyTermIterNext(PolyTermIter *it, poly_coeff_t *coeff);
+
+/**
+ * Daje wykładnik zmiennej @f$x_{var\_idx}@f$ w składniku zwróconym przez ostatnie wywołanie
+ * PolyTermIterNext.
+ * @param[in] it : stan przeglądania
+ * @param[in] var_idx : numer zmiennej
+ * @return wykładnik
+ */
+poly_exp_t PolyTermIterExp(const PolyTermIter *it, size_t var_idx);
+
+/**
+ * Daje liczbę zmiennych @f$x_0, …, x_{n-1}@f$, których wykładniki w bieżącym składniku mogą
+ * być niezerowe; wykładniki pozostałych zmiennych są równe 0.
+ * @param[in] it : stan przeglądania
+ * @return liczba zmiennych
+ */
+size_t PolyTermIterDepth(const PolyTermIter *it);
+
+/**
+ * Ustawia przeglądanie tak, aby PolyTermIterNext dał pierwszy składnik, którego wykładniki
+ * zmiennych @f$x_0, …, x_{k-1}@f$ są leksykograficznie nie mniejsze niż @p prefix.
+ * Schodzi w drzewie tylko wzdłuż przedrostka, wyszukując wykładniki binarnie.
+ * @param[in,out] it : stan przeglądania
+ * @param[in] k : długość przedrostka
+ * @param[in] prefix : wykładniki zmiennych @f$x_0, …, x_{k-1}@f$
+ * @return Czy następny składnik ma dokładnie taki przedrostek?
+ */
+bool PolyTermIterSeek(PolyTermIter *it, size_t k, const poly_exp_t prefix[]);
+
+/**
+ * Kończy przeglądanie (także przed ostatnim składnikiem) i zwalnia pamięć stosu.
+ * @param[in] it : stan przeglądania
+ */
+void PolyTermIterDestroy(PolyTermIter *it);
+
 #endif /* __POLY_H__ */
@@ -1,416 +1,254 @@
 /** @file
  Implementacja parsera wielomianów
 
+ Wielomian jest wczytywany w jednym przejściu metodą zejść rekurencyjnych według gramatyki:
+ @verbatim
+ wielomian  ::= współczynnik | jednomian { '+' jednomian }
+ jednomian  ::= '(' ( współczynnik | suma ) ',' wykładnik ')'
+ suma       ::= jednomian { '+' jednomian }
+ @endverbatim
+ Poprawność wiersza jest sprawdzana w trakcie wczytywania, a liczby są wczytywane bez strtol.
+
  @author Julia Karmowska
  @date 2021
 */
 
-#include <ctype.h>
 #include <limits.h>
-#include <errno.h>
 #include "poly_parser.h"
 #include "memory.h"
 
 /**
- * Zwiększa rozmiar tablicy.
- * @param[in] n rozmiar
- * @return @f$ 1 + 2 * n @f$
+ * To jest stała oznaczająca brak kolejnego znaku w wierszu
  */
-static size_t increase_size(size_t n)
-{
-    if (n == SIZE_MAX) //SIZE_MAX może zostać osiągnięty, bo n = 2^m - 1
-        exit(1); //jeśli zostanie osiągnięty, to nie możemy już zwiększyć rozmiaru
-    return 1 + 2 * n;
-}
+#define END_OF_LINE (-1)
 
 /**
- * Sprawdza, czy na początku tablicy znaków jaest poprawna liczba typu long.
- * @param[in] line : tablica znaków
- * @param[in] end : pierwszy znak za ostatnim wczytanym
- * @param[in] value : wczytana liczba
- * @return Czy na początku tablicy znaków jaest poprawna liczba typu long?
+ * Struktura opisująca pozycję w wczytywanym wierszu.
  */
-static bool isLong(char *line, char **end, poly_coeff_t *value)
+typedef struct Lexer {
+    const char *pos;    ///< pierwszy niewczytany znak
+    const char *end;    ///< koniec wiersza (bez końcowego znaku '\n')
+} Lexer;
+
+/**
+ * Zwraca kolejny znak wiersza, nie wczytując go.
+ * @param[in] lexer : pozycja w wierszu
+ * @return kolejny znak albo END_OF_LINE
+ */
+static inline int Peek(const Lexer *lexer)
 {
-    if (line[0] == '\n' || line[0] == '\0')
-        return false;
-    long number;
-    errno = 0;
-    number = strtol(line, end, 10);
-    if (errno != 0)
-        return false;
-    *value = number;
-    return true;
+    return lexer->pos < lexer->end ? (unsigned char) *lexer->pos : END_OF_LINE;
 }
 
 /**
- * Sprawdza, czy na początku tablicy znaków jaest poprawna liczba typu unsigned long.
- * @param[in] line : tablica znaków
- * @param[in] end : pierwszy znak za ostatnim wczytanym
- * @param[in] value : wczytana liczba
- * @return Czy na początku tablicy znaków jaest poprawna liczba typu unsigned long?
+ * Wczytuje znak @p c, jeśli jest kolejnym znakiem wiersza.
+ * @param[in] lexer : pozycja w wierszu
+ * @param[in] c : oczekiwany znak
+ * @return Czy wczytano znak @p c?
  */
-static bool isUnsignedLong(char *line, char **end, unsigned long *value)
+static inline bool Expect(Lexer *lexer, char c)
 {
-    if (line[0] == '\n' || line[0] == '\0')
-        return false;
-    unsigned long long number;
-    errno = 0;
-    number = strtoull(line, end, 10);
-    if (errno != 0)
+    if (Peek(lexer) != c)
         return false;
-
-    *value = number;
+    lexer->pos++;
     return true;
 }
 
 /**
- * Sprawdza, czy na początku tablicy znaków jest poprawny współczynnik wielomianu
- * (typ long, niepoprzedzony zankiem plus), po którym stoi przecinek. Jeśli tak, zapamiętuje wartość współczynnika.
- * @param[in] line : wiersz, tablica znaków
- * @param[in] coeff : wczytany współczynnik
- * @param[in] end : pierwszy znak, który nie został wczytany
- * @return Czy na początku @p line jest poprawny współczynnik wielomianu?
+ * Wczytuje liczbę całkowitą zapisaną dziesiętnie, opcjonalnie poprzedzoną znakiem @f$-@f$.
+ * Wartość bezwzględna nie może przekraczać UINT64_MAX.
+ * @param[in] lexer : pozycja w wierszu
+ * @param[out] negative : czy liczba była poprzedzona znakiem @f$-@f$
+ * @param[out] magnitude : wartość bezwzględna liczby
+ * @return Czy wczytano poprawną liczbę?
  */
-static bool isCoeffPoly(char *line, poly_coeff_t *coeff, char **end)
+static bool ParseNumber(Lexer *lexer, bool *negative, uint64_t *magnitude)
 {
-    if (line[0] == '+')
+    *negative = Expect(lexer, '-');
+    if (Peek(lexer) < '0' || Peek(lexer) > '9')
         return false;
-
-    if (isLong(line, end, coeff))
+    uint64_t value = 0;
+    while (Peek(lexer) >= '0' && Peek(lexer) <= '9')
     {
-        if (**end != ',')
+        unsigned digit = *lexer->pos - '0';
+        if (value > (UINT64_MAX - digit) / 10)
             return false;
-        return true;
+        value = 10 * value + digit;
+        lexer->pos++;
     }
-    return false;
+    *magnitude = value;
+    return true;
 }
 
 /**
- * Sprawdza, czy na początku tablicy znaków jest poprawny wykładnik
- * (nieujemna liczba z zakresu int, niepoprzedzona zankiem plus), po którym stoi znak @f$)@f$.
- * Jeśli tak, zapamiętuje wartość wykładnika.
- * @param[in] line : wiersz, tablica znaków
- * @param[in] exp : wczytany wykładnik
- * @param[in] end : pierwszy znak, który nie został wczytany
- * @return Czy na początku @p line jest poprawny współczynnik wielomianu?
+ * Wczytuje współczynnik z zakresu typu poly_coeff_t.
+ * @param[in] lexer : pozycja w wierszu
+ * @param[out] coeff : wczytany współczynnik
+ * @return Czy wczytano poprawny współczynnik?
  */
-static bool isExpPoly(char *line, poly_exp_t *exp, char **end)
+static bool ParseCoeff(Lexer *lexer, poly_coeff_t *coeff)
 {
-    if (line[0] == '+')
+    bool negative;
+    uint64_t magnitude;
+    if (!ParseNumber(lexer, &negative, &magnitude))
         return false;
-    unsigned long number;
-
-    if (isUnsignedLong(line, end, &number))
+    if (!negative)
     {
-        if (**end != ')')
-            return false;
-        if (number > INT_MAX)
+        if (magnitude > LONG_MAX)
             return false;
-        *exp = (int) number;
-        return true;
-    }
-    return false;
-}
-
-/**
- * Jeśli to koniecczne, zwiększa rozmiar tablicy jednomianów.
- * @param[in] monos tablica jednomianów
- * @param[in] size rozmiar tablicy
- * @param[in] length liczba jednoianów w tablicy
- */
-static void MaybeResizeMonos(Mono **monos, size_t *size, size_t length)
-{
-    if (length >= *size)
+        *coeff = (poly_coeff_t) magnitude;
+    } else
     {
-        *size = increase_size(*size);
-        *monos = realloc(*monos, (*size) * sizeof(Mono));
-        CHECK_PTR(*monos);
-    }
-
-}
-
-/**
- * Wczytuje jednomian postaci (coeff, exp), zapisuje go w tablicy jednomianów na najmniejszym wolnym indeksie.
- * Ustawia wskaźnik @p end na pierwsze miejsce w wierszu po wczytanym jednomianie.
- * @param[in] beg : początek wiersza, tablica znaków
- * @param[in] end : znak za ostatnim wczytanym
- * @param[in] monos : tablica jednomianów
- * @param[in] size : rozmiar tablicy
- * @param[in] used : liczba jednoianów w tablicy
- * @return  : Czy wczytano poprawny jednomian?
- */
-static bool GetMono(char *beg, char **end, Mono **monos, size_t *size, size_t *used)
-{//przed był '('
-    assert(isdigit(beg[0]) || beg[0] == '-');
-    poly_coeff_t coeff = 0;
-    poly_exp_t exp = 0;
-    if (isCoeffPoly(beg, &coeff, end))
-    { //teraz **end = ','
-        beg = *end + 1; //pierwszy znak po przecinku
-        if (isExpPoly(beg, &exp, end))
-        {   // **end = ')', jednomian jest poprawny
-            Poly poly = PolyFromCoeff(coeff);
-            MaybeResizeMonos(monos, size, *used);
-            if (!PolyIsZero(&poly))
-            {
-                (*monos)[*used] = MonoFromPoly(&poly, exp);
-                (*used)++;
-            }
-            (*end)++;
-            return true;
-        }
+        if (magnitude > (uint64_t) LONG_MAX + 1)
+            return false;
+        *coeff = magnitude == (uint64_t) LONG_MAX + 1 ? LONG_MIN : -(poly_coeff_t) magnitude;
     }
-    return false;
+    return true;
 }
 
 /**
- * Dodaje jednomian do tablicy
- * @param[in] monos : tablica jednomianów
- * @param[in] size : rozmiar tablicy
- * @param[in] count : liczba jednoianów w tablicy
- * @param[in] poly : wielomian
- * @param[in] exp : wykładnik
+ * Wczytuje wykładnik. Tak jak strtoull, liczbę poprzedzoną znakiem @f$-@f$ zamienia
+ * na jej wartość modulo @f$2^{64}@f$ (np. "-0" oznacza 0), a wynik musi mieścić się w typie int.
+ * @param[in] lexer : pozycja w wierszu
+ * @param[out] exp : wczytany wykładnik
+ * @return Czy wczytano poprawny wykładnik?
  */
-static void AddMono(Mono **monos, size_t *size, size_t *count, Poly poly, poly_exp_t exp)
+static bool ParseExp(Lexer *lexer, poly_exp_t *exp)
 {
-    MaybeResizeMonos(monos, size, *count);
-    if (PolyIsZero(&poly))
-        (*monos)[*count] = MonoFromPoly(&poly, 0);
-    else (*monos)[*count] = MonoFromPoly(&poly, exp);
-    (*count)++;
-}
-
-/**
- * Wczytuje sumę jednomianów do tablicy jednomianów.
- * @param[in] line : wiersz
- * @param[in] end : wskaźnik na ostatni wczytany znak
- * @param[in] monos : tablica jednomianów
- * @param[in] count : liczba wczytanych jednomianów
- * @param[in] size : rozmiar tablicy jednomianów
- * @param[in] limit : znak, którym powinna kończyć się wczytywana suma jednomianów
- * @return Czy udało się wczytać sumę jednomianów?
- */
-static bool GetMonos(char *line, char **end, Mono **monos, size_t *count, size_t *size, char limit);
-
-/**
- * Ustawia wskaźnik na dwa znaki po znaku '+', tak aby wskazywał na początek nowego jednomianu, po znaku '('.
- * Jeśli po znaku '+' jest niewłaściwa sekwencja, zwraca fałsz.
- * @param[in] beg : początek tablicy znaków
- * @return : Czy udało się wczytać znak '+' i początek nowego jednomianu jest poprawny?
- */
-static bool SkipPlusChar(char **beg)
-{
-    assert(**beg == '+');
-    if ((*beg)[1] != '(')
+    bool negative;
+    uint64_t magnitude;
+    if (!ParseNumber(lexer, &negative, &magnitude))
         return false;
-    else
-    {
-        *beg = *beg + 2;
-        if (!isdigit(**beg) && **beg != '(' &&
-            **beg != '-') //sprawdzamy to tutaj, bo jeśli byłoby '\n', to dalej błąd nie zostałby wykryty
-            return false;
-    }
+    if (negative)
+        magnitude = -magnitude;
+    if (magnitude > INT_MAX)
+        return false;
+    *exp = (poly_exp_t) magnitude;
     return true;
 }
 
 /**
- * Usuwa z pamięci wielomian i tablicę jednomianów.
- * @param[in] monos : tablica jednomianów
- * @param[in] size :rozmiar tablicy
+ * Struktura opisująca rosnącą tablicę jednomianów wczytywanej sumy.
  */
-static void DestroyMonos(Mono **monos, size_t size)
-{
-    for (size_t i = 0; i < size; i++)
-    {
-        MonoDestroy(&((*monos)[i]));
-    }
-    free(*monos);
-}
+typedef struct MonoList {
+    Mono *monos;    ///< jednomiany
+    size_t size;    ///< rozmiar tablicy
+    size_t used;    ///< liczba jednomianów w tablicy
+} MonoList;
 
 /**
- * Przesuwa wskaźniki o jeden znak do przodu
- * @param[in] beg pierwszy znak do wczytania
- * @param[in] end ostatni wczytany znak
+ * Dodaje jednomian na koniec listy.
+ * @param[in] list : lista
+ * @param[in] mono : jednomian
  */
-static void SkipOneChar(char **beg, char **end)
+static void MonoListPush(MonoList *list, Mono mono)
 {
-    (*end)++;
-    *beg = *end;
-
+    if (list->used == list->size)
+    {
+        if (list->size > SIZE_MAX / (2 * sizeof(Mono)))
+            exit(1);
+        list->size = list->size == 0 ? INITIAL_ARRAY_SIZE : 2 * list->size;
+        list->monos = realloc(list->monos, list->size * sizeof(Mono));
+        CHECK_PTR(list->monos);
+    }
+    list->monos[list->used++] = mono;
 }
 
 /**
- * Wczytauje wykładnik jednomianu, jeśli jest on poprawny
- * @param[in] end ostatni wczytany znak
- * @param[in] beg pierwszy znak do wczytania
- * @param[in] exp wykładnik
- * @return Czy udało się wczytać wykładnik?
+ * Usuwa z pamięci listę jednomianów razem z jednomianami.
+ * @param[in] list : lista
  */
-static bool GetExp(char **end, char **beg, poly_exp_t *exp)
+static void MonoListDestroy(MonoList *list)
 {
-    SkipOneChar(beg, end);
-    return isExpPoly(*beg, exp, end);
+    for (size_t i = 0; i < list->used; i++)
+        MonoDestroy(&list->monos[i]);
+    free(list->monos);
 }
 
+static bool ParseSum(Lexer *lexer, Poly *poly);
 
 /**
- * Wczytuje wnętrze nawiasu, czyli jednomian (element przed przecinkiem w nawiasie jest złożonym wielomianem),
- * ustawia wskaźnik @p end i @p beg na pierwszy znak po nawiasie zamykającym.
- * @param[in] beg : początek tablicy znaków
- * @param[in] end : ostatni wczytany znak
- * @param[in] monos : tablica jednomianów
- * @param[in] count : liczba jednomianów w tablicy
- * @param[in] size : rozmiar tablicy
- * @return : Czy zawartość nawiasu została poprawnie wczytana?
+ * Wczytuje jednomian i dodaje go do listy. Jednomiany o zerowym współczynniku
+ * stałym są pomijane.
+ * @param[in] lexer : pozycja w wierszu
+ * @param[in] list : lista jednomianów
+ * @return Czy wczytano poprawny jednomian?
  */
-static bool getBrackets(char **end, char **beg, Mono **monos, size_t *count, size_t *size)
+static bool ParseMono(Lexer *lexer, MonoList *list)
 {
-    if (!isdigit((*beg)[1]) && (*beg)[1] != '(' && (*beg)[1] != '-')
+    if (!Expect(lexer, '('))
         return false;
-    size_t newCount = 0;
-    size_t newSize = INITIAL_ARRAY_SIZE;
-    Mono *newMonos = calloc(INITIAL_ARRAY_SIZE, sizeof(Mono));
-    CHECK_PTR(newMonos);
-    if (!GetMonos(*beg, end, &newMonos, &newCount, &newSize, ','))
+    Poly coeff;
+    bool is_sum = Peek(lexer) == '(';
+    if (is_sum)
     {
-        DestroyMonos(&newMonos, newSize);
-        return false;
+        if (!ParseSum(lexer, &coeff))
+            return false;
     } else
     {
-        poly_exp_t exp = 0;
-        if (GetExp(end, beg, &exp))
-        {
-            Poly newPoly = PolyAddMonos(newCount, newMonos);
-            free(newMonos);
-            AddMono(monos, size, count, newPoly, exp);
-            SkipOneChar(beg, end);
-        } else
-        {
-            DestroyMonos(&newMonos, newSize);
+        poly_coeff_t value;
+        if (!ParseCoeff(lexer, &value))
             return false;
-        }
+        coeff = PolyFromCoeff(value);
     }
-    return true;
-}
-
-/**
- * Wczytuje jednomian i ustawia wskaźnik beg na pierwszy znak za nawiasem zamykającym jednomian.
- * @param[in] beg : pierwszy znak jeszcze nie wczytany
- * @param[in] end : ostatni wczytany znak
- * @param[in] monos : tablica jednomianów
- * @param[in] count : liczba jednomianów
- * @param[in] size : rozmiar tablicy
- * @return Czy udało się wczytać jednomian?
- */
-static bool SkipMono(char **beg, char **end, Mono **monos, size_t *count, size_t *size)
-{
-    if (!GetMono(*beg, end, monos, size, count)) //teraz end jest za )
-        return false;
-
-    *beg = *end;
-    return true;
-}
-
-static bool GetMonos(char *line, char **end, Mono **monos, size_t *count, size_t *size, char limit)
-{
-    assert(line[0] == '(');
-    char *beg = line + 1;//następny znak po '('
-    if (*beg == limit || *beg == '\0')
-        return false;
-    while (*beg != limit && *beg != '\0')
+    poly_exp_t exp;
+    if (!Expect(lexer, ',') || !ParseExp(lexer, &exp) || !Expect(lexer, ')'))
     {
-        if (isdigit(*beg) || *beg == '-')
-        {
-            if (!SkipMono(&beg, end, monos, count, size))
-                return false;
-        } else if (*beg == '+')
-        {
-            if (!SkipPlusChar(&beg))
-                return false;
-        } else if (*beg == '(')
-        {
-            if (!getBrackets(end, &beg, monos, count, size))
-                return false;
-        } else return false;
+        PolyDestroy(&coeff);
+        return false;
     }
+    if (!PolyIsZero(&coeff))
+        MonoListPush(list, MonoFromPoly(&coeff, exp));
+    else if (is_sum)
+        MonoListPush(list, MonoFromPoly(&coeff, 0));
     return true;
 }
 
 /**
- * Wczytuje liczbę. Liczba musi być jedynym wyrazem w wierszu.
- * @param[in] line : wiersz
- * @param[in] value : wczytana wartość
- * @return Czy wczytano poprawną wartość?
+ * Wczytuje sumę jednomianów i tworzy z niej wielomian. Jednomiany wczytane w kolejności
+ * rosnących wykładników nie są ponownie sortowane.
+ * @param[in] lexer : pozycja w wierszu
+ * @param[out] poly : wczytany wielomian
+ * @return Czy wczytano poprawną sumę?
  */
-static bool GetSingleNumber(char *line, poly_coeff_t *value)
+static bool ParseSum(Lexer *lexer, Poly *poly)
 {
-    if (line[0] == '+')
-        return false;
-    char *end;
-    if (isLong(line, &end, value))
+    MonoList list = {NULL, 0, 0};
+    do
     {
-        if (*end != '\0' && *end != '\n')
+        if (!ParseMono(lexer, &list))
+        {
+            MonoListDestroy(&list);
             return false;
-        return true;
-    }
-    return false;
+        }
+    } while (Expect(lexer, '+'));
+    *poly = PolyOwnMonos(list.used, list.monos);
+    return true;
 }
 
-/**
- * Wczytuje wielomian będący liczbą, jeśli to możliwe.
- * @param[in] line : wiersz
- * @param[in] poly  : wielomian
- * @return typ wiersza
- */
-static LineType GetPolyCoeff(char *line, Poly *poly)
+LineType GetPoly(const char *line, long length, Poly *poly)
 {
-    poly_coeff_t value = 0;
-    if (!GetSingleNumber(line, &value))
-        return WRONG_POLY;
+    Lexer lexer = {line, line + length};
+    if (length > 0 && line[length - 1] == '\n')
+        lexer.end--;
 
-    *poly = PolyFromCoeff(value);
-    return POLY;
-}
-
-/**
- * Określa typ wiersza zawierającego wielomian (poprawny lub nie).
- * @param[in] line : wiersz
- * @param[in] length : długość wiersza
- * @param[in] poly : wczytany wielomian
- * @return rodzaj wiersza
- */
-static LineType GetPolyHelp(char *line, Poly *poly, long length)
-{
-    size_t count = 0;
-    if (line[0] == '(' && length > 5)
+    Poly result;
+    if (Peek(&lexer) == '(')
     {
-        char *end = line;
-        Mono *monos = calloc(INITIAL_ARRAY_SIZE, sizeof(Mono));
-        CHECK_PTR(monos);
-        size_t size = INITIAL_ARRAY_SIZE;
-        if (GetMonos(line, &end, &monos, &count, &size, '\n'))
-        {
-            *poly = PolyAddMonos(count, monos);
-            free(monos);
-            return POLY;
-        } else
-        {
-            DestroyMonos(&monos, size);
+        if (!ParseSum(&lexer, &result))
             return WRONG_POLY;
-        }
-    }
-    return GetPolyCoeff(line, poly); //jest tylko jedna liczba - stała
-}
-
-
-LineType GetPoly(char *line, long length, Poly *poly)
-{
-    for (int i = 0; i < length; i++)
+    } else
     {
-        if (!isdigit(line[i]) && line[i] != '(' && line[i] != ',' && line[i] != ')' && line[i] != '-' &&
-            line[i] != '+' && line[i] != '\n')
+        poly_coeff_t value;
+        if (!ParseCoeff(&lexer, &value))
             return WRONG_POLY;
+        result = PolyFromCoeff(value);
+    }
+    if (lexer.pos != lexer.end) //za wielomianem są jeszcze znaki
+    {
+        PolyDestroy(&result);
+        return WRONG_POLY;
     }
-    return GetPolyHelp(line, poly, length);
-}
\ No newline at end of file
+    *poly = result;
+    return POLY;
+}
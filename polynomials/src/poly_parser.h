@@ -13,12 +13,12 @@
 
 /**
  * Wczytuje wielomian z wiersza. Jeśli w wierszu jest poprawny wielomian, zapamiętuje go.
- * Jeśli nie, zwraca WRONG_POLY.
+ * Jeśli nie, zwraca WRONG_POLY. Wiersz nie musi być zakończony znakiem '\0'.
  * @param[in] line : wiersz
  * @param[in] length : długość wiersza
  * @param[in] poly : wczytany wielomian
  * @return rodzaj wiersza
  */
-extern LineType GetPoly(char *line, long length, Poly *poly);
+extern LineType GetPoly(const char *line, long length, Poly *poly);
 
 #endif //POLYNOMIALS_POLY_PARSER_H
@@ -9,6 +9,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
 
 #define CHECK_PTR(p)  \
 do {                \
@@ -428,6 +429,610 @@ static bool SimpleIsEqTest(void) {
     return res;
 }
 
+static bool SimpleMetaTest(void) {
+    bool res = true;
+    Poly p = POLY_P;
+    Poly q = POLY_P;
+    Poly one = C(1);
+    Poly r = PolyAdd(&p, &one);
+    res &= PolyHash(&p) == PolyHash(&q);
+    res &= PolyHash(&p) != PolyHash(&r);
+    res &= PolyTerms(&p) == 3;
+    res &= PolyTerms(&r) == 4;
+    res &= PolyTerms(&one) == 1;
+    res &= PolyDeg(&r) == 4;
+    res &= PolyDeg(&r) == PolyDeg(&p);
+    PolyDestroy(&p);
+    PolyDestroy(&q);
+    PolyDestroy(&r);
+    return res;
+}
+
+static bool SimpleShareTest(void) {
+    bool res = true;
+    Poly p = POLY_P;
+    Poly q = PolyShare(&p);
+    Poly r = PolyClone(&p);
+    Poly one = C(1);
+    Poly shared_one = PolyShare(&one);
+    res &= PolyMemory(&p) > 0;
+    res &= PolyMemory(&p) == PolyMemory(&r);
+    res &= PolyMemory(&one) == 0;
+    PolyDestroy(&p);
+    res &= PolyIsEq(&q, &r);
+    res &= PolyIsEq(&shared_one, &one);
+    Poly s = PolyMul(&q, &q);
+    Poly t = PolyMul(&r, &r);
+    res &= PolyIsEq(&s, &t);
+    PolyDestroy(&q);
+    PolyDestroy(&r);
+    PolyDestroy(&s);
+    PolyDestroy(&t);
+    return res;
+}
+
+static bool SimpleInlineTest(void) {
+    bool res = true;
+    Poly p = P(C(3), 2);
+    Poly q = P(C(1), 0, C(3), 2);
+    Poly minus_one = C(-1);
+    Poly r = PolyAdd(&q, &minus_one);
+    Poly s = P(P(C(3), 2), 1);
+    res &= PolyMemory(&p) == 0 && PolyMemory(&r) == 0;
+    res &= PolyIsEq(&p, &r) && PolyHash(&p) == PolyHash(&r);
+    res &= PolyTerms(&p) == 1 && PolyDeg(&p) == 2;
+    res &= PolyDegBy(&p, 0) == 2 && PolyDegBy(&p, 1) == 0;
+    res &= PolyDegBy(&s, 1) == 2 && PolyDeg(&s) == 3;
+    res &= TestEq(PolyClone(&s), PolyMul(&s, &q), false);
+    res &= TestEq(PolyMul(&p, &p), P(C(9), 4), true);
+    res &= TestEq(PolyNeg(&p), P(C(-3), 2), true);
+    res &= TestEq(PolySub(&p, &r), C(0), true);
+    res &= TestEq(PolyAdd(&s, &s), P(P(C(6), 2), 1), true);
+    res &= TestEq(PolyAt(&s, 2), P(C(6), 2), true);
+    res &= TestEq(PolyAt(&p, 2), C(12), true);
+    PolyDestroy(&p);
+    PolyDestroy(&q);
+    PolyDestroy(&r);
+    PolyDestroy(&s);
+    return res;
+}
+
+static bool SimpleDenseTest(void) {
+    bool res = true;
+    Poly p = P(C(1), 0, C(2), 1, C(3), 2);
+    Poly q = P(P(C(1), 0, C(1), 1), 0, C(-1), 1);
+    Poly sparse = P(C(1), 1, C(2), 2, C(3), 3);
+    Poly x = P(C(1), 1);
+    Poly shifted = PolyMul(&p, &x);
+    res &= PolyIsEq(&shifted, &sparse);
+    res &= PolyMemory(&p) < PolyMemory(&sparse);
+    res &= TestEq(PolyMul(&p, &p), P(C(1), 0, C(4), 1, C(10), 2, C(12), 3, C(9), 4), true);
+    res &= TestEq(PolyMul(&q, &q),
+                  P(P(C(1), 0, C(2), 1, C(1), 2), 0, P(C(-2), 0, C(-2), 1), 1, C(1), 2), true);
+    res &= TestEq(PolyAdd(&p, &q), P(P(C(2), 0, C(1), 1), 0, C(1), 1, C(3), 2), true);
+    res &= TestEq(PolyAt(&q, 3), P(C(-2), 0, C(1), 1), true);
+    Poly pp = PolyMul(&p, &p);
+    Poly ps = PolyMul(&p, &sparse);
+    Poly expected = PolyMul(&pp, &x);
+    res &= PolyIsEq(&ps, &expected);
+    PolyDestroy(&p);
+    PolyDestroy(&q);
+    PolyDestroy(&sparse);
+    PolyDestroy(&x);
+    PolyDestroy(&shifted);
+    PolyDestroy(&pp);
+    PolyDestroy(&ps);
+    PolyDestroy(&expected);
+    return res;
+}
+
+//p + x_1 nie jest liściem, więc działania na nim idą ogólną ścieżką rekurencyjną, a po odjęciu
+//x_1 (albo jego obrazu) wynik musi być taki sam jak z szybkiej ścieżki dla liścia p
+static bool TestLeaf(Poly p, Poly q, poly_coeff_t c, poly_coeff_t x) {
+    Poly y = P(P(C(1), 1), 0);
+    Poly p_y = PolyAdd(&p, &y);
+    Poly coeff = C(c);
+
+    Poly leaf_sum = PolyAdd(&p, &q);
+    Poly sum_y = PolyAdd(&p_y, &q);
+    Poly sum = PolySub(&sum_y, &y);
+    bool res = PolyIsEq(&leaf_sum, &sum);
+
+    Poly leaf_product = PolyMul(&p, &coeff);
+    Poly product_y = PolyMul(&p_y, &coeff);
+    Poly y_c = PolyMul(&y, &coeff);
+    Poly product = PolySub(&product_y, &y_c);
+    res &= PolyIsEq(&leaf_product, &product);
+
+    Poly leaf_value = PolyAt(&p, x);
+    Poly value_y = PolyAt(&p_y, x);
+    Poly y_x = PolyAt(&y, x);
+    Poly value = PolySub(&value_y, &y_x);
+    res &= PolyIsEq(&leaf_value, &value);
+
+    Poly polys[] = {p, q, y, p_y, leaf_sum, sum_y, sum, leaf_product, product_y, y_c, product,
+                    leaf_value, value_y, y_x, value};
+    for (size_t i = 0; i < sizeof(polys) / sizeof(polys[0]); i++)
+        PolyDestroy(&polys[i]);
+    return res;
+}
+
+static bool SimpleLeafTest(void) {
+    bool res = true;
+    //sumy znoszą się całkowicie, także modulo 2^64
+    res &= TestLeaf(P(C(5), 0, C(LONG_MIN), 3, C(2), 7), P(C(-5), 0, C(LONG_MIN), 3, C(-2), 7), 3, 2);
+    //sumy znoszą się częściowo, a pozostałe jednomiany przeplatają się
+    res &= TestLeaf(P(C(1), 1, C(LONG_MAX), 4, C(7), 9), P(C(-1), 1, C(2), 2, C(1), 4, C(3), 12),
+                    1L << 32, 1L << 32);
+    //iloczyny współczynników i potęgi punktu przekraczają zakres
+    res &= TestLeaf(P(C(LONG_MAX), 1, C(3), 5, C(-7), 64), P(C(1), 0), LONG_MIN, 3);
+    res &= TestLeaf(P(C(1L << 40), 0, C(-3), 2, C(9), 70), P(C(4), 3), 1L << 24, -(1L << 21));
+    res &= TestLeaf(P(C(2), 0, C(-1), 1, C(5), 2), P(C(-2), 0, C(1), 1, C(-5), 2), -1, LONG_MAX);
+    return res;
+}
+
+static bool SimplePermuteTest(void) {
+    bool res = true;
+    Poly p = P(P(C(1), 5), 1, P(C(1), 5), 2, P(C(1), 5), 3);
+    Poly q = P(P(P(C(1), 0, C(1), 1), 2), 1);
+    Poly c = C(7);
+    size_t identity[] = {0, 1, 2};
+    size_t swap[] = {1, 0, 2};
+    size_t rotate[] = {2, 0, 1};
+    size_t perm[3];
+    res &= PolyVarCount(&p) == 2 && PolyVarCount(&q) == 3 && PolyVarCount(&c) == 0;
+    res &= PolyOrderCost(&p, 2, identity) == 6 && PolyOrderCost(&p, 2, swap) == 4;
+    PolyBestVarOrder(&p, 3, perm);
+    res &= perm[0] == 1 && perm[1] == 0 && perm[2] == 2;
+    PolyBestVarOrder(&q, 2, perm);
+    res &= perm[0] == 0 && perm[1] == 1;
+    res &= TestEq(PolyPermuteVars(&p, 2, swap), P(P(C(1), 1, C(1), 2, C(1), 3), 5), true);
+    res &= TestEq(PolyPermuteVars(&p, 3, rotate), P(P(P(C(1), 1, C(1), 2, C(1), 3), 0), 5), true);
+    res &= TestEq(PolyPermuteVars(&q, 2, swap), P(P(P(C(1), 0, C(1), 1), 1), 2), true);
+    res &= TestEq(PolyPermuteVars(&q, 3, rotate), P(P(P(C(1), 1), 0, P(C(1), 1), 1), 2), true);
+    res &= TestEq(PolyPermuteVars(&c, 3, rotate), C(7), true);
+    Poly r = PolyPermuteVars(&p, 2, swap);
+    res &= TestEq(PolyPermuteVars(&r, 2, swap), PolyClone(&p), true);
+    PolyDestroy(&p);
+    PolyDestroy(&q);
+    PolyDestroy(&r);
+    return res;
+}
+
+static Poly Var(size_t idx) {
+    Poly res = P(C(1), 1);
+    for (size_t i = 0; i < idx; i++)
+        res = P(res, 0);
+    return res;
+}
+
+static bool TestPartialEval(const Poly *p, const bool mask[3], const poly_coeff_t values[3]) {
+    Poly q[3];
+    for (size_t i = 0; i < 3; i++)
+        q[i] = mask[i] ? C(values[i]) : Var(i);
+    bool res = TestEq(PolyPartialEval(p, 3, mask, values), PolyCompose(p, 3, q), true);
+    for (size_t i = 0; i < 3; i++)
+        PolyDestroy(&q[i]);
+    return res;
+}
+
+static bool SimplePartialEvalTest(void) {
+    bool res = true;
+    Poly terms[] = {P(P(C(1), 1), 2), P(P(P(C(3), 1), 3), 0), P(P(P(C(-1), 2), 0), 0), C(5)};
+    Poly p = C(0);
+    for (size_t i = 0; i < 4; i++) {
+        Poly temp = PolyAdd(&p, &terms[i]);
+        PolyDestroy(&p);
+        PolyDestroy(&terms[i]);
+        p = temp;
+    }
+    res &= TestPartialEval(&p, (bool[]) {false, true, false}, (poly_coeff_t[]) {0, 2, 0});
+    res &= TestPartialEval(&p, (bool[]) {true, false, true}, (poly_coeff_t[]) {3, 0, -1});
+    res &= TestPartialEval(&p, (bool[]) {true, false, false}, (poly_coeff_t[]) {-2, 0, 0});
+    res &= TestPartialEval(&p, (bool[]) {true, true, true}, (poly_coeff_t[]) {1, 1, 1});
+    res &= TestPartialEval(&p, (bool[]) {false, false, false}, (poly_coeff_t[]) {0, 0, 0});
+    res &= TestEq(PolyPartialEval(&p, 3, (bool[]) {true, true, true}, (poly_coeff_t[]) {2, 1, 1}), C(11), true);
+    res &= TestEq(PolyPartialEval(&p, 2, (bool[]) {false, true}, (poly_coeff_t[]) {0, 0}),
+                  P(P(P(C(5), 0, C(-1), 2), 0), 0), true);
+    PolyDestroy(&p);
+    return res;
+}
+
+static bool SimpleEvalGradTest(void) {
+    bool res = true;
+    Poly terms[] = {P(P(C(1), 1), 2), P(P(P(C(3), 1), 3), 0), P(P(P(C(-1), 2), 0), 0), C(5)};
+    Poly p = C(0);
+    for (size_t i = 0; i < 4; i++) {
+        Poly temp = PolyAdd(&p, &terms[i]);
+        PolyDestroy(&p);
+        PolyDestroy(&terms[i]);
+        p = temp;
+    }
+    poly_coeff_t value;
+    poly_coeff_t grad[4];
+    PolyEvalGrad(&p, 3, (poly_coeff_t[]) {2, 1, 1}, &value, grad);
+    res &= value == 11 && grad[0] == 4 && grad[1] == 13 && grad[2] == 1;
+    PolyEvalGrad(&p, 2, (poly_coeff_t[]) {2, 1}, &value, grad);
+    res &= value == 9 && grad[0] == 4 && grad[1] == 4;
+    PolyEvalGrad(&p, 4, (poly_coeff_t[]) {-1, 2, 3, 7}, &value, grad);
+    res &= value == 2 + 72 - 9 + 5 && grad[0] == -4 && grad[1] == 1 + 108 && grad[2] == 24 - 6 && grad[3] == 0;
+    Poly dense = P(C(1), 0, C(2), 1, C(3), 2);
+    PolyEvalGrad(&dense, 1, (poly_coeff_t[]) {2}, &value, grad);
+    res &= value == 17 && grad[0] == 14;
+    Poly c = C(7);
+    PolyEvalGrad(&c, 2, (poly_coeff_t[]) {2, 3}, &value, grad);
+    res &= value == 7 && grad[0] == 0 && grad[1] == 0;
+    PolyDestroy(&p);
+    PolyDestroy(&dense);
+    return res;
+}
+
+static bool SimpleBuilderTest(void) {
+    bool res = true;
+    PolyBuilder builder;
+    PolyBuilderInit(&builder, 3);
+    PolyBuilderAddTerm(&builder, (poly_exp_t[]) {0, 0, 2}, -1);
+    PolyBuilderAddTerm(&builder, (poly_exp_t[]) {2, 1, 0}, 1);
+    PolyBuilderAddTerm(&builder, (poly_exp_t[]) {0, 0, 0}, 5);
+    PolyBuilderAddTerm(&builder, (poly_exp_t[]) {70000, 0, 0}, 4);
+    PolyBuilderAddTerm(&builder, (poly_exp_t[]) {0, 3, 1}, 3);
+    PolyBuilderAddTerm(&builder, (poly_exp_t[]) {70000, 0, 0}, -4);
+    PolyBuilderAddTerm(&builder, (poly_exp_t[]) {0, 0, 2}, 0);
+    res &= TestEq(PolyBuilderFinish(&builder),
+                  P(P(P(C(5), 0, C(-1), 2), 0, P(C(3), 1), 3), 0, P(C(1), 1), 2), true);
+    res &= TestEq(PolyBuilderFinish(&builder), C(0), true);
+    PolyBuilderAddTerm(&builder, (poly_exp_t[]) {1, 0, 0}, 2);
+    PolyBuilderAddTerm(&builder, (poly_exp_t[]) {1, 0, 0}, 3);
+    res &= TestEq(PolyBuilderFinish(&builder), P(C(5), 1), true);
+    PolyBuilderDestroy(&builder);
+    PolyBuilderInit(&builder, 0);
+    PolyBuilderAddTerm(&builder, NULL, 7);
+    PolyBuilderAddTerm(&builder, NULL, -2);
+    res &= TestEq(PolyBuilderFinish(&builder), C(5), true);
+    PolyBuilderDestroy(&builder);
+    return res;
+}
+
+static bool TestTerms(const Poly *p, size_t count, const poly_coeff_t coeffs[], const poly_exp_t exps[][3]) {
+    PolyTermIter it;
+    PolyTermIterInit(&it, p);
+    bool res = true;
+    poly_coeff_t coeff;
+    for (size_t i = 0; i < count; i++) {
+        res &= PolyTermIterNext(&it, &coeff) && coeff == coeffs[i];
+        for (size_t j = 0; j < 3; j++)
+            res &= PolyTermIterExp(&it, j) == exps[i][j];
+    }
+    res &= !PolyTermIterNext(&it, &coeff) && !PolyTermIterNext(&it, &coeff);
+    PolyTermIterDestroy(&it);
+    return res;
+}
+
+static bool SimpleTermIterTest(void) {
+    bool res = true;
+    Poly p = P(P(P(C(5), 0, C(-1), 2), 0, P(C(3), 1), 3), 0, P(C(1), 1), 2, C(7), 4);
+    Poly c = C(-2);
+    Poly zero = C(0);
+    res &= TestTerms(&p, 5, (poly_coeff_t[]) {5, -1, 3, 1, 7},
+                     (poly_exp_t[][3]) {{0, 0, 0}, {0, 0, 2}, {0, 3, 1}, {2, 1, 0}, {4, 0, 0}});
+    res &= TestTerms(&c, 1, (poly_coeff_t[]) {-2}, (poly_exp_t[][3]) {{0, 0, 0}});
+    res &= TestTerms(&zero, 0, NULL, NULL);
+
+    PolyTermIter it;
+    poly_coeff_t coeff;
+    PolyTermIterInit(&it, &p);
+    res &= PolyTermIterSeek(&it, 2, (poly_exp_t[]) {0, 3});
+    res &= PolyTermIterNext(&it, &coeff) && coeff == 3 && PolyTermIterExp(&it, 2) == 1;
+    res &= !PolyTermIterSeek(&it, 2, (poly_exp_t[]) {0, 1});
+    res &= PolyTermIterNext(&it, &coeff) && coeff == 3;
+    res &= !PolyTermIterSeek(&it, 2, (poly_exp_t[]) {2, 2});
+    res &= PolyTermIterNext(&it, &coeff) && coeff == 7 && PolyTermIterExp(&it, 0) == 4;
+    res &= PolyTermIterSeek(&it, 3, (poly_exp_t[]) {4, 0, 0});
+    res &= PolyTermIterNext(&it, &coeff) && coeff == 7 && PolyTermIterDepth(&it) == 1;
+    res &= !PolyTermIterSeek(&it, 1, (poly_exp_t[]) {5});
+    res &= !PolyTermIterNext(&it, &coeff);
+    PolyTermIterDestroy(&it);
+
+    Poly deep = C(1);
+    for (size_t i = 0; i < 2 * POLY_TERM_ITER_INLINE_DEPTH; i++)
+        deep = P(deep, 1);
+    PolyTermIterInit(&it, &deep);
+    res &= PolyTermIterNext(&it, &coeff) && coeff == 1;
+    res &= PolyTermIterDepth(&it) == 2 * POLY_TERM_ITER_INLINE_DEPTH && PolyTermIterExp(&it, 0) == 1;
+    res &= !PolyTermIterNext(&it, &coeff);
+    PolyTermIterDestroy(&it);
+    PolyDestroy(&deep);
+    PolyDestroy(&p);
+    return res;
+}
+
+static bool SimpleReleaseLargeTest(void) {
+    bool res = true;
+    Poly c = C(3);
+    Poly leaf = P(C(1), 0, C(2), 5);
+    Poly p = POLY_P;
+    Poly q = PolyShare(&p);
+    Poly r = PolyClone(&p);
+    res &= !PolyReleaseLarge(&c, 0);
+    res &= !PolyReleaseLarge(&leaf, SIZE_MAX); //mały liść jest zwalniany od razu
+    res &= !PolyReleaseLarge(&p, 0); //węzeł jest nadal współdzielony
+    res &= !PolyReleaseLarge(&q, SIZE_MAX); //małe drzewo z poddrzewami o nieznanym rozmiarze
+    Poly big = P(P(C(1), 0, C(2), 3), 0, P(C(1), 1, C(-1), 2, C(4), 9), 2, P(C(5), 0, C(1), 4), 6);
+    Poly big_share = PolyShare(&big);
+    Poly shared = P(big_share, 1, C(1), 2);
+    res &= !PolyReleaseLarge(&shared, 200); //współdzielone poddrzewo nie zostanie zwolnione
+    res &= PolyReleaseLarge(&big, 200); //nieznany rozmiar, ale liście przekraczają próg
+    PolyDestroyReleased(&big);
+    Poly t = PolyClone(&r);
+    size_t bytes = PolyMemory(&r);
+    res &= PolyMemory(&t) == bytes;
+    res &= !PolyReleaseLarge(&r, bytes + 1); //znany rozmiar drzewa jest za mały
+    res &= PolyReleaseLarge(&t, bytes);
+    PolyDestroyReleased(&t);
+    return res;
+}
+
+static bool TestWrite(Poly a, const char *res) {
+    FILE *file = tmpfile();
+    if (file == NULL)
+        return false;
+    PolyWriter writer;
+    PolyWriterInit(&writer, file);
+    PolyWrite(&writer, &a);
+    PolyWriterPutChar(&writer, '\n');
+    PolyWriterDestroy(&writer);
+    rewind(file);
+    char buf[256] = {0};
+    bool is_eq = fgets(buf, sizeof(buf), file) != NULL && strcmp(buf, res) == 0;
+    fclose(file);
+    PolyDestroy(&a);
+    return is_eq;
+}
+
+static bool SimpleWriteTest(void) {
+    bool res = true;
+    res &= TestWrite(C(0), "0\n");
+    res &= TestWrite(C(-17), "-17\n");
+    res &= TestWrite(C(LONG_MIN), "-9223372036854775808\n");
+    res &= TestWrite(C(LONG_MAX), "9223372036854775807\n");
+    res &= TestWrite(POLY_P, "((1,3),0)+((1,2),2)+(1,3)\n");
+    res &= TestWrite(P(P(P(C(-1), 1), 2), 3, C(5), 2147483647),
+                     "(((-1,1),2),3)+(5,2147483647)\n");
+    return res;
+}
+
+static bool TestBinary(Poly a) {
+    FILE *file = tmpfile();
+    if (file == NULL)
+        return false;
+    PolyWriter writer;
+    PolyWriterInit(&writer, file);
+    PolyWriteBinary(&writer, &a);
+    PolyWriterDestroy(&writer);
+    long size = ftell(file);
+    rewind(file);
+    unsigned char buf[256];
+    bool res = size > 0 && (size_t) size <= sizeof(buf) && fread(buf, 1, size, file) == (size_t) size;
+    fclose(file);
+    Poly b;
+    res = res && PolyReadBinary(buf, size, &b) == (size_t) size;
+    if (res) {
+        res = PolyIsEq(&a, &b);
+        PolyDestroy(&b);
+    }
+    for (long i = 0; res && i < size; i++)
+        res = PolyReadBinary(buf, i, &b) == 0;
+    PolyDestroy(&a);
+    return res;
+}
+
+static bool SimpleBinaryTest(void) {
+    bool res = true;
+    res &= TestBinary(C(0));
+    res &= TestBinary(C(LONG_MIN));
+    res &= TestBinary(C(LONG_MAX));
+    res &= TestBinary(POLY_P);
+    res &= TestBinary(P(C(-5), 3));
+    res &= TestBinary(P(P(C(1), 0, C(-2), 1), 0, C(3), 1, P(C(4), 2), 2));
+    res &= TestBinary(P(P(P(C(-1), 1), 2), 3, C(5), 2147483647));
+    res &= TestBinary(P(C(1), 0, P(C(-3), 0, C(2), 7), 1, C(-1), 2));
+    Poly p;
+    unsigned char unsorted[] = {2, 5, 2, 0, 2};
+    res &= PolyReadBinary(unsorted, sizeof(unsorted), &p) == 0;
+    unsigned char zero_coeff[] = {1, 3, 0};
+    res &= PolyReadBinary(zero_coeff, sizeof(zero_coeff), &p) == 0;
+    unsigned char const_node[] = {1, 1, 2};
+    res &= PolyReadBinary(const_node, sizeof(const_node), &p) == 0;
+    unsigned char nested_const_node[] = {1, 2, 1, 1, 2};
+    res &= PolyReadBinary(nested_const_node, sizeof(nested_const_node), &p) == 0;
+    return res;
+}
+
+static bool TestImage(Poly a) {
+    FILE *file = tmpfile();
+    if (file == NULL)
+        return false;
+    bool res = PolyWriteImage(file, &a);
+    long size = ftell(file);
+    rewind(file);
+    static long long buf[256];
+    res = res && size > 0 && (size_t) size <= sizeof(buf) && fread(buf, 1, size, file) == (size_t) size;
+    fclose(file);
+    Poly b;
+    res = res && PolyFromImage(buf, size, &b);
+    if (res) {
+        Poly c = PolyClone(&b);
+        Poly d = PolyAdd(&b, &a);
+        Poly e = PolyAdd(&a, &a);
+        res = PolyIsEq(&a, &b) && PolyIsEq(&c, &a) && PolyIsEq(&d, &e) && PolyDeg(&b) == PolyDeg(&a);
+        Poly f = PolyAt(&b, 3);
+        Poly g = PolyAt(&a, 3);
+        res = res && PolyIsEq(&f, &g);
+        PolyDestroy(&b);
+        PolyDestroy(&b);
+        res = res && PolyIsEq(&a, &b);
+        PolyDestroy(&c);
+        PolyDestroy(&d);
+        PolyDestroy(&e);
+        PolyDestroy(&f);
+        PolyDestroy(&g);
+    }
+    res = res && !PolyFromImage(buf, size - 1, &b) && !PolyFromImage((char *) buf + 1, size - 1, &b);
+    PolyDestroy(&a);
+    return res;
+}
+
+static bool TestCorruptImage(Poly a) {
+    FILE *file = tmpfile();
+    if (file == NULL)
+        return false;
+    bool res = PolyWriteImage(file, &a);
+    long size = ftell(file);
+    rewind(file);
+    static long long image[256];
+    static long long buf[256];
+    res = res && size > 0 && (size_t) size <= sizeof(image) && fread(image, 1, size, file) == (size_t) size;
+    fclose(file);
+    const long long patterns[] = {0, -1, 1, 8, 16, 1 << 20};
+    //każde słowo za nagłówkiem obrazu po kolei zastępujemy albo psujemy; obraz uszkodzony
+    //poza dopełnieniem musi zostać odrzucony bez czytania spoza bufora
+    for (size_t i = 6; res && i < (size_t) size / sizeof(long long); i++) {
+        for (size_t j = 0; j < sizeof(patterns) / sizeof(patterns[0]); j++) {
+            memcpy(buf, image, size);
+            buf[i] = j < 2 ? patterns[j] : buf[i] ^ patterns[j];
+            Poly b;
+            if (PolyFromImage(buf, size, &b)) {
+                res &= PolyIsEq(&a, &b) && PolyDeg(&a) == PolyDeg(&b);
+                PolyDestroy(&b);
+            }
+        }
+    }
+    PolyDestroy(&a);
+    return res;
+}
+
+//obraz wielomianu x_0 (2 x_1^3) + 1, w którym jednomian 2 x_1^3 zamiast w miejscu leży w osobnym
+//węźle z jednym stałym współczynnikiem; skrót takiego węzła jest równy skrótowi jednomianu
+//w miejscu, więc wszystkie metadane się zgadzają, ale wielomian nie jest w postaci kanonicznej
+static bool TestNonCanonicalImage(void) {
+    Poly mono = P(C(2), 3);
+    Poly a = P(C(1), 0, mono, 1);
+    FILE *file = tmpfile();
+    if (file == NULL)
+        return false;
+    bool res = PolyWriteImage(file, &a);
+    long size = ftell(file);
+    rewind(file);
+    static long long buf[32];
+    res = res && size == 120 && fread(buf, 1, size, file) == (size_t) size;
+    fclose(file);
+    Poly b;
+    res = res && PolyFromImage(buf, size, &b);
+    unsigned char *bytes = (unsigned char *) buf;
+    buf[2] = 184;               //rozmiar obrazu
+    buf[8] = 136;               //rozmiar drzewa w metadanych korzenia
+    buf[13] = 1;                //drugi współczynnik korzenia ma węzeł z jednym jednomianem…
+    buf[14] = (48 << 1) | 1;    //…położony 48 bajtów za polem arr
+    buf[15] = (long long) PolyHash(&mono);
+    buf[16] = 1;                //liczba jednomianów
+    buf[17] = 64;               //rozmiar węzła
+    buf[18] = -1;               //węzeł obrazu nie jest zwalniany
+    int deg = 3;
+    memcpy(&bytes[152], &deg, sizeof(deg));
+    bytes[156] = 1;             //metadane są wyznaczone
+    bytes[157] = 0;
+    bytes[158] = 1;             //liść
+    bytes[159] = 0;
+    buf[20] = 2;                //współczynnik
+    buf[21] = 0;
+    buf[22] = 3;                //wykładnik z dopełnieniem
+    res = res && !PolyFromImage(buf, 184, &b);
+    PolyDestroy(&a);
+    return res;
+}
+
+static bool SimpleImageTest(void) {
+    bool res = true;
+    res &= TestImage(C(0));
+    res &= TestImage(C(LONG_MIN));
+    res &= TestImage(POLY_P);
+    res &= TestImage(P(C(-5), 3));
+    res &= TestImage(P(P(C(1), 0, C(-2), 1), 0, C(3), 1, P(C(4), 2), 2));
+    res &= TestImage(P(P(P(C(-1), 1), 2), 3, C(5), 2147483647));
+    res &= TestImage(P(C(1), 0, P(C(-3), 0, C(2), 7), 1, C(-1), 2));
+    res &= TestCorruptImage(P(P(C(1), 0, C(-2), 1), 0, C(3), 1, P(C(4), 2), 2));
+    res &= TestCorruptImage(P(P(P(C(-1), 1, C(2), 3), 2), 3, C(5), 2147483647));
+    res &= TestNonCanonicalImage();
+    return res;
+}
+
+static bool TestFreeze(Poly a) {
+    Poly b = PolyFreeze(&a);
+    Poly c = PolyFreeze(&b);
+    Poly d = PolyAdd(&b, &a);
+    Poly e = PolyMul(&b, &c);
+    bool res = PolyIsEq(&a, &b) && PolyIsEq(&b, &c) && PolyDeg(&a) == PolyDeg(&b);
+    Poly f = PolyAdd(&a, &a);
+    Poly g = PolyMul(&a, &a);
+    Poly h = PolyAt(&b, -2);
+    Poly i = PolyAt(&a, -2);
+    res = res && PolyIsEq(&d, &f) && PolyIsEq(&e, &g) && PolyIsEq(&h, &i);
+    Poly j = PolyClone(&b);
+    PolyDestroy(&b);
+    PolyDestroy(&c);
+    res = res && PolyIsEq(&j, &a) && PolyIsEq(&d, &f) && PolyIsEq(&e, &g);
+    PolyDestroy(&a);
+    PolyDestroy(&d);
+    PolyDestroy(&e);
+    PolyDestroy(&f);
+    PolyDestroy(&g);
+    PolyDestroy(&h);
+    PolyDestroy(&i);
+    PolyDestroy(&j);
+    return res;
+}
+
+static bool SimpleFreezeTest(void) {
+    bool res = true;
+    res &= TestFreeze(C(0));
+    res &= TestFreeze(C(LONG_MIN));
+    res &= TestFreeze(POLY_P);
+    res &= TestFreeze(P(C(-5), 3));
+    res &= TestFreeze(P(P(C(1), 0, C(-2), 1), 0, C(3), 1, P(C(4), 2), 2));
+    res &= TestFreeze(P(P(P(C(-1), 1), 2), 3, C(5), 2147483647));
+    res &= TestFreeze(P(C(1), 0, P(C(-3), 0, P(C(2), 1), 7), 1, C(-1), 2));
+    return res;
+}
+
+static bool TestIsEqMul(Poly a, Poly b, bool res) {
+    Poly c = PolyMul(&a, &b);
+    Poly one = C(1);
+    Poly d = PolyAdd(&c, &one);
+    bool is_eq = PolyIsEqMul(&a, &b, &c) == res && !PolyIsEqMul(&a, &b, &d);
+    PolyDestroy(&a);
+    PolyDestroy(&b);
+    PolyDestroy(&c);
+    PolyDestroy(&d);
+    return is_eq;
+}
+
+static bool SimpleIsEqMulTest(void) {
+    bool res = true;
+    res &= TestIsEqMul(C(2), C(3), true);
+    res &= TestIsEqMul(P(C(1), 1), C(0), true);
+    res &= TestIsEqMul(POLY_P, POLY_P, true);
+    res &= TestIsEqMul(P(C(1L << 32), 1), P(C(1L << 32), 2), true);
+    res &= TestIsEqMul(P(P(C(1), 4), 0, P(C(1), 2), 2, C(1), 3),
+                       P(C(-1), 0, P(C(3), 1), 1), true);
+    //2^63 a (a + 1) = 0 modulo 2^64 dla każdego a, więc same wartości modulo 2^64 się zgadzają
+    Poly x = P(C(1), 1);
+    Poly r = P(C(LONG_MIN), 1, C(LONG_MIN + 1), 2);
+    res &= !PolyIsEqMul(&x, &x, &r);
+    PolyDestroy(&x);
+    PolyDestroy(&r);
+    return res;
+}
+
 static bool SimpleAtTest(void) {
     bool res = true;
     res &= TestAt(C(2), 1, C(2));
@@ -487,6 +1092,22 @@ static const test_list_t test_list[] = {
         TEST(SimpleDegTest),
         //TEST(SimpleDegGroup),
         TEST(SimpleIsEqTest),
+        TEST(SimpleMetaTest),
+        TEST(SimpleShareTest),
+        TEST(SimpleInlineTest),
+        TEST(SimpleDenseTest),
+        TEST(SimpleLeafTest),
+        TEST(SimplePermuteTest),
+        TEST(SimplePartialEvalTest),
+        TEST(SimpleEvalGradTest),
+        TEST(SimpleBuilderTest),
+        TEST(SimpleTermIterTest),
+        TEST(SimpleReleaseLargeTest),
+        TEST(SimpleWriteTest),
+        TEST(SimpleBinaryTest),
+        TEST(SimpleImageTest),
+        TEST(SimpleFreezeTest),
+        TEST(SimpleIsEqMulTest),
         TEST(SimpleAtTest),
         TEST(OverflowTest),
         /*TEST(SimpleArithmeticTest),
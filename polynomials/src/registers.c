@@ -0,0 +1,156 @@
+/** @file
+ Implementacja nazwanych rejestrów kalkulatora
+
+ @author Julia Karmowska
+ @date 2021
+*/
+
+#include <string.h>
+#include "registers.h"
+#include "memory.h"
+
+/**
+ * To jest stała reprezentująca początkowy rozmiar tablicy haszującej rejestrów
+ */
+#define INITIAL_REGISTERS_SIZE 16
+
+/**
+ * Struktura opisująca rejestr.
+ */
+typedef struct Register {
+    char *name;             ///< nazwa rejestru
+    uint64_t key;           ///< skrót nazwy
+    StackItem item;         ///< zawartość rejestru
+    struct Register *next;  ///< następny rejestr w tym samym kubełku
+} Register;
+
+/**
+ * Struktura opisująca zbiór rejestrów, implementacja tablicą haszującą.
+ */
+struct Registers {
+    Register **buckets;     ///< kubełki
+    size_t size;            ///< liczba kubełków
+    size_t used;            ///< liczba rejestrów
+};
+
+/**
+ * Wyznacza skrót nazwy rejestru (FNV-1a).
+ * @param[in] name : nazwa
+ * @return skrót
+ */
+static uint64_t NameKey(const char *name)
+{
+    uint64_t key = 0xcbf29ce484222325ULL;
+    for (; *name != '\0'; name++)
+    {
+        key ^= (unsigned char) *name;
+        key *= 0x100000001b3ULL;
+    }
+    return key;
+}
+
+/**
+ * Szuka rejestru o podanej nazwie.
+ * @param[in] registers : zbiór rejestrów
+ * @param[in] name : nazwa
+ * @param[in] key : skrót nazwy
+ * @return rejestr albo NULL, jeśli nie istnieje
+ */
+static Register *Find(Registers *registers, const char *name, uint64_t key)
+{
+    for (Register *reg = registers->buckets[key % registers->size]; reg != NULL; reg = reg->next)
+    {
+        if (reg->key == key && strcmp(reg->name, name) == 0)
+            return reg;
+    }
+    return NULL;
+}
+
+/**
+ * Podwaja liczbę kubełków, jeśli rejestrów jest więcej niż kubełków.
+ * @param[in] registers : zbiór rejestrów
+ */
+static void MaybeGrow(Registers *registers)
+{
+    if (registers->used < registers->size)
+        return;
+    size_t new_size = 2 * registers->size;
+    Register **buckets = calloc(new_size, sizeof(Register *));
+    CHECK_PTR(buckets);
+    for (size_t i = 0; i < registers->size; i++)
+    {
+        while (registers->buckets[i] != NULL)
+        {
+            Register *moved = registers->buckets[i];
+            registers->buckets[i] = moved->next;
+            moved->next = buckets[moved->key % new_size];
+            buckets[moved->key % new_size] = moved;
+        }
+    }
+    free(registers->buckets);
+    registers->buckets = buckets;
+    registers->size = new_size;
+}
+
+void RegistersInit(Registers **registers)
+{
+    *registers = calloc(1, sizeof(Registers));
+    CHECK_PTR(*registers);
+    (*registers)->buckets = calloc(INITIAL_REGISTERS_SIZE, sizeof(Register *));
+    CHECK_PTR((*registers)->buckets);
+    (*registers)->size = INITIAL_REGISTERS_SIZE;
+}
+
+void RegistersStore(Registers *registers, const char *name, StackItem *item)
+{
+    uint64_t key = NameKey(name);
+    Register *reg = Find(registers, name, key);
+    if (reg != NULL)
+    {
+        StackItemRelease(&reg->item);
+        reg->item = *item;
+        return;
+    }
+    MaybeGrow(registers);
+    reg = malloc(sizeof(Register));
+    CHECK_PTR(reg);
+    size_t length = strlen(name) + 1;
+    reg->name = malloc(length);
+    CHECK_PTR(reg->name);
+    memcpy(reg->name, name, length);
+    reg->key = key;
+    reg->item = *item;
+    reg->next = registers->buckets[key % registers->size];
+    registers->buckets[key % registers->size] = reg;
+    registers->used++;
+}
+
+bool RegistersLoad(Registers *registers, const char *name, StackItem *item)
+{
+    Register *reg = Find(registers, name, NameKey(name));
+    if (reg == NULL)
+        return false;
+    *item = reg->item;
+    if (item->expr != NULL)
+        ExprRetain(item->expr);
+    else
+        item->poly = PolyShare(&item->poly);
+    return true;
+}
+
+void RegistersClear(Registers **registers)
+{
+    for (size_t i = 0; i < (*registers)->size; i++)
+    {
+        while ((*registers)->buckets[i] != NULL)
+        {
+            Register *reg = (*registers)->buckets[i];
+            (*registers)->buckets[i] = reg->next;
+            StackItemRelease(&reg->item);
+            free(reg->name);
+            free(reg);
+        }
+    }
+    free((*registers)->buckets);
+    free(*registers);
+}
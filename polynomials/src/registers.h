@@ -0,0 +1,48 @@
+/** @file
+ Interfejs nazwanych rejestrów kalkulatora
+
+ @author Julia Karmowska
+ @date 2021
+*/
+
+#ifndef POLYNOMIALS_REGISTERS_H
+#define POLYNOMIALS_REGISTERS_H
+
+#include "stack.h"
+
+/**
+ * Struktura opisująca zbiór nazwanych rejestrów (tablica haszująca nazw).
+ */
+typedef struct Registers Registers;
+
+/**
+ * Tworzy nowy pusty zbiór rejestrów.
+ * @param[in] registers : zbiór rejestrów
+ */
+extern void RegistersInit(Registers **registers);
+
+/**
+ * Zapisuje element w rejestrze o nazwie @p name, przejmując go na własność.
+ * Poprzednia zawartość rejestru jest usuwana.
+ * @param[in] registers : zbiór rejestrów
+ * @param[in] name : nazwa rejestru
+ * @param[in] item : element
+ */
+extern void RegistersStore(Registers *registers, const char *name, StackItem *item);
+
+/**
+ * Przekazuje współdzieloną kopię zawartości rejestru o nazwie @p name.
+ * @param[in] registers : zbiór rejestrów
+ * @param[in] name : nazwa rejestru
+ * @param[out] item : kopia zawartości rejestru
+ * @return Czy rejestr istnieje?
+ */
+extern bool RegistersLoad(Registers *registers, const char *name, StackItem *item);
+
+/**
+ * Usuwa zbiór rejestrów z pamięci (niszczy zawartość wszystkich rejestrów).
+ * @param[in] registers : zbiór rejestrów
+ */
+extern void RegistersClear(Registers **registers);
+
+#endif //POLYNOMIALS_REGISTERS_H
@@ -0,0 +1,265 @@
+/** @file
+ Implementacja serwera kalkulatora nasłuchującego na gnieździe uniksowym
+
+ Każde połączenie ma własny wątek z sesją i czytnikiem wierszy, więc czekanie na polecenia
+ jednego klienta nie wstrzymuje pozostałych. Wątków połączeń jest najwyżej
+ SERVER_MAX_CONNECTIONS; kolejne połączenia czekają w kolejce gniazda. Obliczenia są ograniczone pulą miejsc: wątek
+ połączenia zajmuje miejsce tylko na czas wykonania poleceń, które już przyszły, i zwalnia je,
+ zanim zacznie czekać na kolejne. Każde miejsce ma własną pamięć podręczną wyników, która
+ przechodzi między połączeniami, więc przetrwa ich zamknięcie.
+
+ @author Julia Karmowska
+ @date 2021
+*/
+
+/**
+ * Umożliwia działanie wątków POSIX, gniazd i fdopen.
+ */
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "server.h"
+#include "session.h"
+#include "cache.h"
+#include "memory.h"
+
+/**
+ * To jest stała reprezentująca maksymalną liczbę połączeń oczekujących na przyjęcie
+ */
+#define SERVER_BACKLOG 64
+
+/**
+ * To jest stała reprezentująca największą liczbę jednocześnie obsługiwanych połączeń
+ * (wątków połączeń); kolejne połączenia czekają w kolejce gniazda na zamknięcie któregoś z nich
+ */
+#define SERVER_MAX_CONNECTIONS 256
+
+/**
+ * To jest stała reprezentująca czas (w milisekundach), po którym serwer ponawia przyjęcie
+ * połączenia, gdy zabrakło deskryptorów, pamięci albo nie udało się utworzyć wątku
+ */
+#define SERVER_RETRY_MS 100
+
+/**
+ * Struktura opisująca serwer.
+ */
+typedef struct Server {
+    Cache **slots;          ///< pamięci podręczne wolnych miejsc w puli
+    size_t free_slots;      ///< liczba wolnych miejsc w puli
+    size_t connections;     ///< liczba działających wątków połączeń
+    bool lazy;              ///< czy sesje działają w trybie leniwym
+    pthread_mutex_t lock;   ///< chroni wolne miejsca i liczbę połączeń
+    pthread_cond_t waiting; ///< sygnalizuje zwolnienie miejsca
+    pthread_cond_t closed;  ///< sygnalizuje zakończenie wątku połączenia
+} Server;
+
+/**
+ * Struktura opisująca przyjęte połączenie przekazywane wątkowi połączenia.
+ */
+typedef struct Connection {
+    Server *server;         ///< serwer
+    int fd;                 ///< deskryptor gniazda połączenia
+} Connection;
+
+/**
+ * Zajmuje wolne miejsce w puli, czekając na nie, jeśli to konieczne, i przypisuje
+ * bieżącemu wątkowi jego pamięć podręczną wyników.
+ * @param[in] server : serwer
+ * @return pamięć podręczna zajętego miejsca
+ */
+static Cache *AcquireSlot(Server *server)
+{
+    pthread_mutex_lock(&server->lock);
+    while (server->free_slots == 0)
+        pthread_cond_wait(&server->waiting, &server->lock);
+    Cache *slot = server->slots[--server->free_slots];
+    pthread_mutex_unlock(&server->lock);
+    CacheBind(slot);
+    return slot;
+}
+
+/**
+ * Zwalnia miejsce w puli zajęte przez AcquireSlot.
+ * @param[in] server : serwer
+ * @param[in] slot : pamięć podręczna zajętego miejsca
+ */
+static void ReleaseSlot(Server *server, Cache *slot)
+{
+    CacheBind(NULL);
+    pthread_mutex_lock(&server->lock);
+    server->slots[server->free_slots++] = slot;
+    pthread_cond_signal(&server->waiting);
+    pthread_mutex_unlock(&server->lock);
+}
+
+/**
+ * Wykonuje polecenia klienta w nowej sesji aż do zamknięcia połączenia. Polecenia, które
+ * przyszły razem, są wykonywane w jednym zajęciu miejsca w puli.
+ * @param[in] server : serwer
+ * @param[in] fd : deskryptor gniazda połączenia
+ */
+static void Serve(Server *server, int fd)
+{
+    int out_fd = dup(fd);
+    FILE *out = out_fd < 0 ? NULL : fdopen(out_fd, "w");
+    if (out == NULL)
+    {
+        if (out_fd >= 0)
+            close(out_fd);
+        close(fd);
+        return;
+    }
+    Session session;
+    SessionInit(&session, out, out, server->lazy); //komunikaty o błędach trafiają do klienta razem z wynikami
+    InputReader *input;
+    InputOpen(&input, fd);
+    unsigned long line_number = 1;
+    bool open = true;
+    while (open)
+    {
+        InputWait(input); //czekanie na klienta nie zajmuje miejsca w puli
+        Cache *slot = AcquireSlot(server);
+        open = SessionRunReady(&session, input, &line_number);
+        ReleaseSlot(server, slot);
+    }
+    SessionDestroy(&session);
+    InputClose(&input);
+    fclose(out);
+    close(fd);
+}
+
+/**
+ * Treść wątku połączenia: obsługuje połączenie i kończy się po jego zamknięciu.
+ * @param[in] arg : połączenie
+ * @return NULL
+ */
+static void *ConnectionThread(void *arg)
+{
+    Connection connection = *(Connection *) arg;
+    free(arg);
+    Serve(connection.server, connection.fd);
+    pthread_mutex_lock(&connection.server->lock);
+    connection.server->connections--;
+    pthread_cond_signal(&connection.server->closed);
+    pthread_mutex_unlock(&connection.server->lock);
+    return NULL;
+}
+
+/**
+ * Wstrzymuje wątek przed ponowieniem przyjęcia połączenia.
+ */
+static void Backoff(void)
+{
+    struct timespec delay = {0, SERVER_RETRY_MS * 1000000L};
+    nanosleep(&delay, NULL);
+}
+
+/**
+ * Czeka, aż liczba działających wątków połączeń spadnie poniżej SERVER_MAX_CONNECTIONS,
+ * i rezerwuje miejsce dla kolejnego.
+ * @param[in] server : serwer
+ */
+static void ReserveConnection(Server *server)
+{
+    pthread_mutex_lock(&server->lock);
+    while (server->connections == SERVER_MAX_CONNECTIONS)
+        pthread_cond_wait(&server->closed, &server->lock);
+    server->connections++;
+    pthread_mutex_unlock(&server->lock);
+}
+
+/**
+ * Zwalnia miejsce zarezerwowane przez ReserveConnection, gdy wątek połączenia nie powstał.
+ * @param[in] server : serwer
+ */
+static void CancelConnection(Server *server)
+{
+    pthread_mutex_lock(&server->lock);
+    server->connections--;
+    pthread_mutex_unlock(&server->lock);
+}
+
+/**
+ * Tworzy gniazdo uniksowe nasłuchujące pod ścieżką @p path.
+ * @param[in] path : ścieżka gniazda
+ * @return deskryptor gniazda albo -1 w razie błędu
+ */
+static int Listen(const char *path)
+{
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path))
+        return -1;
+    strcpy(address.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    unlink(path);
+    if (bind(fd, (struct sockaddr *) &address, sizeof(address)) != 0 || listen(fd, SERVER_BACKLOG) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool ServerRun(const char *path, size_t jobs, bool lazy)
+{
+    int listen_fd = Listen(path);
+    if (listen_fd < 0)
+        return false;
+    signal(SIGPIPE, SIG_IGN); //klient może się rozłączyć przed odebraniem wyników
+
+    Server server = {NULL, jobs, 0, lazy, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+                     PTHREAD_COND_INITIALIZER};
+    server.slots = calloc(jobs, sizeof(Cache *));
+    CHECK_PTR(server.slots);
+    for (size_t i = 0; i < jobs; i++)
+        server.slots[i] = CacheNew();
+
+    while (true)
+    {
+        ReserveConnection(&server);
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0)
+        {
+            CancelConnection(&server);
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            //brak deskryptorów albo pamięci mija, gdy zamkną się inne połączenia
+            if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM)
+            {
+                Backoff();
+                continue;
+            }
+            close(listen_fd);
+            return false;
+        }
+        Connection *connection = malloc(sizeof(Connection));
+        CHECK_PTR(connection);
+        connection->server = &server;
+        connection->fd = fd;
+
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, ConnectionThread, connection) != 0)
+        {
+            //odrzucamy tylko to połączenie, a pozostałe sesje działają dalej
+            CancelConnection(&server);
+            free(connection);
+            close(fd);
+            Backoff();
+            continue;
+        }
+        pthread_detach(thread);
+    }
+}
@@ -0,0 +1,34 @@
+/** @file
+ Interfejs serwera kalkulatora nasłuchującego na gnieździe uniksowym
+
+ @author Julia Karmowska
+ @date 2021
+*/
+
+#ifndef POLYNOMIALS_SERVER_H
+#define POLYNOMIALS_SERVER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Nasłuchuje na gnieździe uniksowym o ścieżce @p path i obsługuje wszystkie połączenia
+ * jednocześnie, wykonując polecenia najwyżej @p jobs połączeń naraz.
+ * Każde połączenie ma własną sesję (stos i rejestry), która istnieje do jego zamknięcia.
+ * Klient wysyła polecenia w tym samym języku co na standardowym wejściu i może wysłać kolejne
+ * polecenia, nie czekając na odpowiedzi. Wyniki i komunikaty o błędach wracają tym samym
+ * połączeniem w kolejności poleceń. Połączenie zajmuje jedno z @p jobs miejsc tylko na czas
+ * wykonania poleceń, które już przyszły, więc klient czekający na wolne miejsce dostaje je,
+ * gdy tylko inny klient wykona swoje polecenia, a nie dopiero po jego rozłączeniu.
+ * Liczba jednocześnie otwartych połączeń jest ograniczona; kolejne czekają na przyjęcie
+ * w kolejce gniazda. Brak deskryptorów, pamięci albo wątku dla nowego połączenia nie kończy
+ * pracy serwera: połączenie jest odrzucane albo przyjmowane ponownie po chwili.
+ * Istniejący plik @p path jest usuwany. Funkcja kończy się tylko w razie błędu.
+ * @param[in] path : ścieżka gniazda
+ * @param[in] jobs : liczba połączeń wykonujących polecenia jednocześnie
+ * @param[in] lazy : czy sesje działają w trybie leniwym
+ * @return fałsz, jeśli nie udało się utworzyć gniazda albo gniazdo przestało przyjmować połączenia
+ */
+extern bool ServerRun(const char *path, size_t jobs, bool lazy);
+
+#endif //POLYNOMIALS_SERVER_H
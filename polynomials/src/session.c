@@ -0,0 +1,854 @@
+/** @file
+ Implementacja sesji kalkulatora działającego na wielomianach i stosującego ONP
+
+ @author Julia Karmowska
+ @date 2021
+*/
+
+#include <stdlib.h>
+#include "session.h"
+#include "pipeline.h"
+#include "expr.h"
+#include "cache.h"
+#include "snapshot.h"
+#include "memory.h"
+
+/**
+ * Wstawia na wierzchołek stosu wielomian. W trybie leniwym wstawia wyrażenie o znanej wartości,
+ * dzięki czemu równe wielomiany są współdzielone.
+ * @param[in] session : sesja kalkulatora
+ * @param[in] poly : wielomian
+ */
+static void PushResult(Session *session, Poly *poly)
+{
+    if (session->lazy)
+        StackPushExpr(ExprFromPoly(poly), &session->stack);
+    else
+        StackPush(poly, &session->stack);
+}
+
+/**
+ * Zdejmuje ze stosu @p count wyrażeń i wstawia na stos niewyliczone wyrażenie będące
+ * wynikiem operacji @p op. Pierwszym argumentem jest wierzchołek stosu. Dla EXPR_COMPOSE
+ * kolejne argumenty są ułożone od najgłębszego, tak jak tablica @f$q@f$ w PolyCompose.
+ * @param[in] session : sesja kalkulatora
+ * @param[in] op : operacja
+ * @param[in] count : liczba argumentów
+ */
+static void LazyApply(Session *session, ExprOp op, size_t count)
+{
+    Expr **args = calloc(count, sizeof(Expr *));
+    CHECK_PTR(args);
+    for (size_t i = 0; i < count; i++)
+    {
+        args[i] = StackTopExpr(session->stack);
+        StackPop(&session->stack);
+    }
+    if (op == EXPR_COMPOSE)
+    {
+        for (size_t i = 1, j = count - 1; i < j; i++, j--)
+        {
+            Expr *temp = args[i];
+            args[i] = args[j];
+            args[j] = temp;
+        }
+    }
+    StackPushExpr(ExprNew(op, count, args), &session->stack);
+    free(args);
+}
+
+/**
+ * Wstawia na wierzchołek stosu wielomian zerowy.
+ * @param[in] session : sesja kalkulatora
+ */
+void Zero(Session *session)
+{
+    Poly poly = PolyZero();
+    PushResult(session, &poly);
+}
+
+/**
+ * Sprawdza, czy na stosie jest co najmniej jeden wielomian - jeśli nie, wypisuje komunikat o niedomiarze wielomianów.
+ * @param[in] session : sesja kalkulatora
+ * @param[in] line_number : numer wiersza
+ * @param[in] how_many_needed : ile wielomianów jest potrzebnych do wykonania polecenia
+ * @return Czy na stosie jest jakiś wielomian?
+ */
+bool EnoughInStack(Session *session, unsigned long line_number, size_t how_many_needed)
+{
+    if (StackCount(session->stack) < how_many_needed)
+    {
+        fprintf(session->err, "ERROR %lu STACK UNDERFLOW\n", line_number);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Sprawdza, czy wielomian na wierzchołku stosu jest współczynnikiem – wypisuje 0 lub 1
+ * @param[in] session : sesja kalkulatora
+ * @param[in] line_number : numer wiersza
+ */
+void IsCoeff(Session *session, unsigned long line_number)
+{
+    if (EnoughInStack(session, line_number, 1))
+    {
+        bool result;
+        if (session->lazy)
+        {
+            Expr *top = StackTopExpr(session->stack);
+            result = ExprIsCoeff(top);
+            ExprRelease(top);
+        } else
+        {
+            Poly top = StackTop(session->stack);
+            result = PolyIsCoeff(&top);
+        }
+        if (result)
+            fprintf(session->out, "1\n");
+        else fprintf(session->out, "0\n");
+    }
+}
+
+/**
+ * Sprawdza, czy wielomian na wierzchołku stosu jest tożsamościowo równy zeru – wypisuje 0 lub 1.
+ * @param[in] session : sesja kalkulatora
+ * @param[in] line_number : numer wiersza
+ */
+void IsZero(Session *session, unsigned long line_number)
+{
+    if (EnoughInStack(session, line_number, 1))
+    {
+        bool result;
+        if (session->lazy)
+        {
+            Expr *top = StackTopExpr(session->stack);
+            result = ExprIsZero(top);
+            ExprRelease(top);
+        } else
+        {
+            Poly top = StackTop(session->stack);
+            result = PolyIsZero(&top);
+        }
+        if (result)
+            fprintf(session->out, "1\n");
+        else fprintf(session->out, "0\n");
+    }
+}
+
+/**
+ * Wstawia na stos kopię wielomianu z wierzchołka.
+ * @param[in] session : sesja kalkulatora
+ * @param[in] line_number : numer wiersza
+ */
+void Clone(Session *session, unsigned long line_number)
+{
+    if (EnoughInStack(session, line_number, 1))
+    {
+        if (session->lazy)
+        {
+            StackPushExpr(StackTopExpr(session->stack), &session->stack);
+            return;
+        }
+        Poly top = StackTop(session->stack);
+        Poly new = PolyShare(&top); //wielomiany nie są modyfikowane, więc kopia może być współdzielona
+        StackPush(&new, &session->stack);
+    }
+}
+
+/**
+ * Dodaje dwa wielomiany z wierzchu stosu, usuwa je i wstawia na wierzchołek stosu ich iloczyn.
+ * @param[in] session : sesja kalkulatora
+ * @param[in] line_number : numer wiersza
+ */
+void Add(Session *session, unsigned long line_number)
+{
+    if (EnoughInStack(session, line_number, 2))
+    {
+        if (session->lazy)
+        {
+            LazyApply(session, EXPR_ADD, 2);
+            return;
+        }
+        Poly first = StackAt(session->stack, 0);
+        Poly second = StackAt(session->stack, 1);
+        Poly res = PolyAdd(&first, &second); //argumenty są zdejmowane dopiero po obliczeniu, więc nie trzeba ich kopiować
+        StackPop(&session->stack);
+        StackPop(&session->stack);
+        StackPush(&res, &session->stack);
+    }
+}
+
+/**
+ * Mnoży dwa wielomiany z wierzchu stosu, usuwa je i wstawia na wierzchołek stosu ich iloczyn.
+ * @param[in] session : sesja kalkulatora
+ * @param[in] line_number : numer wiersza
+ */
+void Mul(Session *session, unsigned long line_number)
+{
+    if (EnoughInStack(session, line_number, 2))
+    {
+        if (session->lazy)
+        {
+            LazyApply(session, EXPR_MUL, 2);
+            return;
+        }
+        Poly first = StackAt(session->stack, 0);
+        Poly second = StackAt(session->stack, 1);
+        Poly res = CachedMul(&first, &second);
+        StackPop(&session->stack);
+        StackPop(&session->stack);
+        StackPush(&res, &session->stack);
+    }
+
+}
+
+/**
+ * Neguje wielomian na wierzchołku stosu.
+ * @param[in] session : sesja kalkulatora
+ * @param[in] line_number : numer wiersza
+ */
+void Neg(Session *session, unsigned long line_number)
+{
+    if (EnoughInStack(session, line_number, 1))
+    {
+        if (session->lazy)
+        {
+            LazyApply(session, EXPR_NEG, 1);
+            return;
+        }
+        Poly top = StackTop(session->stack);
+        Poly neg = PolyNeg(&top);
+        StackPop(&session->stack);
+        StackPush(&neg, &session->stack);
+    }
+}
+
+/**
+ * Odejmuje od wielomianu z wierzchołka wielomian pod wierzchołkiem, usuwa je i wstawia na wierzchołek stosu różnicę.
+ * @param[in] session : sesja kalkulatora
+ * @param[in] line_number : numer wiersza
+ */
+void Sub(Session *session, unsigned long line_number)
+{
+    if (EnoughInStack(session, line_number, 2))
+    {
+        if (session->lazy)
+        {
+            LazyApply(session, EXPR_SUB, 2);
+            return;
+        }
+        Poly first = StackAt(session->stack, 0);
+        Poly second = StackAt(session->stack, 1);
+        Poly res = PolySub(&first, &second); //argumenty są zdejmowane dopiero po obliczeniu, więc nie trzeba ich kopiować
+        StackPop(&session->stack);
+        StackPop(&session->stack);
+        StackPush(&res, &session->stack);
+    }
+}
+
+/**
+ * Sprawdza, czy dwa wielomiany na wierzchu stosu są równe – wypisuje 0 lub 1.
+ * @param[in] session : sesja kalkulatora
+ * @param[in] line_number : numer wiersza
+ */
+void IsEq(Session *session, unsigned long line_number)
+{
+    if (EnoughInStack(session, line_number, 2))
+    {
+        Poly first = StackTop(session->stack);
+        Poly second = StackAt(session->stack, 1);
+        if (PolyIsEq(&first, &second))
+            fprintf(session->out, "1\n");
+        else fprintf(session->out, "0\n");
+    }
+}
+
+/**
+ * Sprawdza probabilistycznie, czy iloczyn dwóch wielomianów z wierzchu stosu jest równy
+ * trzeciemu wielomianowi od góry – wypisuje 0 lub 1. Nie wyznacza iloczynu.
+ * @param[in] session : sesja kalkulatora
+ * @param[in] line_number : numer wiersza
+ */
+void IsEqMul(Session *session, unsigned long line_number)
+{
+    if (EnoughInStack(session, line_number, 3))
+    {
+        Poly first = StackAt(session->stack, 0);
+        Poly second = StackAt(session->stack, 1);
+        Poly third = StackAt(session->stack, 2);
+        if (PolyIsEqMul(&first, &second, &third))
+            fprintf(session->out, "1\n");
+        else fprintf(session->out, "0\n");
+    }
+}
+
+/**
+ * Wypisuje stopień wielomianu z wierzchołka stosu.
+ * @param[in] session : sesja kalkulatora
+ * @param[in] line_number : numer wiersza
+ */
+void Deg(Session *session, unsigned long line_number)
+{
+    if (EnoughInStack(session, line_number, 1))
+    {
+        poly_exp_t deg;
+        if (session->lazy)
+        {
+            Expr *top = StackTopExpr(session->stack);
+            deg = ExprDeg(top);
+            ExprRelease(top);
+        } else
+        {
+            Poly top = StackTop(session->stack);
+            deg = PolyDeg(&top);
+        }
+        fprintf(session->out, "%d\n", deg);
+    }
+}
+
+/**
+ * Wypisuje stopień wielomianu z wierzchołka stosu ze względu na zmienną o podanym numerze.
+ * @param[in] session : sesja kalkulatora
+ * @param[in] deg_by_var : numer zmiennej
+ * @param[in] line_number : numer wiersza
+ */
+void DegBy(Session *session, unsigned long deg_by_var, unsigned long line_number)
+{
+    if (EnoughInStack(session, line_number, 1))
+    {
+        Poly top = StackTop(session->stack);
+        poly_exp_t deg = PolyDegBy(&top, deg_by_var);
+        fprintf(session->out, "%d\n", deg);
+    }
+}
+
+
+/**
+ * Wylicza wartość wielomianu w punkcie, usuwa wielomian z wierzchołka i wstawia na stos wynik operacji.
+ * @param[in] session : sesja kalkulatora
+ * @param[in] at_val : punkt, dla którego wyliczana jest wartość wielomianu
+ * @param[in] line_number : numer wiersza
+ */
+void At(Session *session, long at_val, unsigned long line_number)
+{
+    if (EnoughInStack(session, line_number, 1))
+    {
+        Poly top = StackTop(session->stack);
+        Poly new = PolyAt(&top, at_val);
+        StackPop(&session->stack);
+        PushResult(session, &new);
+    }
+}
+
+/**
+ * Wypisuje wielomian z wierzchołka stosu.
+ * @param[in] session : sesja kalkulatora
+ * @param[in] line_number : numer wiersza
+ */
+void Print(Session *session, unsigned long line_number)
+{
+    if (EnoughInStack(session, line_number, 1))
+    {
+        Poly top = StackTop(session->stack);
+        PolyWrite(&session->writer, &top);
+        PolyWriterPutChar(&session->writer, '\n');
+        PolyWriterFlush(&session->writer); //pozostałe polecenia piszą przez fprintf, więc zachowujemy kolejność
+    }
+}
+
+/**
+ * Zdejmuje wielomian ze stosu.
+ * @param[in] session : sesja kalkulatora
+ * @param[in] line_number : numer wiersza
+ */
+void Pop(Session *session, unsigned long line_number)
+{
+    if (EnoughInStack(session, line_number, 1))
+        StackPop(&session->stack);
+}
+
+/**
+ * Zastępuje wielomian z wierzchołka stosu równym mu wielomianem zamrożonym (PolyFreeze).
+ * @param[in] session : sesja kalkulatora
+ * @param[in] line_number : numer wiersza
+ */
+void Freeze(Session *session, unsigned long line_number)
+{
+    if (EnoughInStack(session, line_number, 1))
+    {
+        if (session->lazy)
+        {
+            Expr *top = StackTopExpr(session->stack);
+            ExprFreeze(top);
+            ExprRelease(top);
+            return;
+        }
+        Poly top = StackTop(session->stack);
+        Poly frozen = PolyFreeze(&top);
+        StackPop(&session->stack);
+        StackPush(&frozen, &session->stack);
+    }
+}
+
+/**
+ * Zapisuje w rejestrze o nazwie @p name współdzieloną kopię wielomianu z wierzchołka stosu.
+ * Wielomian pozostaje na stosie.
+ * @param[in] session : sesja kalkulatora
+ * @param[in] name : nazwa rejestru
+ * @param[in] line_number : numer wiersza
+ */
+void Store(Session *session, const char *name, unsigned long line_number)
+{
+    if (EnoughInStack(session, line_number, 1))
+    {
+        StackItem item = StackTopItem(session->stack);
+        RegistersStore(session->registers, name, &item);
+    }
+}
+
+/**
+ * Wstawia na stos współdzieloną kopię wielomianu z rejestru o nazwie @p name.
+ * @param[in] session : sesja kalkulatora
+ * @param[in] name : nazwa rejestru
+ * @param[in] line_number : numer wiersza
+ */
+void Load(Session *session, const char *name, unsigned long line_number)
+{
+    StackItem item;
+    if (RegistersLoad(session->registers, name, &item))
+        StackPushItem(&item, &session->stack);
+    else
+        fprintf(session->err, "ERROR %lu LOAD UNKNOWN REGISTER\n", line_number);
+}
+
+/**
+ * Zapisuje wielomian z wierzchołka stosu do pliku o ścieżce @p path w postaci binarnej.
+ * Wielomian pozostaje na stosie.
+ * @param[in] session : sesja kalkulatora
+ * @param[in] path : ścieżka pliku
+ * @param[in] line_number : numer wiersza
+ */
+void Save(Session *session, const char *path, unsigned long line_number)
+{
+    if (EnoughInStack(session, line_number, 1))
+    {
+        Poly top = StackTop(session->stack);
+        if (!SnapshotSave(path, 1, &top))
+            fprintf(session->err, "ERROR %lu SAVE FAILED\n", line_number);
+    }
+}
+
+/**
+ * Zapisuje cały stos do pliku o ścieżce @p path w postaci binarnej, od najgłębszego wielomianu.
+ * @param[in] session : sesja kalkulatora
+ * @param[in] path : ścieżka pliku
+ * @param[in] line_number : numer wiersza
+ */
+void SaveStack(Session *session, const char *path, unsigned long line_number)
+{
+    size_t count = StackCount(session->stack);
+    Poly *polys = malloc((count > 0 ? count : 1) * sizeof(Poly));
+    CHECK_PTR(polys);
+    for (size_t i = 0; i < count; i++)
+        polys[i] = StackAt(session->stack, count - 1 - i);
+    if (!SnapshotSave(path, count, polys))
+        fprintf(session->err, "ERROR %lu SAVE STACK FAILED\n", line_number);
+    free(polys);
+}
+
+/**
+ * Wstawia na stos wszystkie wielomiany z pliku zapisanego poleceniem SAVE lub SAVE_STACK,
+ * w kolejności zapisu, więc odtworzony stos ma ostatni zapisany wielomian na wierzchołku.
+ * @param[in] session : sesja kalkulatora
+ * @param[in] path : ścieżka pliku
+ * @param[in] line_number : numer wiersza
+ */
+void Restore(Session *session, const char *path, unsigned long line_number)
+{
+    size_t count;
+    Poly *polys;
+    if (!SnapshotLoad(path, &count, &polys))
+    {
+        fprintf(session->err, "ERROR %lu RESTORE FAILED\n", line_number);
+        return;
+    }
+    for (size_t i = 0; i < count; i++)
+        PushResult(session, &polys[i]);
+    free(polys);
+}
+
+/**
+ * Zapisuje obraz wielomianu z wierzchołka stosu do pliku o ścieżce @p path.
+ * Wielomian pozostaje na stosie.
+ * @param[in] session : sesja kalkulatora
+ * @param[in] path : ścieżka pliku
+ * @param[in] line_number : numer wiersza
+ */
+void SaveImage(Session *session, const char *path, unsigned long line_number)
+{
+    if (EnoughInStack(session, line_number, 1))
+    {
+        Poly top = StackTop(session->stack);
+        if (!ImageSave(path, &top))
+            fprintf(session->err, "ERROR %lu SAVE IMAGE FAILED\n", line_number);
+    }
+}
+
+/**
+ * Odwzorowuje w pamięci obraz wielomianu z pliku o ścieżce @p path i wstawia wielomian na stos.
+ * @param[in] session : sesja kalkulatora
+ * @param[in] path : ścieżka pliku
+ * @param[in] line_number : numer wiersza
+ */
+void Map(Session *session, const char *path, unsigned long line_number)
+{
+    Poly poly;
+    ImageMapResult result = ImageMap(path, &poly);
+    if (result == IMAGE_MAPPED)
+        PushResult(session, &poly);
+    else if (result == IMAGE_WRONG_FILE) //uszkodzony obraz jest odrzucany jak błędna nazwa pliku
+        fprintf(session->err, "ERROR %lu MAP WRONG FILE\n", line_number);
+    else
+        fprintf(session->err, "ERROR %lu MAP FAILED\n", line_number);
+}
+
+/**
+ * Wczytuje wielomian z pliku z listą składników o ścieżce @p path i wstawia go na stos.
+ * @param[in] session : sesja kalkulatora
+ * @param[in] path : ścieżka pliku
+ * @param[in] line_number : numer wiersza
+ */
+void LoadTerms(Session *session, const char *path, unsigned long line_number)
+{
+    Poly poly;
+    if (TermsLoad(path, &poly))
+        PushResult(session, &poly);
+    else
+        fprintf(session->err, "ERROR %lu LOAD TERMS FAILED\n", line_number);
+}
+
+/**
+ * Dodaje wielomian na stos.
+ * @param[in] session : sesja kalkulatora
+ * @param[in] poly : wielomian
+ */
+void NewPoly(Session *session, Poly *poly)
+{
+    PushResult(session, poly);
+}
+
+/**
+ * Zdejmuje z wierzchołka stosu najpierw wielomian p, a potem kolejno wielomiany
+ * q[k - 1], q[k - 2], …, q[0] i umieszcza na stosie wynik operacji złożenia.
+ * @param[in] session : sesja kalkulatora
+ * @param[in] k : liczba wielomianów do zdjęcia ze stosu, nie wliczając pierwszego
+ * @param[in] line_number : numer wiersza
+ */
+void Compose(Session *session, size_t k, unsigned long line_number)
+{
+    if (StackCount(session->stack) == 0 || StackCount(session->stack) - 1 < k)//nie używam EnoughInStack, bo k+1 może spowodować overflow
+    {
+        fprintf(session->err, "ERROR %lu STACK UNDERFLOW\n", line_number);
+        return;
+    }
+    if (session->lazy)
+    {
+        LazyApply(session, EXPR_COMPOSE, k + 1);
+        return;
+    }
+
+    Poly p = StackTop(session->stack);
+    Poly *q = calloc(k, sizeof(Poly));
+    assert(q);
+    for (size_t i = 1; i <= k; i++)
+        q[k - i] = StackAt(session->stack, i);
+
+    Poly res = CachedCompose(&p, k, q);
+    for (size_t i = 0; i <= k; i++)
+        StackPop(&session->stack);
+    StackPush(&res, &session->stack);
+    free(q);
+
+}
+
+/**
+ * Przenumerowuje co najwyżej @p k pierwszych zmiennych wielomianu z wierzchołka stosu tak,
+ * aby zmniejszyć jego reprezentację (PolyBestVarOrder), zastępuje go wynikiem i wypisuje
+ * nowe numery zmiennych @f$x_0, x_1, …@f$ (tylko tych, od których wielomian zależy).
+ * Jeśli nie ma czego przenumerować (wielomian stały albo @p k równe 0), nic nie wypisuje.
+ * @param[in] session : sesja kalkulatora
+ * @param[in] k : liczba przenumerowywanych zmiennych
+ * @param[in] line_number : numer wiersza
+ */
+void Reorder(Session *session, size_t k, unsigned long line_number)
+{
+    if (EnoughInStack(session, line_number, 1))
+    {
+        Poly top = StackTop(session->stack);
+        size_t count = PolyVarCount(&top);
+        if (k < count)
+            count = k;
+        if (count == 0) //wielomian pozostaje bez zmian
+            return;
+        size_t *perm = malloc(count * sizeof(size_t));
+        CHECK_PTR(perm);
+        PolyBestVarOrder(&top, count, perm);
+        Poly reordered = PolyPermuteVars(&top, count, perm);
+        StackPop(&session->stack);
+        PushResult(session, &reordered);
+        for (size_t i = 0; i < count; i++)
+            fprintf(session->out, i == 0 ? "%zu" : " %zu", perm[i]);
+        fprintf(session->out, "\n");
+        free(perm);
+    }
+}
+
+/**
+ * Podstawia wartości pod wybrane zmienne wielomianu z wierzchołka stosu (PolyPartialEval),
+ * bez przenumerowywania pozostałych zmiennych, i zastępuje go wynikiem. Jeśli zmienna
+ * powtarza się, obowiązuje ostatnia wartość.
+ * @param[in] session : sesja kalkulatora
+ * @param[in] subst : numery i wartości zmiennych
+ * @param[in] line_number : numer wiersza
+ */
+void Subst(Session *session, const SubstParameter *subst, unsigned long line_number)
+{
+    if (EnoughInStack(session, line_number, 1))
+    {
+        Poly top = StackTop(session->stack);
+        size_t k = PolyVarCount(&top); //pozostałe zmienne nie występują w wielomianie
+        bool *mask = calloc(k > 0 ? k : 1, sizeof(bool));
+        poly_coeff_t *values = malloc((k > 0 ? k : 1) * sizeof(poly_coeff_t));
+        CHECK_PTR(mask);
+        CHECK_PTR(values);
+        for (size_t i = 0; i < subst->count; i++)
+        {
+            if (subst->vars[i] < k)
+            {
+                mask[subst->vars[i]] = true;
+                values[subst->vars[i]] = subst->values[i];
+            }
+        }
+        Poly res = PolyPartialEval(&top, k, mask, values);
+        StackPop(&session->stack);
+        PushResult(session, &res);
+        free(mask);
+        free(values);
+    }
+}
+
+/**
+ * Wykonuje operację zgodną z typem wiersza. Jeśli wiersz był wielomianem, dodaje wielomian na stos.
+ * Jeśli wiersz był poleceniem, wykonuje to polecenie.
+ * Jeśli wiersz był błędny, wypisuje odpowiedni komunikat.
+ * @param[in] session : sesja kalkulatora
+ * @param[in] line_number : numer wiersza
+ * @param[in] type : typ wiersza
+ * @param[in] instruction_var : parametr polecenia DEG_BY, AT, COMPOSE, STORE, LOAD, SAVE, SAVE_STACK, RESTORE, SAVE_IMAGE, MAP, REORDER, SUBST lub LOAD_TERMS lub wielomian
+ */
+void Calculate(Session *session, unsigned long line_number, LineType type, InstructionVar instruction_var)
+{
+    switch (type)
+    {
+        case WRONG_POLY:
+            fprintf(session->err, "ERROR %lu WRONG POLY\n", line_number);
+            break;
+        case WRONG_COMMAND:
+            fprintf(session->err, "ERROR %lu WRONG COMMAND\n", line_number);
+            break;
+        case DEG_BY_WRONG_VARIABLE:
+            fprintf(session->err, "ERROR %lu DEG BY WRONG VARIABLE\n", line_number);
+            break;
+        case AT_WRONG_VALUE:
+            fprintf(session->err, "ERROR %lu AT WRONG VALUE\n", line_number);
+            break;
+        case COMPOSE_WRONG_PARAMETER:
+            fprintf(session->err, "ERROR %lu COMPOSE WRONG PARAMETER\n", line_number);
+            break;
+        case STORE_WRONG_NAME:
+            fprintf(session->err, "ERROR %lu STORE WRONG NAME\n", line_number);
+            break;
+        case LOAD_WRONG_NAME:
+            fprintf(session->err, "ERROR %lu LOAD WRONG NAME\n", line_number);
+            break;
+        case SAVE_WRONG_FILE:
+            fprintf(session->err, "ERROR %lu SAVE WRONG FILE\n", line_number);
+            break;
+        case SAVE_STACK_WRONG_FILE:
+            fprintf(session->err, "ERROR %lu SAVE STACK WRONG FILE\n", line_number);
+            break;
+        case RESTORE_WRONG_FILE:
+            fprintf(session->err, "ERROR %lu RESTORE WRONG FILE\n", line_number);
+            break;
+        case SAVE_IMAGE_WRONG_FILE:
+            fprintf(session->err, "ERROR %lu SAVE IMAGE WRONG FILE\n", line_number);
+            break;
+        case MAP_WRONG_FILE:
+            fprintf(session->err, "ERROR %lu MAP WRONG FILE\n", line_number);
+            break;
+        case REORDER_WRONG_PARAMETER:
+            fprintf(session->err, "ERROR %lu REORDER WRONG PARAMETER\n", line_number);
+            break;
+        case SUBST_WRONG_PARAMETER:
+            fprintf(session->err, "ERROR %lu SUBST WRONG PARAMETER\n", line_number);
+            break;
+        case LOAD_TERMS_WRONG_FILE:
+            fprintf(session->err, "ERROR %lu LOAD TERMS WRONG FILE\n", line_number);
+            break;
+        case ZERO:
+            Zero(session);
+            break;
+        case IS_COEFF:
+            IsCoeff(session, line_number);
+            break;
+        case IS_ZERO:
+            IsZero(session, line_number);
+            break;
+        case CLONE:
+            Clone(session, line_number);
+            break;
+        case ADD:
+            Add(session, line_number);
+            break;
+        case MUL:
+            Mul(session, line_number);
+            break;
+        case NEG:
+            Neg(session, line_number);
+            break;
+        case SUB:
+            Sub(session, line_number);
+            break;
+        case IS_EQ:
+            IsEq(session, line_number);
+            break;
+        case DEG:
+            Deg(session, line_number);
+            break;
+        case DEG_BY:
+            DegBy(session, instruction_var.deg_by_var, line_number);
+            break;
+        case AT:
+            At(session, instruction_var.at_val, line_number);
+            break;
+        case PRINT:
+            Print(session, line_number);
+            break;
+        case POP:
+            Pop(session, line_number);
+            break;
+        case POLY:
+            NewPoly(session, &instruction_var.poly);
+            break;
+        case COMPOSE:
+            Compose(session, instruction_var.compose_parameter, line_number);
+            break;
+        case IS_EQ_MUL:
+            IsEqMul(session, line_number);
+            break;
+        case FREEZE:
+            Freeze(session, line_number);
+            break;
+        case STORE:
+            Store(session, instruction_var.name, line_number);
+            free(instruction_var.name);
+            break;
+        case LOAD:
+            Load(session, instruction_var.name, line_number);
+            free(instruction_var.name);
+            break;
+        case SAVE:
+            Save(session, instruction_var.name, line_number);
+            free(instruction_var.name);
+            break;
+        case SAVE_STACK:
+            SaveStack(session, instruction_var.name, line_number);
+            free(instruction_var.name);
+            break;
+        case RESTORE:
+            Restore(session, instruction_var.name, line_number);
+            free(instruction_var.name);
+            break;
+        case SAVE_IMAGE:
+            SaveImage(session, instruction_var.name, line_number);
+            free(instruction_var.name);
+            break;
+        case MAP:
+            Map(session, instruction_var.name, line_number);
+            free(instruction_var.name);
+            break;
+        case REORDER:
+            Reorder(session, instruction_var.reorder_parameter, line_number);
+            break;
+        case SUBST:
+            Subst(session, &instruction_var.subst, line_number);
+            free(instruction_var.subst.vars);
+            free(instruction_var.subst.values);
+            break;
+        case LOAD_TERMS:
+            LoadTerms(session, instruction_var.name, line_number);
+            free(instruction_var.name);
+            break;
+        default:
+            break;
+    }
+}
+
+void SessionInit(Session *session, FILE *out, FILE *err, bool lazy)
+{
+    StackInit(&session->stack);
+    RegistersInit(&session->registers);
+    PolyWriterInit(&session->writer, out);
+    session->out = out;
+    session->err = err;
+    session->lazy = lazy;
+}
+
+void SessionRun(Session *session, InputReader *input, bool pipelined)
+{
+    unsigned long line_number;
+    ParseResult parse_res;
+    if (pipelined)
+    {
+        Pipeline *pipeline; //wiersze są wczytywane w osobnym wątku, równolegle z obliczeniami
+        PipelineStart(&pipeline, input);
+        parse_res = PipelineNext(pipeline, &line_number);
+        while (parse_res.type != END_OF_FILE)
+        {
+            Calculate(session, line_number, parse_res.type, parse_res.variable);
+            parse_res = PipelineNext(pipeline, &line_number);
+        }
+        PipelineStop(&pipeline);
+        return;
+    }
+    line_number = 1;
+    do
+        InputWait(input);
+    while (SessionRunReady(session, input, &line_number));
+}
+
+bool SessionRunReady(Session *session, InputReader *input, unsigned long *line_number)
+{
+    while (InputReady(input))
+    {
+        ParseResult parse_res = ParseLine(input);
+        if (parse_res.type == END_OF_FILE)
+        {
+            fflush(session->out);
+            return false;
+        }
+        if (parse_res.type != IGNORED_LINE)
+            Calculate(session, *line_number, parse_res.type, parse_res.variable);
+        (*line_number)++;
+    }
+    fflush(session->out); //odpowiedzi muszą dotrzeć do klienta, zanim zaczekamy na kolejne polecenia
+    return true;
+}
+
+void SessionDestroy(Session *session)
+{
+    StackClear(&session->stack);
+    RegistersClear(&session->registers);
+    PolyWriterDestroy(&session->writer);
+}
@@ -0,0 +1,70 @@
+/** @file
+ Interfejs sesji kalkulatora działającego na wielomianach i stosującego ONP
+
+ @author Julia Karmowska
+ @date 2021
+*/
+
+#ifndef POLYNOMIALS_SESSION_H
+#define POLYNOMIALS_SESSION_H
+
+#include <stdio.h>
+#include "stack.h"
+#include "registers.h"
+#include "parser.h"
+
+/**
+ * Struktura opisująca sesję kalkulatora: stos, rejestry i strumienie, do których trafiają
+ * wyniki i komunikaty o błędach. Niezależne sesje mogą działać w osobnych wątkach,
+ * ale jednej sesji może używać tylko jeden wątek.
+ */
+typedef struct Session {
+    Stack *stack;           ///< stos wielomianów
+    Registers *registers;   ///< nazwane rejestry (polecenia STORE i LOAD)
+    PolyWriter writer;      ///< bufor, przez który polecenie PRINT wypisuje wielomiany
+    FILE *out;              ///< strumień wyników
+    FILE *err;              ///< strumień komunikatów o błędach
+    bool lazy;              ///< czy sesja działa w trybie leniwym
+} Session;
+
+/**
+ * Tworzy sesję z pustym stosem i pustymi rejestrami. W trybie leniwym ADD, MUL, SUB, NEG
+ * i COMPOSE nie wyliczają wyników, tylko wstawiają na stos wyrażenia, które są wyliczane
+ * dopiero wtedy, gdy polecenie potrzebuje wartości wielomianu.
+ * @param[in] session : sesja
+ * @param[in] out : strumień wyników
+ * @param[in] err : strumień komunikatów o błędach
+ * @param[in] lazy : czy włączyć tryb leniwy
+ */
+extern void SessionInit(Session *session, FILE *out, FILE *err, bool lazy);
+
+/**
+ * Wczytuje z czytnika wiersze aż do końca danych i wykonuje zgodne z nimi operacje.
+ * Jeśli wiersze nie są wczytywane w osobnym wątku, strumień wyników jest opróżniany, zanim
+ * czytnik zacznie czekać na kolejne dane, więc klient interaktywny dostaje odpowiedzi
+ * na wszystkie wysłane polecenia.
+ * @param[in] session : sesja
+ * @param[in] input : czytnik wierszy
+ * @param[in] pipelined : czy wczytywać wiersze w osobnym wątku, równolegle z obliczeniami
+ */
+extern void SessionRun(Session *session, InputReader *input, bool pipelined);
+
+/**
+ * Wykonuje polecenia z wierszy, które czytnik może przekazać bez czekania na dane ze źródła,
+ * a potem opróżnia strumień wyników. Razem z InputWait pozwala wykonywać polecenia partiami
+ * i nie zajmować wątku obliczeń w czasie czekania na klienta.
+ * @param[in] session : sesja
+ * @param[in] input : czytnik wierszy
+ * @param[in,out] line_number : numer kolejnego wiersza
+ * @return Czy dane jeszcze się nie skończyły?
+ */
+extern bool SessionRunReady(Session *session, InputReader *input, unsigned long *line_number);
+
+/**
+ * Usuwa z pamięci stos i rejestry sesji oraz opróżnia bufor wyników.
+ * Strumienie sesji nie są zamykane.
+ * @param[in] session : sesja
+ */
+extern void SessionDestroy(Session *session);
+
+#endif //POLYNOMIALS_SESSION_H
@@ -0,0 +1,345 @@
+/** @file
+ Implementacja plików z binarnym zapisem wielomianów
+
+ Plik zaczyna się nagłówkiem SNAPSHOT_MAGIC, po którym leżą kolejno wielomiany
+ zapisane przez PolyWriteBinary. Pliki z listą składników są tekstowe i są wczytywane
+ przez PolyBuilder. Obrazy wielomianów (PolyWriteImage) są odwzorowywane
+ w pamięci i zapamiętywane na liście, dzięki czemu ten sam plik jest odwzorowywany tylko raz.
+
+ @author Julia Karmowska
+ @date 2021
+*/
+
+/**
+ * Umożliwia działanie funkcji mmap, madvise i muteksów POSIX.
+ */
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "snapshot.h"
+#include "memory.h"
+
+/**
+ * To jest stała reprezentująca nagłówek pliku (z numerem wersji formatu)
+ */
+#define SNAPSHOT_MAGIC "POLYBIN1"
+
+/**
+ * To jest stała reprezentująca długość nagłówka pliku
+ */
+#define SNAPSHOT_MAGIC_LENGTH 8
+
+/**
+ * To jest stała reprezentująca przyrostek nazwy pliku, do którego zapisywany jest obraz
+ */
+#define IMAGE_TEMP_SUFFIX ".tmp"
+
+/**
+ * Struktura opisująca odwzorowany obraz wielomianu.
+ */
+typedef struct MappedImage {
+    dev_t device;               ///< urządzenie pliku
+    ino_t inode;                ///< numer i-węzła pliku
+    struct timespec modified;   ///< czas modyfikacji pliku
+    off_t size;                 ///< rozmiar pliku
+    Poly poly;                  ///< wielomian leżący w obrazie
+    struct MappedImage *next;   ///< następny obraz na liście
+} MappedImage;
+
+/**
+ * Lista odwzorowanych obrazów.
+ */
+static MappedImage *images = NULL;
+
+/**
+ * Muteks chroniący listę odwzorowanych obrazów.
+ */
+static pthread_mutex_t images_lock = PTHREAD_MUTEX_INITIALIZER;
+
+bool SnapshotSave(const char *path, size_t count, const Poly polys[])
+{
+    FILE *out = fopen(path, "wb");
+    if (out == NULL)
+        return false;
+    PolyWriter writer;
+    PolyWriterInit(&writer, out);
+    for (size_t i = 0; i < SNAPSHOT_MAGIC_LENGTH; i++)
+        PolyWriterPutChar(&writer, SNAPSHOT_MAGIC[i]);
+    for (size_t i = 0; i < count; i++)
+        PolyWriteBinary(&writer, &polys[i]);
+    PolyWriterDestroy(&writer);
+    bool written = !ferror(out);
+    return fclose(out) == 0 && written;
+}
+
+/**
+ * Odczytuje wielomiany z danych pliku (bez nagłówka).
+ * @param[in] data : dane
+ * @param[in] size : liczba bajtów danych
+ * @param[out] count : liczba odczytanych wielomianów
+ * @param[out] polys : tablica odczytanych wielomianów
+ * @return Czy dane są poprawne?
+ */
+static bool ReadPolys(const unsigned char *data, size_t size, size_t *count, Poly **polys)
+{
+    size_t used = 0;
+    size_t polys_size = INITIAL_ARRAY_SIZE;
+    Poly *result = malloc(polys_size * sizeof(Poly));
+    CHECK_PTR(result);
+    while (size > 0)
+    {
+        if (used == polys_size)
+        {
+            polys_size *= 2;
+            result = realloc(result, polys_size * sizeof(Poly));
+            CHECK_PTR(result);
+        }
+        size_t read = PolyReadBinary(data, size, &result[used]);
+        if (read == 0)
+        {
+            for (size_t i = 0; i < used; i++)
+                PolyDestroy(&result[i]);
+            free(result);
+            return false;
+        }
+        used++;
+        data += read;
+        size -= read;
+    }
+    *count = used;
+    *polys = result;
+    return true;
+}
+
+bool SnapshotLoad(const char *path, size_t *count, Poly **polys)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size < SNAPSHOT_MAGIC_LENGTH)
+    {
+        close(fd);
+        return false;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+    const unsigned char *data = map;
+    bool correct = memcmp(data, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_LENGTH) == 0 &&
+                   ReadPolys(data + SNAPSHOT_MAGIC_LENGTH, st.st_size - SNAPSHOT_MAGIC_LENGTH, count, polys);
+    munmap(map, st.st_size);
+    return correct;
+}
+
+bool ImageSave(const char *path, const Poly *p)
+{
+    //obraz jest zapisywany do pliku tymczasowego i podmieniany, aby nie zmienić pliku,
+    //który może być odwzorowany w pamięci
+    size_t length = strlen(path);
+    char *temp_path = malloc(length + sizeof(IMAGE_TEMP_SUFFIX));
+    CHECK_PTR(temp_path);
+    memcpy(temp_path, path, length);
+    memcpy(temp_path + length, IMAGE_TEMP_SUFFIX, sizeof(IMAGE_TEMP_SUFFIX));
+    FILE *out = fopen(temp_path, "wb");
+    bool written = out != NULL && PolyWriteImage(out, p);
+    written = out != NULL && fclose(out) == 0 && written;
+    if (written)
+        written = rename(temp_path, path) == 0;
+    if (!written)
+        unlink(temp_path);
+    free(temp_path);
+    return written;
+}
+
+/**
+ * Szuka na liście obrazu odwzorowanego z pliku o podanych atrybutach.
+ * @param[in] st : atrybuty pliku
+ * @return obraz albo NULL
+ */
+static MappedImage *FindImage(const struct stat *st)
+{
+    for (MappedImage *image = images; image != NULL; image = image->next)
+    {
+        if (image->device == st->st_dev && image->inode == st->st_ino && image->size == st->st_size &&
+            image->modified.tv_sec == st->st_mtim.tv_sec && image->modified.tv_nsec == st->st_mtim.tv_nsec)
+            return image;
+    }
+    return NULL;
+}
+
+ImageMapResult ImageMap(const char *path, Poly *p)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return IMAGE_MAP_FAILED;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        close(fd);
+        return IMAGE_MAP_FAILED;
+    }
+    if (st.st_size == 0)
+    {
+        close(fd);
+        return IMAGE_WRONG_FILE;
+    }
+
+    ImageMapResult result = IMAGE_MAPPED;
+    pthread_mutex_lock(&images_lock);
+    MappedImage *image = FindImage(&st);
+    if (image == NULL)
+    {
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        Poly poly;
+        if (map == MAP_FAILED)
+            result = IMAGE_MAP_FAILED;
+        else if (!PolyFromImage(map, st.st_size, &poly))
+        {
+            munmap(map, st.st_size);
+            result = IMAGE_WRONG_FILE;
+        } else
+        {
+            image = malloc(sizeof(MappedImage));
+            CHECK_PTR(image);
+            image->device = st.st_dev;
+            image->inode = st.st_ino;
+            image->modified = st.st_mtim;
+            image->size = st.st_size;
+            image->poly = poly;
+            image->next = images;
+            images = image;
+        }
+    }
+    if (image != NULL)
+        *p = image->poly;
+    pthread_mutex_unlock(&images_lock);
+    close(fd);
+    return result;
+}
+
+/**
+ * Wczytuje liczbę całkowitą ze znakiem z danych tekstowych.
+ * @param[in,out] pos : położenie w danych
+ * @param[in] end : koniec danych
+ * @param[out] value : wczytana liczba
+ * @return Czy w położeniu @p pos jest poprawna liczba typu poly_coeff_t?
+ */
+static bool ReadTermCoeff(const char **pos, const char *end, poly_coeff_t *value)
+{
+    bool negative = *pos < end && **pos == '-';
+    if (negative)
+        (*pos)++;
+    uint64_t limit = negative ? (uint64_t) LONG_MAX + 1 : LONG_MAX;
+    uint64_t number = 0;
+    const char *begin = *pos;
+    while (*pos < end && **pos >= '0' && **pos <= '9')
+    {
+        uint64_t digit = **pos - '0';
+        if (number > (limit - digit) / 10)
+            return false;
+        number = number * 10 + digit;
+        (*pos)++;
+    }
+    *value = negative ? (poly_coeff_t) (0 - number) : (poly_coeff_t) number;
+    return *pos != begin;
+}
+
+/**
+ * Wczytuje wykładnik z danych tekstowych.
+ * @param[in,out] pos : położenie w danych
+ * @param[in] end : koniec danych
+ * @param[out] value : wczytany wykładnik
+ * @return Czy w położeniu @p pos jest poprawny wykładnik?
+ */
+static bool ReadTermExp(const char **pos, const char *end, poly_exp_t *value)
+{
+    long number = 0;
+    const char *begin = *pos;
+    while (*pos < end && **pos >= '0' && **pos <= '9')
+    {
+        number = number * 10 + (**pos - '0');
+        if (number > INT_MAX)
+            return false;
+        (*pos)++;
+    }
+    *value = (poly_exp_t) number;
+    return *pos != begin;
+}
+
+/**
+ * Wczytuje składniki z danych pliku z listą składników.
+ * @param[in] data : dane
+ * @param[in] size : liczba bajtów danych
+ * @param[out] p : wielomian będący sumą składników
+ * @return Czy dane są poprawne?
+ */
+static bool ReadTerms(const char *data, size_t size, Poly *p)
+{
+    const char *pos = data;
+    const char *end = data + size;
+    size_t vars = 0; //liczba zmiennych to liczba spacji w pierwszym wierszu
+    for (const char *c = data; c < end && *c != '\n'; c++)
+        vars += *c == ' ';
+    poly_exp_t *exps = malloc((vars > 0 ? vars : 1) * sizeof(poly_exp_t));
+    CHECK_PTR(exps);
+    PolyBuilder builder;
+    PolyBuilderInit(&builder, vars);
+    bool correct = true;
+    while (pos < end && correct)
+    {
+        poly_coeff_t coeff;
+        correct = ReadTermCoeff(&pos, end, &coeff);
+        for (size_t i = 0; i < vars && correct; i++)
+        {
+            correct = pos < end && *pos == ' ';
+            pos++;
+            correct = correct && ReadTermExp(&pos, end, &exps[i]);
+        }
+        if (correct && pos < end)
+            correct = *pos++ == '\n';
+        if (correct)
+            PolyBuilderAddTerm(&builder, exps, coeff);
+    }
+    if (correct)
+        *p = PolyBuilderFinish(&builder);
+    PolyBuilderDestroy(&builder);
+    free(exps);
+    return correct;
+}
+
+bool TermsLoad(const char *path, Poly *p)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        close(fd);
+        return false;
+    }
+    if (st.st_size == 0)
+    {
+        close(fd);
+        *p = PolyZero();
+        return true;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+    bool correct = ReadTerms(map, st.st_size, p);
+    munmap(map, st.st_size);
+    return correct;
+}
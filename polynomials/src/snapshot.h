@@ -0,0 +1,76 @@
+/** @file
+ Interfejs plików z binarnym zapisem wielomianów
+
+ @author Julia Karmowska
+ @date 2021
+*/
+
+#ifndef POLYNOMIALS_SNAPSHOT_H
+#define POLYNOMIALS_SNAPSHOT_H
+
+#include "poly.h"
+
+/**
+ * Zapisuje wielomiany do pliku o ścieżce @p path w postaci binarnej (PolyWriteBinary),
+ * poprzedzając je nagłówkiem formatu. Istniejący plik jest zastępowany.
+ * @param[in] path : ścieżka pliku
+ * @param[in] count : liczba wielomianów
+ * @param[in] polys : wielomiany
+ * @return Czy udało się zapisać plik?
+ */
+extern bool SnapshotSave(const char *path, size_t count, const Poly polys[]);
+
+/**
+ * Odczytuje wszystkie wielomiany z pliku zapisanego przez SnapshotSave.
+ * Plik jest odwzorowywany w pamięci i dekodowany bez dodatkowego kopiowania.
+ * @param[in] path : ścieżka pliku
+ * @param[out] count : liczba odczytanych wielomianów
+ * @param[out] polys : tablica odczytanych wielomianów (do zwolnienia przez wywołującego)
+ * @return Czy plik istnieje i jest poprawny?
+ */
+extern bool SnapshotLoad(const char *path, size_t *count, Poly **polys);
+
+/**
+ * Zapisuje obraz wielomianu (PolyWriteImage) do pliku o ścieżce @p path.
+ * Istniejący plik jest zastępowany nowym plikiem, więc jego dotychczasowe odwzorowania
+ * pozostają poprawne.
+ * @param[in] path : ścieżka pliku
+ * @param[in] p : wielomian
+ * @return Czy udało się zapisać plik?
+ */
+extern bool ImageSave(const char *path, const Poly *p);
+
+/**
+ * Typ opisujący wynik odwzorowania pliku z obrazem wielomianu.
+ */
+typedef enum ImageMapResult {
+    IMAGE_MAPPED,       ///< obraz został odwzorowany
+    IMAGE_MAP_FAILED,   ///< nie udało się otworzyć ani odwzorować pliku
+    IMAGE_WRONG_FILE    ///< plik nie zawiera poprawnego obrazu
+} ImageMapResult;
+
+/**
+ * Odwzorowuje w pamięci tylko do odczytu plik z obrazem wielomianu i daje wielomian leżący
+ * w obrazie, bez kopiowania go. Obraz jest przed udostępnieniem sprawdzany w całości
+ * (PolyFromImage). Odwzorowanie pozostaje w pamięci do końca działania programu,
+ * a ponowne odwzorowanie tego samego, niezmienionego pliku (także w innym wątku) daje ten sam
+ * wielomian bez ponownego sprawdzania. Procesy odwzorowujące ten sam plik współdzielą jego
+ * strony w pamięci podręcznej systemu.
+ * @param[in] path : ścieżka pliku
+ * @param[out] p : wielomian (nie trzeba go usuwać)
+ * @return wynik odwzorowania
+ */
+extern ImageMapResult ImageMap(const char *path, Poly *p);
+
+/**
+ * Wczytuje wielomian z tekstowego pliku z listą składników. Każdy wiersz opisuje jeden
+ * składnik: współczynnik i wykładniki zmiennych @f$x_0, x_1, …@f$, oddzielone pojedynczymi
+ * spacjami. Wszystkie wiersze mają tyle wykładników co pierwszy, a składniki mogą występować
+ * w dowolnej kolejności i powtarzać się. Wielomian jest budowany przez PolyBuilder.
+ * @param[in] path : ścieżka pliku
+ * @param[out] p : wielomian będący sumą składników
+ * @return Czy plik istnieje i jest poprawny?
+ */
+extern bool TermsLoad(const char *path, Poly *p);
+
+#endif //POLYNOMIALS_SNAPSHOT_H
@@ -7,6 +7,7 @@
 
 #include <stdlib.h>
 #include "stack.h"
+#include "deferred.h"
 #include "memory.h"
 
 
@@ -14,9 +15,9 @@
  * Struktura opisująca stos wielomianów, implementacja tablicowa.
  */
 struct Stack {
-    Poly *polys;        ///< wskaźnik do tablicy wielomianów
+    StackItem *polys;   ///< wskaźnik do tablicy elementów
     size_t size;        ///< rozmiar tablicy
-    size_t used;        ///< liczba wielomianów w tablicy
+    size_t used;        ///< liczba elementów w tablicy
 };
 
 void StackInit(Stack **stack)
@@ -24,22 +25,71 @@ void StackInit(Stack **stack)
     *stack = calloc(1, sizeof(Stack));
     CHECK_PTR(*stack);
     (*stack)->used = 0;
-    ((*stack)->polys) = calloc(INITIAL_ARRAY_SIZE, sizeof(Poly));
+    ((*stack)->polys) = calloc(INITIAL_ARRAY_SIZE, sizeof(StackItem));
     CHECK_PTR((*stack)->polys);
     (*stack)->size = INITIAL_ARRAY_SIZE;
 }
 
+void StackItemRelease(StackItem *item)
+{
+    if (item->expr != NULL)
+        ExprRelease(item->expr);
+    else
+        DeferredDestroy(&item->poly);
+}
+
 void StackPop(Stack **stack)
 {
     assert((*stack)->used > 0);
-    PolyDestroy(&((*stack)->polys[(*stack)->used - 1]));
+    StackItemRelease(&(*stack)->polys[(*stack)->used - 1]);
     ((*stack)->used)--;
 }
 
+/**
+ * Przekazuje wielomian z elementu stosu, wyliczając go, jeśli element jest wyrażeniem.
+ * @param[in] item : element stosu
+ * @return wielomian
+ */
+static Poly ItemPoly(StackItem *item)
+{
+    if (item->expr != NULL)
+        return *ExprValue(item->expr);
+    return item->poly;
+}
+
 Poly StackTop(Stack *stack)
 {
     assert(stack->used > 0);
-    return stack->polys[stack->used - 1];
+    return ItemPoly(&stack->polys[stack->used - 1]);
+}
+
+Poly StackAt(Stack *stack, size_t depth)
+{
+    assert(depth < stack->used);
+    return ItemPoly(&stack->polys[stack->used - 1 - depth]);
+}
+
+StackItem StackTopItem(Stack *stack)
+{
+    assert(stack->used > 0);
+    StackItem item = stack->polys[stack->used - 1];
+    if (item.expr != NULL)
+        ExprRetain(item.expr);
+    else
+        item.poly = PolyShare(&item.poly);
+    return item;
+}
+
+Expr *StackTopExpr(Stack *stack)
+{
+    assert(stack->used > 0);
+    StackItem *item = &stack->polys[stack->used - 1];
+    if (item->expr == NULL)
+    {
+        item->expr = ExprFromPoly(&item->poly);
+        item->poly = PolyZero();
+    }
+    return ExprRetain(item->expr);
 }
 
 
@@ -64,7 +114,7 @@ static void MaybeReallocArr(Stack **stack)
     if ((*stack)->used >= (*stack)->size)
     {
         (*stack)->size = increase_size((*stack)->size);
-        (*stack)->polys = realloc((*stack)->polys, sizeof(Poly) * (*stack)->size);
+        (*stack)->polys = realloc((*stack)->polys, sizeof(StackItem) * (*stack)->size);
         CHECK_PTR((*stack)->polys);
     }
 }
@@ -72,7 +122,23 @@ static void MaybeReallocArr(Stack **stack)
 void StackPush(Poly *poly, Stack **stack)
 {
     MaybeReallocArr(stack);
-    (*stack)->polys[(*stack)->used] = *poly;
+    (*stack)->polys[(*stack)->used].poly = *poly;
+    (*stack)->polys[(*stack)->used].expr = NULL;
+    ((*stack)->used)++;
+}
+
+void StackPushItem(StackItem *item, Stack **stack)
+{
+    MaybeReallocArr(stack);
+    (*stack)->polys[(*stack)->used] = *item;
+    ((*stack)->used)++;
+}
+
+void StackPushExpr(Expr *expr, Stack **stack)
+{
+    MaybeReallocArr(stack);
+    (*stack)->polys[(*stack)->used].poly = PolyZero();
+    (*stack)->polys[(*stack)->used].expr = expr;
     ((*stack)->used)++;
 }
 
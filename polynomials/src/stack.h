@@ -8,12 +8,28 @@
 #define POLYNOMIALS_STACK_H
 
 #include "poly.h"
+#include "expr.h"
 
 /**
  * Struktura opisująca stos.
  */
 typedef struct Stack Stack;
 
+/**
+ * Struktura opisująca element stosu: wielomian albo leniwe wyrażenie.
+ */
+typedef struct StackItem {
+    Poly poly;          ///< wielomian, jeśli element nie jest wyrażeniem
+    Expr *expr;         ///< wyrażenie albo NULL
+} StackItem;
+
+/**
+ * Usuwa z pamięci element stosu (zwalnia wielomian lub referencję do wyrażenia).
+ * Duży wielomian może zostać zwolniony w tle (DeferredDestroy).
+ * @param[in] item : element
+ */
+extern void StackItemRelease(StackItem *item);
+
 /**
  * Zdejmuje wielomian z wierzchołka stosu, usuwa go z pamięci.
  * @param[in] stack : stos
@@ -21,12 +37,38 @@ typedef struct Stack Stack;
 extern void StackPop(Stack **stack);
 
 /**
- * Przekazuje wielomian z wierzchołka stosu
+ * Przekazuje wielomian z wierzchołka stosu.
+ * Jeśli na wierzchołku leży leniwe wyrażenie, wylicza je. Wielomian nadal należy do stosu.
  * @param[in] stack : stos
  * @return wielomian z wierzchołka stosu
  */
 extern Poly StackTop(Stack *stack);
 
+/**
+ * Przekazuje wyrażenie z wierzchołka stosu, nie wyliczając go. Jeśli na wierzchołku
+ * leży wielomian, zamienia go w wyrażenie o znanej wartości.
+ * @param[in] stack : stos
+ * @return wyrażenie z wierzchołka stosu (nowa referencja)
+ */
+extern Expr *StackTopExpr(Stack *stack);
+
+/**
+ * Przekazuje współdzieloną kopię elementu z wierzchołka stosu, nie wyliczając go.
+ * Kopię trzeba usunąć przez StackItemRelease albo przekazać do StackPushItem.
+ * @param[in] stack : stos
+ * @return kopia elementu z wierzchołka stosu
+ */
+extern StackItem StackTopItem(Stack *stack);
+
+/**
+ * Przekazuje wielomian leżący na stosie o @p depth pozycji poniżej wierzchołka.
+ * Jeśli leży tam leniwe wyrażenie, wylicza je.
+ * @param[in] stack : stos
+ * @param[in] depth : odległość od wierzchołka (0 oznacza wierzchołek)
+ * @return wielomian ze stosu
+ */
+extern Poly StackAt(Stack *stack, size_t depth);
+
 /**
  * Sprawdza, czy stos jest pusty.
  * @param[in] stack : stos
@@ -41,6 +83,20 @@ extern bool StackIsEmpty(Stack *stack);
  */
 extern void StackPush(Poly *poly, Stack **stack);
 
+/**
+ * Dodaje element do stosu, przejmując go na własność.
+ * @param[in] item : element
+ * @param[in] stack : stos
+ */
+extern void StackPushItem(StackItem *item, Stack **stack);
+
+/**
+ * Dodaje leniwe wyrażenie do stosu, przejmując referencję do niego.
+ * @param[in] expr : wyrażenie
+ * @param[in] stack : stos
+ */
+extern void StackPushExpr(Expr *expr, Stack **stack);
+
 /**
  * Tworzy nowy pusty stos.
  * @param[in] stack : stos